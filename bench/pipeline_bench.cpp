@@ -0,0 +1,433 @@
+#include "filters_cpu.hpp"
+#include "arena.hpp"
+#include "edge_codec.hpp"
+#include "filter_graph.hpp"
+#include "cpu_features.hpp"
+#include "sobel_norm.hpp"
+#include "workspace.hpp"
+#include "utils.hpp"
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+pipeline_bench = every filter kernel in isolation, on synthetic frames.
+
+The Timer printouts in Pipeline include imread / VideoCapture / imwrite
+noise and run each config once. Here each (kernel, resolution, threads,
+radius) case is:
+  1) warmed up (page faults, pool threads spawned, caches/branch predictors hot)
+  2) timed `reps` times
+  3) summarized by the median and MAD (median absolute deviation),
+     which a single slow outlier rep can't drag around like mean/stddev
+
+Throughput:
+  MP/s = megapixels per second (w*h / median time)
+  GB/s = compulsory bytes per second: input frame read + output frame
+         written once. Intermediates (the blur's int tmp buffer, ...) are
+         NOT counted, so a kernel that approaches the memory bandwidth
+         with this number is truly bandwidth bound.
+
+--json writes the same numbers in a machine-readable form so two builds
+can be diffed.
+*/
+
+namespace {
+
+struct FrameSize {
+    std::string name;
+    int w;
+    int h;
+};
+
+const std::vector<FrameSize> kAllSizes = {
+    {"vga",   640,  480},
+    {"720p",  1280, 720},
+    {"1080p", 1920, 1080},
+    {"1440p", 2560, 1440},
+    {"4k",    3840, 2160},
+    {"8k",    7680, 4320},
+};
+
+// Inputs shared by every case at one resolution
+struct Frames {
+    cv::Mat bgr;  // CV_8UC3 synthetic input
+    cv::Mat gray; // CV_8UC1 = grayscale of bgr (input for blur/sobel)
+    cv::Mat planar; // bgr split into 3 stacked planes (input for the colour kernels)
+    cv::Mat out;  // output of the kernel under test
+};
+
+// What one kernel needs to be run and measured
+struct Kernel {
+    std::string name;
+    bool mt;          // runs over the --threads list (else threads = 1 only)
+    bool usesRadius;  // runs over the --radii list
+    int inBytesPerPx; // for GB/s
+    int outBytesPerPx;
+    std::function<void(Frames&, int threads, int radius, CpuWorkspace& ws)> run;
+};
+
+SobelNorm g_norm = SobelNorm::L2;
+
+std::vector<Kernel> allKernels() {
+    return {
+        {"grayscale_cpu", false, false, 3, 1,
+         [](Frames& f, int, int, CpuWorkspace&) { grayscale_cpu(f.bgr, f.out, 1); }},
+        {"grayscale_cpu_mt", true, false, 3, 1,
+         [](Frames& f, int t, int, CpuWorkspace&) { grayscale_cpu_mt(f.bgr, f.out, t); }},
+        {"grayscale_cpu_mt_ws", true, false, 3, 1,
+         [](Frames& f, int t, int, CpuWorkspace& ws) { grayscale_cpu_mt_ws(f.bgr, f.out, t, ws); }},
+        {"box_blur_cpu_fast", false, true, 1, 1,
+         [](Frames& f, int, int r, CpuWorkspace&) { box_blur_cpu_fast(f.gray, f.out, r, 1); }},
+        {"box_blur_cpu_fast_ws", false, true, 1, 1,
+         [](Frames& f, int, int r, CpuWorkspace& ws) { box_blur_cpu_fast_ws(f.gray, f.out, r, ws); }},
+        {"box_blur_cpu_fast_mt_ws", true, true, 1, 1,
+         [](Frames& f, int t, int r, CpuWorkspace& ws) { box_blur_cpu_fast_mt_ws(f.gray, f.out, r, t, ws); }},
+        {"box_blur_sat_mt_ws", true, true, 1, 1,
+         [](Frames& f, int t, int r, CpuWorkspace& ws) {
+             // One radius per call (table rebuilt every rep) to compare
+             // with the separable blur; outs[0] shares f.out's buffer
+             std::vector<cv::Mat> outs{f.out};
+             box_blur_sat_multi(f.gray, outs, {r}, t, ws);
+         }},
+        {"sobel_cpu", false, false, 1, 1,
+         [](Frames& f, int, int, CpuWorkspace&) { sobel_cpu(f.gray, f.out, 1, g_norm); }},
+        {"sobel_cpu_mt", true, false, 1, 1,
+         [](Frames& f, int t, int, CpuWorkspace&) { sobel_cpu_mt(f.gray, f.out, t, g_norm); }},
+        {"sobel_cpu_mt_ws", true, false, 1, 1,
+         [](Frames& f, int t, int, CpuWorkspace& ws) { sobel_cpu_mt_ws(f.gray, f.out, t, ws, g_norm); }},
+        {"bgr_to_planar_mt_ws", true, false, 3, 3,
+         [](Frames& f, int t, int, CpuWorkspace& ws) { bgr_to_planar(f.bgr, f.out, t, ws); }},
+        {"box_blur_planar_mt_ws", true, true, 3, 3,
+         [](Frames& f, int t, int r, CpuWorkspace& ws) { box_blur_planar(f.planar, f.out, r, t, ws); }},
+        {"sobel_planar_mt_ws", true, false, 3, 3,
+         [](Frames& f, int t, int, CpuWorkspace& ws) { sobel_planar(f.planar, f.out, t, ws, g_norm); }},
+        {"planar_to_bgr_mt_ws", true, false, 3, 3,
+         [](Frames& f, int t, int, CpuWorkspace& ws) { planar_to_bgr(f.planar, f.out, t, ws); }},
+        {"canny_cpu_mt_ws", true, false, 1, 1,
+         [](Frames& f, int t, int, CpuWorkspace& ws) {
+             canny_cpu(f.gray, f.out, kCannyDefaultLow, kCannyDefaultHigh, t, ws);
+         }},
+        // Downsamplers: the quarter-size output is left out of GB/s
+        {"grayscale_downsample2_mt_ws", true, false, 3, 0,
+         [](Frames& f, int t, int, CpuWorkspace& ws) { grayscale_downsample(f.bgr, f.out, 2, t, ws); }},
+        {"downsample2_gray_mt_ws", true, false, 1, 0,
+         [](Frames& f, int t, int, CpuWorkspace& ws) { downsample2_gray(f.gray, f.out, t, ws); }},
+        // Compact output: gray stands in for the edge map (threshold 64)
+        {"edge_encode_rle_mt_ws", true, false, 1, 0,
+         [](Frames& f, int t, int, CpuWorkspace& ws) {
+             static EdgeEncoder enc;
+             if (enc.width() != f.gray.cols || enc.height() != f.gray.rows) {
+                 enc.setup(EdgeFormat::RLE, f.gray.cols, f.gray.rows, 64);
+             }
+             enc.encode(f.gray, t, ws);
+         }},
+        {"fused_gray_blur_sobel", true, true, 3, 1,
+         [](Frames& f, int t, int r, CpuWorkspace& ws) { fused_gray_blur_sobel(f.bgr, f.out, r, t, ws, g_norm); }},
+    };
+}
+
+// Noise + gradients, fixed seed: same frames on every run and every machine
+void makeFrames(Frames& f, int w, int h) {
+    f.bgr.create(h, w, CV_8UC3);
+    std::mt19937 rng(12345);
+    for (int y = 0; y < h; y++) {
+        uint8_t* row = f.bgr.ptr<uint8_t>(y);
+        for (int x = 0; x < w; x++) {
+            int n = (int)(rng() & 63);
+            row[3 * x + 0] = (uint8_t)((x * 255 / std::max(1, w - 1) + n) & 255);
+            row[3 * x + 1] = (uint8_t)((y * 255 / std::max(1, h - 1) + n) & 255);
+            row[3 * x + 2] = (uint8_t)(((x ^ y) + n) & 255);
+        }
+    }
+    grayscale_cpu(f.bgr, f.gray, 1);
+    CpuWorkspace ws;
+    bgr_to_planar(f.bgr, f.planar, 1, ws);
+    f.out.create(h, w, CV_8UC1);
+}
+
+struct Stats {
+    double medianMs = 0.0;
+    double madMs = 0.0;
+    double minMs = 0.0;
+    double meanMs = 0.0;
+};
+
+double median(std::vector<double> v) {
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    size_t n = v.size();
+    return (n % 2) ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+}
+
+Stats summarize(const std::vector<double>& ms) {
+    Stats s;
+    s.medianMs = median(ms);
+    std::vector<double> dev;
+    dev.reserve(ms.size());
+    for (double m : ms) dev.push_back(std::fabs(m - s.medianMs));
+    s.madMs = median(dev);
+    s.minMs = *std::min_element(ms.begin(), ms.end());
+    double sum = 0.0;
+    for (double m : ms) sum += m;
+    s.meanMs = sum / (double)ms.size();
+    return s;
+}
+
+struct Result {
+    std::string kernel;
+    std::string size;
+    int w, h, threads, radius;
+    Stats st;
+    double mpixPerS;
+    double gbPerS;
+    double bytesPerFrame;
+};
+
+// "1,2,4" -> {1,2,4}
+std::vector<int> parseIntList(const std::string& s) {
+    std::vector<int> out;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) out.push_back(std::stoi(item));
+    }
+    if (out.empty()) throw std::runtime_error("Empty list: " + s);
+    return out;
+}
+
+std::vector<std::string> parseStrList(const std::string& s) {
+    std::vector<std::string> out;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) out.push_back(item);
+    }
+    if (out.empty()) throw std::runtime_error("Empty list: " + s);
+    return out;
+}
+
+void writeJson(const std::string& path, const std::vector<Result>& results,
+               int warmup, int reps) {
+    std::ofstream os(path);
+    if (!os) throw std::runtime_error("Failed to open JSON output: " + path);
+    os << std::setprecision(6);
+
+    os << "{\n  \"meta\": {\n";
+    os << "    \"isa\": \"" << cpuIsaName(activeCpuIsa()) << "\",\n";
+    os << "    \"sobel_norm\": \"" << sobelNormName(g_norm) << "\",\n";
+    os << "    \"hw_threads\": " << std::thread::hardware_concurrency() << ",\n";
+#if defined(__VERSION__)
+    os << "    \"compiler\": \"" << __VERSION__ << "\",\n";
+#endif
+#ifdef NDEBUG
+    os << "    \"ndebug\": true,\n";
+#else
+    os << "    \"ndebug\": false,\n";
+#endif
+    os << "    \"warmup\": " << warmup << ",\n";
+    os << "    \"reps\": " << reps << "\n  },\n";
+
+    os << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        os << "    {\"kernel\": \"" << r.kernel << "\", \"size\": \"" << r.size << "\""
+           << ", \"width\": " << r.w << ", \"height\": " << r.h
+           << ", \"threads\": " << r.threads << ", \"radius\": " << r.radius
+           << ", \"median_ms\": " << r.st.medianMs << ", \"mad_ms\": " << r.st.madMs
+           << ", \"min_ms\": " << r.st.minMs << ", \"mean_ms\": " << r.st.meanMs
+           << ", \"mpix_per_s\": " << r.mpixPerS << ", \"gb_per_s\": " << r.gbPerS
+           << ", \"bytes_per_frame\": " << (uint64_t)r.bytesPerFrame << "}"
+           << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    os << "  ]\n}\n";
+}
+
+void usage() {
+    std::cout <<
+    "Usage:\n"
+    "  ./pipeline_bench [options]\n"
+    "\nOptions:\n"
+    "  --sizes <list>    vga,720p,1080p,1440p,4k,8k (default: all)\n"
+    "  --kernels <list>  kernel names (default: all; --list prints them)\n"
+    "  --radii <list>    blur radii (default: 1,3,8)\n"
+    "  --threads <list>  thread counts for MT kernels (default: 1,2,4,...,hw)\n"
+    "  --warmup N        untimed runs per case (default 3)\n"
+    "  --reps N          timed runs per case (default 15)\n"
+    "  --isa <scalar|ssse3|avx2|avx512>  cap the SIMD level\n"
+    "  --grain N         rows per work-stealing task in MT kernels (default: auto)\n"
+    "  --hugepages <off|thp|explicit>  workspace arena pages (default off)\n"
+    "  --prefault        prefault workspace arena pages when they are carved\n"
+    "  --sobel-norm <l1|l2|sq>\n"
+    "  --json <path>     also write results as JSON\n"
+    "  --list            print kernel names and exit\n"
+    "\nExample:\n"
+    "  ./pipeline_bench --sizes 1080p,4k --threads 1,4,8 --json bench.json\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<Kernel> kernels = allKernels();
+    std::vector<FrameSize> sizes = kAllSizes;
+    std::vector<int> radii = {1, 3, 8};
+    std::vector<int> threadCounts;
+    int warmup = 3;
+    int reps = 15;
+    std::string jsonPath;
+    ArenaOptions arenaOpts;
+
+    // Default thread list: powers of two up to the core count, plus the core count
+    int hw = std::max(1u, std::thread::hardware_concurrency());
+    for (int t = 1; t < hw; t *= 2) threadCounts.push_back(t);
+    threadCounts.push_back(hw);
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string a = argv[i];
+            auto needValue = [&](const std::string& flag) -> std::string {
+                if (i + 1 >= argc) throw std::runtime_error("Missing value after " + flag);
+                return argv[++i];
+            };
+
+            if (a == "--sizes") {
+                sizes.clear();
+                for (const std::string& name : parseStrList(needValue(a))) {
+                    auto it = std::find_if(kAllSizes.begin(), kAllSizes.end(),
+                                           [&](const FrameSize& s) { return s.name == name; });
+                    if (it == kAllSizes.end()) throw std::runtime_error("Unknown size: " + name);
+                    sizes.push_back(*it);
+                }
+            }
+            else if (a == "--kernels") {
+                std::vector<Kernel> picked;
+                for (const std::string& name : parseStrList(needValue(a))) {
+                    auto it = std::find_if(kernels.begin(), kernels.end(),
+                                           [&](const Kernel& k) { return k.name == name; });
+                    if (it == kernels.end()) throw std::runtime_error("Unknown kernel: " + name);
+                    picked.push_back(*it);
+                }
+                kernels = picked;
+            }
+            else if (a == "--radii")      radii = parseIntList(needValue(a));
+            else if (a == "--threads")    threadCounts = parseIntList(needValue(a));
+            else if (a == "--warmup")     warmup = std::stoi(needValue(a));
+            else if (a == "--reps")       reps = std::stoi(needValue(a));
+            else if (a == "--grain")      ThreadPool::setDefaultGrain(std::stoi(needValue(a)));
+            else if (a == "--hugepages")  arenaOpts.hugePages = parseHugePages(needValue(a));
+            else if (a == "--prefault")   arenaOpts.prefault = true;
+            else if (a == "--isa")        setCpuIsaLimit(parseCpuIsa(needValue(a)));
+            else if (a == "--sobel-norm") g_norm = parseSobelNorm(needValue(a));
+            else if (a == "--json")       jsonPath = needValue(a);
+            else if (a == "--list") {
+                for (const Kernel& k : kernels) std::cout << k.name << "\n";
+                return 0;
+            }
+            else {
+                std::cerr << "Unknown flag: " << a << "\n";
+                usage();
+                return 1;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "[ERROR] " << e.what() << "\n";
+        return 1;
+    }
+    Arena::setDefaultOptions(arenaOpts);
+    if (reps < 1) reps = 1;
+    if (warmup < 0) warmup = 0;
+    for (int r : radii) {
+        if (r < 1) { std::cerr << "--radii values must be >= 1\n"; return 1; }
+    }
+    for (int t : threadCounts) {
+        if (t < 1) { std::cerr << "--threads values must be >= 1\n"; return 1; }
+    }
+
+    std::cout << "[BENCH] isa=" << cpuIsaName(activeCpuIsa())
+              << " norm=" << sobelNormName(g_norm)
+              << " hw_threads=" << hw
+              << " warmup=" << warmup << " reps=" << reps
+              << " hugepages=" << hugePagesName(arenaOpts.hugePages) << (arenaOpts.prefault ? " prefault" : "")
+              << "\n";
+    std::cout << std::left << std::setw(24) << "kernel" << std::setw(8) << "size"
+              << std::right << std::setw(4) << "thr" << std::setw(4) << "r"
+              << std::setw(11) << "median ms" << std::setw(9) << "MAD ms"
+              << std::setw(10) << "MP/s" << std::setw(8) << "GB/s" << "\n";
+    std::cout << std::fixed;
+
+    std::vector<Result> results;
+
+    try {
+        for (const FrameSize& fs : sizes) {
+            Frames f;
+            makeFrames(f, fs.w, fs.h);
+            double px = (double)fs.w * (double)fs.h;
+
+            for (const Kernel& k : kernels) {
+                std::vector<int> ts = k.mt ? threadCounts : std::vector<int>{1};
+                std::vector<int> rs = k.usesRadius ? radii : std::vector<int>{0};
+
+                for (int t : ts) {
+                    // One workspace per (size, threads): pool spawned once, reused by every rep
+                    CpuWorkspace ws;
+                    ws.ensureSize(fs.w, fs.h);
+                    if (k.mt && t > 1) ws.ensureThreads(t);
+
+                    for (int r : rs) {
+                        for (int i = 0; i < warmup; i++) k.run(f, t, r, ws);
+
+                        std::vector<double> ms;
+                        ms.reserve(reps);
+                        for (int i = 0; i < reps; i++) {
+                            Timer timer;
+                            k.run(f, t, r, ws);
+                            ms.push_back(timer.ms());
+                        }
+
+                        Result res;
+                        res.kernel = k.name;
+                        res.size = fs.name;
+                        res.w = fs.w;
+                        res.h = fs.h;
+                        res.threads = t;
+                        res.radius = r;
+                        res.st = summarize(ms);
+                        res.bytesPerFrame = px * (k.inBytesPerPx + k.outBytesPerPx);
+                        double sec = res.st.medianMs / 1000.0;
+                        res.mpixPerS = (sec > 0) ? px / 1e6 / sec : 0.0;
+                        res.gbPerS = (sec > 0) ? res.bytesPerFrame / 1e9 / sec : 0.0;
+                        results.push_back(res);
+
+                        std::cout << std::left << std::setw(24) << k.name << std::setw(8) << fs.name
+                                  << std::right << std::setw(4) << t << std::setw(4) << r
+                                  << std::setprecision(3) << std::setw(11) << res.st.medianMs
+                                  << std::setw(9) << res.st.madMs
+                                  << std::setprecision(1) << std::setw(10) << res.mpixPerS
+                                  << std::setprecision(2) << std::setw(8) << res.gbPerS << "\n";
+                    }
+                }
+            }
+        }
+
+        if (!jsonPath.empty()) {
+            writeJson(jsonPath, results, warmup, reps);
+            std::cout << "wrote " << jsonPath << "\n";
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "[ERROR] " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+Arena = one reserved block of address space that every buffer of a
+CpuWorkspace is carved from.
+
+Why?
+- with a std::vector per buffer, a frame's memory is scattered over the
+  heap, each vector on its own 4 KB pages (one TLB entry each)
+- the first frame pays a page fault for every page it touches
+  (first-touch), which shows up as a slow frame 0 in every percentile
+
+The arena reserves a large range of addresses up front (no memory yet)
+and commits it in 2 MB steps as buffers are carved:
+- every slice is 64-byte aligned (cache line, widest SIMD load)
+- slices never move: growing the range never relocates earlier buffers,
+  so cv::Mat headers over them stay valid
+- pages can be transparent huge pages (madvise) or explicit hugetlb
+  pages (falls back to THP when none are reserved), so one 2 MB TLB
+  entry covers what took 512
+- prefault touches every page as it is committed, i.e. at setup, not
+  inside the first frame
+
+A slice that has to grow and is not the last one is abandoned (not
+reused); buffers are sized once per resolution, so that only happens
+when the size goes up.
+*/
+
+enum class HugePages {
+    OFF,     // 4 KB pages
+    THP,     // transparent huge pages (madvise MADV_HUGEPAGE)
+    EXPLICIT // MAP_HUGETLB (needs vm.nr_hugepages); falls back to THP
+};
+
+const char* hugePagesName(HugePages h);
+HugePages parseHugePages(const std::string& s); // "off" | "thp" | "explicit"
+
+struct ArenaOptions {
+    HugePages hugePages = HugePages::OFF;
+    bool prefault = false;
+};
+
+class Arena {
+public:
+    static const size_t kAlign = 64;
+    static const size_t kCommitStep = 2u << 20; // 2 MB = one huge page
+
+    explicit Arena(ArenaOptions opts = defaultOptions());
+    ~Arena();
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // `bytes` of zeroed memory, kAlign-aligned, valid until the arena dies.
+    // Throws std::runtime_error when the reserved range is used up.
+    void* alloc(size_t bytes);
+
+    // Grow the slice at p from oldBytes to newBytes in place, if it is the
+    // last one carved. False = caller must alloc a new slice.
+    bool extend(void* p, size_t oldBytes, size_t newBytes);
+
+    size_t used() const { return used_; }           // bytes carved (incl. abandoned slices)
+    size_t committed() const { return committed_; } // bytes backed by memory
+    HugePages pages() const { return pages_; }      // what the arena actually got
+    bool prefaulted() const { return opts_.prefault; }
+
+    // --hugepages / --prefault: options for arenas created from now on
+    static void setDefaultOptions(ArenaOptions opts);
+    static ArenaOptions defaultOptions();
+
+private:
+    void commit(size_t upTo);
+
+    ArenaOptions opts_;
+    HugePages pages_ = HugePages::OFF;
+    uint8_t* base_ = nullptr; // 2 MB aligned
+    void* mapping_ = nullptr; // what mmap returned (base_ rounded down)
+    size_t mappingBytes_ = 0;
+    size_t reserved_ = 0;
+    size_t committed_ = 0;
+    size_t used_ = 0;
+};
+
+// A typed slice of an Arena with the bits of the std::vector API the
+// kernels use. Contents are NOT kept when ensure() has to move it.
+template <class T>
+class ArenaArray {
+public:
+    T* data() { return p_; }
+    const T* data() const { return p_; }
+    size_t size() const { return n_; }
+    bool empty() const { return n_ == 0; }
+    T& operator[](size_t i) { return p_[i]; }
+    const T& operator[](size_t i) const { return p_[i]; }
+
+    // Room for at least n elements (never shrinks)
+    void ensure(Arena& a, size_t n) {
+        if (n <= n_) return;
+        if (p_ && a.extend(p_, n_ * sizeof(T), n * sizeof(T))) {
+            n_ = n;
+            return;
+        }
+        // Moving abandons the old slice: grow by half at least, so a buffer
+        // that creeps up (tiles, crops) leaves few of them behind
+        if (p_) n = std::max(n, n_ + n_ / 2);
+        p_ = static_cast<T*>(a.alloc(n * sizeof(T)));
+        n_ = n;
+    }
+
+private:
+    T* p_ = nullptr;
+    size_t n_ = 0;
+};
@@ -0,0 +1,102 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+#include "pipeline.hpp"
+#include "cpu_features.hpp"
+#include "filter_graph.hpp"
+
+/*
+Autotuning (--autotune) and per-machine profiles.
+
+The best --threads, --grain, --isa and --fused depend on the frame size,
+the chain and the machine: small frames get slower with every thread
+past a few (dispatch and join cost more than the rows they split), and
+the widest ISA isn't always the fastest for a bandwidth-bound chain.
+
+--autotune times candidate configurations on a synthetic frame of the
+run's size, through the same FrameBuffers / processFrame path the run
+uses, one knob at a time (ISA, fused, threads, grain, and band rows for
+--tiled), each at the best values found so far. Knobs given on the
+command line are not tuned. The winner is stored in a profile file:
+
+  # image_pipeline autotune profile v1
+  machine <hostname> threads=<hw threads> isa=<best isa>
+  <w>x<h> <mode> <chain> threads=N grain=N isa=NAME fused=0|1 tile_rows=N ms=X
+
+one line per (size, mode, chain); chain = the unfused stage labels,
+e.g. gray,blur:1,sobel:l2. Later runs look up their size (exact, else
+the nearest tuned size within 2x the pixels) and apply the entry to
+every knob the command line didn't set. A profile written on a machine
+with another thread count or ISA is ignored.
+
+The profile lives in $XDG_CACHE_HOME/image_pipeline/<hostname>.profile
+(else ~/.cache/...), so hosts sharing a home directory keep their own.
+--profile <path> overrides that, --no-profile skips the lookup.
+
+Batch, --frames-in-flight and --roi/--scale runs don't use profiles:
+their parallelism or frame size isn't the one a whole frame is tuned for.
+*/
+
+struct TuneResult {
+    int threads = 1;
+    int grain = 0; // rows per pool task, 0 = auto
+    CpuIsa isa = CpuIsa::SCALAR;
+    bool fused = false;
+    int tileRows = 0; // --tiled band rows, 0 = auto
+    double ms = 0.0;  // per frame (--tiled: per image) with these settings
+};
+
+struct ProfileEntry {
+    int w = 0;
+    int h = 0;
+    Mode mode = Mode::CPU_SINGLE;
+    std::string chain;
+    TuneResult result;
+};
+
+class TuneProfile {
+public:
+    // $XDG_CACHE_HOME/image_pipeline/<hostname>.profile, "" if there is no home
+    static std::string defaultPath();
+
+    // A missing file is an empty profile. A malformed line throws if strict
+    // (--profile given), else it is skipped with a warning on stderr: the
+    // default profile is a cache, a bad line mustn't stop every run.
+    // Entries from another machine are dropped (foreign() says so).
+    void load(const std::string& path, bool strict = false);
+
+    // Creates the directory if needed; written whole, then renamed over path
+    void save(const std::string& path) const;
+
+    // Exact size, else the nearest size within 2x the pixel count; nullptr if none
+    const ProfileEntry* find(int w, int h, Mode mode, const std::string& chain) const;
+
+    // Insert or replace the entry for (w, h, mode, chain)
+    void put(const ProfileEntry& e);
+
+    bool foreign() const { return foreign_; }
+    const std::vector<ProfileEntry>& entries() const { return entries_; }
+
+private:
+    std::vector<ProfileEntry> entries_;
+    bool foreign_ = false;
+};
+
+// Profile key of the run's chain ("gray,blur:1,sobel:l2", never fused)
+std::string chainKey(const Args& args, PixelFormat input);
+
+// Time candidates on a synthetic (w x h) frame; prints one line per candidate
+TuneResult autotune(const Args& args, int w, int h, PixelFormat input);
+
+// Set every knob of r that the command line didn't (threads, --grain,
+// --isa, --fused, --tile-rows)
+void applyTuning(Args& args, const TuneResult& r);
+
+// Before a run: find its frame size, tune if --autotune (and save), then
+// apply the profile entry for it. An image decoded to learn its size is
+// handed back in `image`, so the run doesn't decode it twice.
+void configureRun(Args& args, cv::Mat& image);
+
+// --autotune without an input: tune every --tune-sizes size and save
+void tuneOffline(const Args& args);
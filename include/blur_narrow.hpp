@@ -0,0 +1,38 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+
+/*
+Narrow box-blur passes (blur_narrow.cpp) used by every full-frame blur
+when radius <= kBlurNarrowMaxRadius.
+
+- Horizontal sums are at most 255 * (2r+1), which fits uint16_t up to
+  r = 128: half the bytes of the int tmp buffer in the memory-bound pass.
+- Dividing by the area is a multiply + shift (BlurDivisor) instead of an
+  integer division per pixel.
+- r = 1, 2, 3 get kernels with the window size as a template constant:
+  plain sums of 2r+1 neighbours, unrolled, no loop-carried running sum,
+  so the compiler vectorizes both passes.
+
+Output is bit-identical to the int path (blur_hsum_row + blur_divide_row).
+*/
+
+const int kBlurNarrowMaxRadius = 128;
+
+// floor(s / area) == (s * mul) >> shift for every 0 <= s <= 255 * area
+// (area < 2^23, i.e. radius < 1448; s * mul needs 64 bits above r = 3)
+struct BlurDivisor {
+    uint32_t mul = 1;
+    int shift = 0;
+};
+
+BlurDivisor blur_divisor(int area);
+
+// Pass 1, rows [y0, y1): uint16 horizontal window sums of gray into tmp
+// (row y at tmp + y * w)
+void blur_hpass_u16(const cv::Mat& gray, uint16_t* tmp, int radius, int y0, int y1);
+
+// Pass 2, output rows [y0, y1): vertical sums of tmp rows (edge rows
+// repeated) divided by the area. colSum = scratch of w ints (radius > 3).
+void blur_vpass_u16(const uint16_t* tmp, int w, int h, cv::Mat& blurred, int radius,
+                    int y0, int y1, int* colSum);
@@ -0,0 +1,133 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+/*
+BoundedQueue = blocking FIFO with a size limit, any number of producers
+and consumers (a mutex + two condition variables).
+
+SpscQueue is faster, but it only allows ONE thread on each side.
+Frame-parallel video has one decoder feeding N frame workers, so the
+work queue needs a multi-consumer queue. At one pop per frame the mutex
+costs nothing measurable.
+
+close() means "no more items": blocked pushers give up, and poppers
+drain what is left and then get false.
+*/
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(capacity ? capacity : 1) {}
+
+    // Blocks while full. False if the queue was closed.
+    bool push(const T& v) {
+        std::unique_lock<std::mutex> lock(m_);
+        cvNotFull_.wait(lock, [&] { return closed_ || items_.size() < capacity_; });
+        if (closed_) return false;
+        items_.push_back(v);
+        lock.unlock();
+        cvNotEmpty_.notify_one();
+        return true;
+    }
+
+    // Blocks while empty. False once the queue is closed AND drained.
+    bool pop(T& v) {
+        std::unique_lock<std::mutex> lock(m_);
+        cvNotEmpty_.wait(lock, [&] { return closed_ || !items_.empty(); });
+        if (items_.empty()) return false;
+        v = items_.front();
+        items_.pop_front();
+        lock.unlock();
+        cvNotFull_.notify_one();
+        return true;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(m_);
+            closed_ = true;
+        }
+        cvNotFull_.notify_all();
+        cvNotEmpty_.notify_all();
+    }
+
+private:
+    size_t capacity_;
+    std::deque<T> items_;
+    bool closed_ = false;
+    std::mutex m_;
+    std::condition_variable cvNotFull_;
+    std::condition_variable cvNotEmpty_;
+};
+
+/*
+ReorderBuffer = puts out-of-order results back in sequence.
+
+Frame workers finish in any order (a frame can be slower than the one
+after it), but the VideoWriter must receive frames 0, 1, 2, ...
+Workers put(seq, item); the writer calls next() and only gets the item
+with the lowest sequence number not yet handed out.
+
+`window` is the most sequence numbers that can be in flight at once
+(the number of frame slots), so item seq lives in cell seq % window
+and no map/heap is needed.
+*/
+template <typename T>
+class ReorderBuffer {
+public:
+    explicit ReorderBuffer(size_t window) : cells_(window ? window : 1) {}
+
+    void put(uint64_t seq, const T& v) {
+        {
+            std::lock_guard<std::mutex> lock(m_);
+            Cell& c = cells_[seq % cells_.size()];
+            c.item = v;
+            c.full = true;
+            maxWaiting_ = std::max(maxWaiting_, ++waiting_);
+        }
+        cv_.notify_one();
+    }
+
+    // Blocks until item next_ arrives. False once closed and next_ never came.
+    bool next(T& v) {
+        std::unique_lock<std::mutex> lock(m_);
+        Cell* c = &cells_[next_ % cells_.size()];
+        cv_.wait(lock, [&] { return c->full || closed_; });
+        if (!c->full) return false;
+        v = c->item;
+        c->full = false;
+        waiting_--;
+        next_++;
+        return true;
+    }
+
+    // Called when no more put() will happen (all workers done, or error)
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(m_);
+            closed_ = true;
+        }
+        cv_.notify_all();
+    }
+
+    // Largest number of finished frames that sat waiting for an earlier one
+    size_t maxWaiting() const { return maxWaiting_; }
+
+private:
+    struct Cell {
+        T item{};
+        bool full = false;
+    };
+    std::vector<Cell> cells_;
+    uint64_t next_ = 0;
+    size_t waiting_ = 0;
+    size_t maxWaiting_ = 0;
+    bool closed_ = false;
+    std::mutex m_;
+    std::condition_variable cv_;
+};
@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+
+/*
+Runtime CPU feature detection for the SIMD kernels.
+
+The binary is built for a baseline CPU; the faster kernels are compiled
+with per-function target attributes and picked at runtime, so one build
+runs everywhere and still uses AVX2 / AVX-512 when the machine has them.
+
+Levels are ordered: a CPU at level N can run every kernel below N.
+*/
+enum class CpuIsa {
+    SCALAR = 0, // plain C++ (also what non-x86 builds use)
+    SSSE3  = 1, // 128-bit; SSSE3 needed for the byte shuffle (pshufb)
+    AVX2   = 2, // 256-bit
+    AVX512 = 3  // 512-bit (AVX-512 F + BW)
+};
+
+// Best level this CPU supports (detected once)
+CpuIsa detectCpuIsa();
+
+// Level the kernels actually use: min(detected, limit)
+CpuIsa activeCpuIsa();
+
+// Cap the level (for testing/benchmarking the slower kernels)
+void setCpuIsaLimit(CpuIsa limit);
+
+const char* cpuIsaName(CpuIsa isa);
+
+// "scalar" | "ssse3" | "avx2" | "avx512"; throws on anything else
+CpuIsa parseCpuIsa(const std::string& s);
@@ -0,0 +1,83 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "workspace.hpp"
+
+/*
+Compact edge outputs (--edge-format bitmap|rle|sparse, --threshold T).
+
+Consumers that only need to know WHICH pixels are edges don't need an
+8-bit magnitude image, let alone one expanded to BGR and run through a
+video codec. The encoder thresholds the Sobel magnitude (mag >= T) with
+a SIMD row kernel (threshold_bits_row) and emits one of:
+
+  bitmap  1 bit per pixel, rows of (w + 7) / 8 bytes, bit (x & 7) of
+          byte x / 8 (LSB first). Fixed w * h / 8 bytes per frame.
+  rle     per row, run lengths as LEB128 varints, alternating non-edge /
+          edge and starting with a non-edge run (0 if the row starts on
+          an edge); each row's runs add up to w.
+  sparse  one 5-byte record per edge pixel, row-major:
+          x (u16), y (u16), magnitude (u8). Needs w, h <= 65536.
+
+RLE and sparse are found from the packed bits a 64-bit word at a time
+(count-trailing-zeros to the next transition / edge), so empty areas
+cost one word compare per 64 pixels.
+
+Container (.edg), all integers little-endian:
+  file header, 16 bytes:
+    "EDGE", u8 version (1), u8 format (1 bitmap, 2 rle, 3 sparse),
+    u8 threshold, u8 reserved (0), u32 width, u32 height
+  per frame:
+    u32 payload bytes, u32 edge pixels, payload
+*/
+
+enum class EdgeFormat {
+    BITMAP = 1,
+    RLE = 2,
+    SPARSE = 3
+};
+
+const char* edgeFormatName(EdgeFormat f);
+
+// "bitmap" | "rle" | "sparse"; throws on anything else
+EdgeFormat parseEdgeFormat(const std::string& s);
+
+// Encodes one CV_8UC1 edge map at a time. Buffers are kept across frames.
+class EdgeEncoder {
+public:
+    // Throws if the size doesn't fit the format or threshold isn't 1..255
+    void setup(EdgeFormat fmt, int w, int h, int threshold);
+
+    // Threshold + encode; threads == 1 runs on the caller's thread,
+    // otherwise row bands on ws.workers. The payload is parts() in order.
+    void encode(const cv::Mat& edges, int threads, CpuWorkspace& ws);
+
+    int parts() const { return (int)parts_.size(); }
+    const std::vector<uint8_t>& part(int i) const { return parts_[i]; }
+    size_t payloadBytes() const { return payloadBytes_; }
+    uint64_t edgeCount() const { return edgeCount_; }
+
+    EdgeFormat format() const { return fmt_; }
+    int width() const { return w_; }
+    int height() const { return h_; }
+    int threshold() const { return threshold_; }
+
+private:
+    EdgeFormat fmt_ = EdgeFormat::BITMAP;
+    int w_ = 0;
+    int h_ = 0;
+    int threshold_ = 0;
+    size_t rowBytes_ = 0;  // (w + 7) / 8
+    size_t scanStride_ = 0; // rowBytes_ rounded up to whole 64-bit words
+
+    // bitmap: one part, the whole frame. rle/sparse: one part per band of
+    // kBandRows rows, encoded in parallel and written in order.
+    std::vector<std::vector<uint8_t>> parts_;
+    std::vector<uint64_t> counts_;   // edge pixels per part
+    std::vector<uint8_t> scanRows_;  // rle/sparse: one padded bit row per worker
+    size_t payloadBytes_ = 0;
+    uint64_t edgeCount_ = 0;
+};
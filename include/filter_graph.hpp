@@ -0,0 +1,132 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+#include "workspace.hpp"
+#include "sobel_norm.hpp"
+
+/*
+FilterGraph = the chain of filters a frame goes through, built at runtime
+(e.g. from --stages gray,blur:2,sobel) instead of hard-coded in Pipeline.
+
+Each stage declares:
+- the pixel format it reads and writes (so a bad chain fails at startup,
+  not with a garbled frame)
+- its halo: how many neighbour rows/columns one output pixel depends on
+  (blur:r -> r, sobel -> 1). Tiled/ROI processing needs the chain's total.
+  A stage can also be non-local (canny: hysteresis follows an edge across
+  the whole frame); such chains only run on whole frames.
+
+The planner then decides where every intermediate frame lives:
+- intermediates are planes in CpuWorkspace, allocated once per size;
+  so is each stage's scratch (FilterStage::reserve)
+- an intermediate is "live" from the stage that writes it to the stage
+  that reads it; two intermediates whose live ranges don't overlap share
+  one plane (a 5-stage chain needs 2 planes, not 4)
+- the last stage writes straight into the caller's output
+
+run() is also the one place that decides threading (MT or single
+variant of each kernel) and fusion (gray,blur,sobel -> one fused pass).
+*/
+
+enum class PixelFormat {
+    BGR8,   // CV_8UC3
+    GRAY8,  // CV_8UC1
+    PLANAR3 // CV_8UC1, 3h rows: B, G and R planes stacked (colour filtering)
+};
+
+const char* pixelFormatName(PixelFormat f);
+
+// (Re)create m as a (w x h) frame of format f
+void createFrame(cv::Mat& m, PixelFormat f, int w, int h);
+// Same, as a header over fresh memory from ws.arena() (valid as long as ws)
+void createFrame(cv::Mat& m, PixelFormat f, int w, int h, CpuWorkspace& ws);
+
+// canny without thresholds
+const int kCannyDefaultLow = 50;
+const int kCannyDefaultHigh = 150;
+
+class FilterStage {
+public:
+    virtual ~FilterStage() = default;
+
+    virtual const char* name() const = 0;      // "blur" (stable pointer, used for trace spans)
+    virtual std::string label() const { return name(); } // "blur:2"
+    virtual PixelFormat input() const = 0;
+    virtual PixelFormat output() const = 0;
+    virtual int halo() const = 0;
+    // False if an output pixel can depend on pixels beyond halo() (canny)
+    virtual bool local() const { return true; }
+
+    // Carve the scratch run() needs for (w x h) frames on `workers` threads
+    // (called by FilterGraph::plan, so it is not allocated inside a frame)
+    virtual void reserve(int /*w*/, int /*h*/, int /*workers*/, CpuWorkspace& /*ws*/) {}
+
+    // in has input() format; out is (re)created with output() format, same size
+    virtual void run(const cv::Mat& in, cv::Mat& out, int threads, CpuWorkspace& ws) = 0;
+};
+
+class FilterGraph {
+public:
+    // Max stages in one chain (StageTimes keeps a fixed array of this size)
+    static const int kMaxStages = 8;
+
+    // "gray,blur:2,sobel" -> stages. Known stages:
+    //   gray            BGR -> gray (dropped if the frame is already gray)
+    //   planar          BGR -> planar: blur/sobel after it filter every channel
+    //   interleave      planar -> BGR (appended if the chain ends planar)
+    //   blur[:r]        box blur, radius r (default: defaultRadius)
+    //   sobel[:l1|l2|sq] Sobel magnitude (default: defaultNorm)
+    //   canny[:lo:hi]   Canny edges, thresholds on |gx| + |gy| (default 50:150)
+    // `input` is the format frames arrive in (BGR8 from OpenCV, GRAY8 from raw I/O).
+    // The chain must end gray (edge map) or BGR (colour output).
+    // Throws std::runtime_error on unknown stages or mismatched formats.
+    static FilterGraph parse(const std::string& spec, int defaultRadius, SobelNorm defaultNorm,
+                             PixelFormat input = PixelFormat::BGR8);
+
+    // Replace every gray -> blur -> sobel run with the fused line-buffered stage
+    void fuse();
+
+    // Decide which workspace plane each intermediate uses, for (w x h) frames,
+    // and reserve every stage's scratch (sized for ws.workers, if any).
+    // Cheap if already planned for this size.
+    void plan(int w, int h, CpuWorkspace& ws);
+
+    // Run every stage: input (inputFormat()) -> out (format of the last stage).
+    // stageMs[i] receives stage i's time (may be nullptr).
+    void run(const cv::Mat& input, cv::Mat& out, int threads, CpuWorkspace& ws, double* stageMs);
+
+    int size() const { return (int)stages_.size(); }
+    const FilterStage& stage(int i) const { return *stages_[i]; }
+    PixelFormat inputFormat() const { return input_; }
+    PixelFormat outputFormat() const { return stages_.back()->output(); }
+
+    // Sum of all stage halos: how far an output pixel "sees" into the input
+    // (only a bound if local())
+    int totalHalo() const;
+
+    // True if every stage is local: the frame can be cut into tiles/crops
+    bool local() const;
+
+    // "gray -> blur:2 -> sobel"
+    std::string describe() const;
+
+    // Planner results (valid after plan)
+    int plannedPlanes() const { return (int)planeBytes_.size(); }
+    size_t plannedBytes() const;
+
+private:
+    void validate() const;
+
+    std::vector<std::unique_ptr<FilterStage>> stages_;
+    PixelFormat input_ = PixelFormat::BGR8;
+
+    // Plan: intermediate i (output of stage i, i < size-1) lives in plane planeOf_[i]
+    int planW_ = 0;
+    int planH_ = 0;
+    std::vector<int> planeOf_;
+    std::vector<size_t> planeBytes_;
+    std::vector<cv::Mat> views_; // Mat headers over the workspace planes, one per intermediate
+    const void* plannedWs_ = nullptr;
+};
@@ -1,6 +1,8 @@
 #pragma once
 #include <opencv2/opencv.hpp>
+#include <vector>
 #include "workspace.hpp"
+#include "sobel_norm.hpp"
 
 //Converts a color image (BGR) into grayscale
 // Input: bgr (CV_8UC3)
@@ -13,11 +15,13 @@ void grayscale_cpu(const cv::Mat& bgr, cv::Mat& gray, int threads);
 void box_blur_cpu_fast(const cv::Mat& gray, cv::Mat& blurred, int radius, int threads);
 
 //Sobel edge detection on grayscale image
-void sobel_cpu(const cv::Mat& gray, cv::Mat& edges, int threads);
+// Every pixel is computed (rows/columns outside the frame repeat the edge);
+// norm picks how (gx, gy) becomes the output value, see sobel_norm.hpp
+void sobel_cpu(const cv::Mat& gray, cv::Mat& edges, int threads, SobelNorm norm = SobelNorm::L2);
 
 // Multi-threaded versions
 void grayscale_cpu_mt(const cv::Mat& bgr, cv::Mat& gray, int threads);
-void sobel_cpu_mt(const cv::Mat& gray, cv::Mat& edges, int threads);
+void sobel_cpu_mt(const cv::Mat& gray, cv::Mat& edges, int threads, SobelNorm norm = SobelNorm::L2);
 
 /*
 #pragma once prvents the header from being included twice
@@ -40,4 +44,68 @@ void box_blur_cpu_fast_mt_ws(
     int radius,
     int threads,
     CpuWorkspace& ws
-);
\ No newline at end of file
+);
+
+// Single-threaded blur on the same workspace buffers (ws.tmp16/tmp, ws.colSums)
+void box_blur_cpu_fast_ws(const cv::Mat& gray, cv::Mat& blurred, int radius, CpuWorkspace& ws);
+
+// Workspace versions of the other MT filters.
+// They run on ws.workers (a persistent thread pool) instead of
+// spawning and joining fresh std::threads on every call.
+void grayscale_cpu_mt_ws(const cv::Mat& bgr, cv::Mat& gray, int threads, CpuWorkspace& ws);
+void sobel_cpu_mt_ws(const cv::Mat& gray, cv::Mat& edges, int threads, CpuWorkspace& ws,
+                     SobelNorm norm = SobelNorm::L2);
+
+// Box blur at every radius in `radii` from one summed-area table (ws.sat).
+// outs[i] is bit-identical to box_blur_cpu_fast(gray, radii[i]).
+// One table build, then O(1) per pixel per radius. threads == 1 runs on
+// the caller's thread, otherwise on ws.workers.
+void box_blur_sat_multi(
+    const cv::Mat& gray,
+    std::vector<cv::Mat>& outs,
+    const std::vector<int>& radii,
+    int threads,
+    CpuWorkspace& ws
+);
+
+// Colour path (planar_cpu.cpp). A planar frame is CV_8UC1 with 3h rows:
+// the B, G and R planes stacked. Blur/Sobel are the gray filters applied
+// to each plane (bit-identical per channel), in one pass over all planes.
+// threads == 1 runs on the caller's thread, otherwise on ws.workers.
+void bgr_to_planar(const cv::Mat& bgr, cv::Mat& planar, int threads, CpuWorkspace& ws);
+void planar_to_bgr(const cv::Mat& planar, cv::Mat& bgr, int threads, CpuWorkspace& ws);
+void box_blur_planar(const cv::Mat& planar, cv::Mat& blurred, int radius, int threads, CpuWorkspace& ws);
+void sobel_planar(const cv::Mat& planar, cv::Mat& edges, int threads, CpuWorkspace& ws,
+                  SobelNorm norm = SobelNorm::L2);
+
+// Downsampling (downsample_cpu.cpp). One step = rounded 2x2 mean, sizes
+// round down (w / 2) at every step.
+// grayscale_downsample: BGR -> gray at 1/factor (factor = 1, 2, 4, ..., 16):
+// grayscale_cpu followed by log2(factor) steps, without the full-size gray.
+// downsample2_gray: gray -> gray at 1/2, one pyramid step.
+// threads == 1 runs on the caller's thread, otherwise on ws.workers.
+const int kMaxDownsampleFactor = 16;
+bool downsample_factor_ok(int factor); // power of two in [1, kMaxDownsampleFactor]
+void grayscale_downsample(const cv::Mat& bgr, cv::Mat& gray, int factor, int threads, CpuWorkspace& ws);
+void downsample2_gray(const cv::Mat& gray, cv::Mat& out, int threads, CpuWorkspace& ws);
+
+// Fused gray -> blur -> sobel in one streaming pass over row bands.
+// Only a few rows of line buffers (ws.lines) per thread instead of full
+// intermediate frames. Output is identical to grayscale_cpu ->
+// box_blur_cpu_fast -> sobel_cpu. threads == 1 runs on the caller's thread.
+void fused_gray_blur_sobel(
+    const cv::Mat& bgr,
+    cv::Mat& edges,
+    int radius,
+    int threads,
+    CpuWorkspace& ws,
+    SobelNorm norm = SobelNorm::L2
+);
+
+// Canny edges (canny_cpu.cpp): Sobel gradient (L1 magnitude |gx| + |gy|,
+// 0..2040), non-maximum suppression along the quantized gradient
+// direction, then hysteresis: pixels above hi, plus pixels above lo
+// 8-connected to them. Output is 255 (edge) / 0. Scratch is ws.canny.
+// threads == 1 runs on the caller's thread, otherwise on ws.workers;
+// the output does not depend on the thread count.
+void canny_cpu(const cv::Mat& gray, cv::Mat& edges, int lo, int hi, int threads, CpuWorkspace& ws);
@@ -0,0 +1,114 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include "pipeline.hpp"
+#include "workspace.hpp"
+#include "trace.hpp"
+#include "filter_graph.hpp"
+#include <algorithm>
+#include <string>
+
+/*
+Per-frame building blocks shared by every Pipeline mode
+(single image, serial video, pipelined video, ...).
+
+Keeping "process one frame" in one place means a new run mode only has
+to decide WHERE frames come from and go to, not how they are filtered.
+*/
+
+// The filter chain for one frame in flight, plus its output.
+// Intermediates live in the CpuWorkspace planes the graph planned;
+// edges is a header over the workspace arena too.
+struct FrameBuffers {
+    FilterGraph graph;
+    cv::Mat edges;
+
+    // Build the graph from args (--stages, --radius, --sobel-norm, --fused)
+    // and plan/allocate everything for (w x h) frames, once.
+    void setup(const Args& args, int w, int h, CpuWorkspace& ws,
+               PixelFormat input = PixelFormat::BGR8);
+};
+
+// "gray,blur:<radius>,sobel" unless --stages says otherwise; fused if --fused.
+// Gray input (raw I/O) starts at blur: "blur:<radius>,sobel".
+// --color: "planar,blur:<radius>,sobel" (per-channel, BGR output).
+FilterGraph buildGraph(const Args& args, PixelFormat input = PixelFormat::BGR8);
+
+// Time spent in each graph stage (one frame, or summed over many)
+struct StageTimes {
+    double ms[FilterGraph::kMaxStages] = {};
+    int count = 0; // stages in the graph
+
+    double total() const {
+        double t = 0.0;
+        for (int i = 0; i < count; i++) t += ms[i];
+        return t;
+    }
+
+    StageTimes& operator+=(const StageTimes& o) {
+        count = std::max(count, o.count);
+        for (int i = 0; i < o.count; i++) ms[i] += o.ms[i];
+        return *this;
+    }
+};
+
+// Per-frame stage times over a whole run: sums for the averages,
+// histograms for the tail (p50/p90/p99/max).
+// decode/encode/latency are only filled by the modes that measure them.
+struct StageStats {
+    int frames = 0;
+    StageTimes sum;
+    LatencyHistogram stage[FilterGraph::kMaxStages];
+    LatencyHistogram compute; // all stages of one frame
+    LatencyHistogram decode, encode, latency;
+
+    void add(const StageTimes& t) {
+        frames++;
+        sum += t;
+        for (int i = 0; i < t.count; i++) stage[i].add(t.ms[i]);
+        compute.add(t.total());
+    }
+
+    void merge(const StageStats& o) {
+        frames += o.frames;
+        sum += o.sum;
+        for (int i = 0; i < FilterGraph::kMaxStages; i++) stage[i].merge(o.stage[i]);
+        compute.merge(o.compute);
+        decode.merge(o.decode);
+        encode.merge(o.encode);
+        latency.merge(o.latency);
+    }
+};
+
+// Run buf.graph on one BGR frame (threads from args.mode/args.threads).
+// Result ends up in buf.edges; stage times are written into t.
+// Each stage (and the whole frame) is also a trace span when --trace is on.
+void processFrame(const cv::Mat& bgr, FrameBuffers& buf, CpuWorkspace& ws,
+                  const Args& args, StageTimes& t);
+
+// What a BGR video writer gets for a graph output: gray edge maps are
+// expanded into bgr, colour outputs are passed through as they are.
+const cv::Mat& writerFrame(const cv::Mat& out, cv::Mat& bgr);
+
+// Open args.videoPath for reading and args.outPath for writing (mp4v, BGR,
+// same size and fps as the input). Throws if either fails.
+void openVideoIO(const Args& args, cv::VideoCapture& cap, cv::VideoWriter& writer,
+                 int& w, int& h, double& fps);
+// The two halves, for modes whose output size differs from the input's
+void openVideoInput(const Args& args, cv::VideoCapture& cap, int& w, int& h, double& fps);
+void openVideoWriter(cv::VideoWriter& writer, const std::string& path, double fps, int w, int h);
+
+// --tiled rows per band: --tile-rows, else ~1M output pixels (a few MB
+// of intermediates); never more than the image
+int tiledBandRows(const Args& args, int w, int h);
+
+// "output/edges.png", "_r4" -> "output/edges_r4.png"
+std::string suffixedPath(const std::string& path, const std::string& suffix);
+
+// Report helpers
+const char* modeName(Mode m);
+void printPoolStats(const CpuWorkspace& ws);
+void printPoolStats(const PoolStats& s, int pools, int poolSize); // stats summed over `pools` pools
+void printRunHeader(const char* tag, int w, int h, const Args& args); // "[TAG] mode=... size=..." (w = 0: no size)
+void printGraphPlan(const FilterGraph& g); // "stages: gray -> blur:1 -> sobel:l2 (2 planes, ...)"
+// "avg / p50 / p90 / p99 / max" for every stage that has samples
+void printStageStats(const StageStats& st, const FilterGraph& g);
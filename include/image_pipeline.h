@@ -0,0 +1,112 @@
+#ifndef IMAGE_PIPELINE_H
+#define IMAGE_PIPELINE_H
+
+#include <stddef.h>
+
+/*
+C API: run the filter chain in-process on the caller's own pixels.
+
+Forking ./pipeline per request pays process start-up, OpenCV
+initialisation and a cold workspace (arena, planner, worker threads)
+every time. A context keeps all of that alive between calls:
+
+  ip_options opt;
+  ip_options_init(&opt);
+  opt.threads = 8;
+  opt.stages = "gray,blur:2,sobel";      (same syntax as --stages)
+  ip_context* ctx = NULL;
+  if (ip_create(&opt, &ctx) != IP_OK) { puts(ip_last_error(NULL)); ... }
+
+  ip_image in  = { frame, w, h, frame_stride, IP_BGR8 };
+  ip_image out = { edges, w, h, edges_stride, IP_GRAY8 };
+  while (...) ip_process(ctx, &in, &out);   (no allocation after the first frame of a size)
+  ip_destroy(ctx);
+
+Images are caller-owned and never copied: rows are read from / written
+to data + y * stride, so a crop of a bigger buffer (stride > width *
+channels) works as it is. The output must be the input's size, in the
+format ip_output_format() reports, and must not overlap the input.
+
+A context serves one call at a time; use one context per thread (they
+share nothing but the process-wide ISA limit). Errors never cross the
+API as exceptions: every call returns an ip_status, and ip_last_error()
+has the message.
+*/
+
+#if defined(_WIN32)
+#define IP_API
+#else
+#define IP_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bumped when a signature or struct layout changes (also the .so version) */
+#define IP_API_VERSION 1
+
+typedef struct ip_context ip_context;
+
+typedef enum ip_status {
+    IP_OK = 0,
+    IP_ERROR_ARGUMENT = 1, /* bad option, image or stage list */
+    IP_ERROR_MEMORY = 2,   /* workspace could not be allocated */
+    IP_ERROR_FAILED = 3    /* anything else; see ip_last_error */
+} ip_status;
+
+typedef enum ip_format {
+    IP_GRAY8 = 0, /* 1 byte per pixel */
+    IP_BGR8 = 1   /* 3 bytes per pixel, B G R (OpenCV's order) */
+} ip_format;
+
+typedef struct ip_image {
+    void* data;       /* first pixel of row 0 */
+    int width;
+    int height;
+    size_t stride;    /* bytes from one row to the next, >= width * channels */
+    ip_format format;
+} ip_image;
+
+typedef struct ip_options {
+    int threads;            /* 1 = single-threaded, 0 = one per hardware thread (default 1) */
+    int radius;             /* blur radius where the chain doesn't give one (default 1) */
+    const char* stages;     /* filter chain as in --stages; NULL = gray,blur,sobel */
+    const char* sobel_norm; /* "l1" | "l2" | "sq"; NULL = l2 */
+    int fused;              /* nonzero: gray,blur,sobel as one line-buffered pass */
+    int color;              /* nonzero: per-channel chain, BGR output (as --color) */
+} ip_options;
+
+/* IP_API_VERSION of the library actually loaded */
+IP_API int ip_api_version(void);
+
+/* Defaults (as ./pipeline --mode cpu-single with no other flags) */
+IP_API void ip_options_init(ip_options* opt);
+
+/* Validate opt (NULL = defaults) and create a context; *out is NULL on failure.
+   Worker threads are started here, not in the first ip_process. */
+IP_API ip_status ip_create(const ip_options* opt, ip_context** out);
+
+/* Joins the worker threads and frees the workspace. NULL is a no-op. */
+IP_API void ip_destroy(ip_context* ctx);
+
+/* Format the chain writes for input of format `in` */
+IP_API ip_status ip_output_format(ip_context* ctx, ip_format in, ip_format* out);
+
+/* Run the chain on in, writing out. Buffers are sized for the largest
+   frame seen so far, so a steady stream of one size never allocates. */
+IP_API ip_status ip_process(ip_context* ctx, const ip_image* in, const ip_image* out);
+
+/* Message of the last failed call on ctx (NULL: of the last failed
+   ip_create / ip_set_isa_limit on this thread). Valid until the next call. */
+IP_API const char* ip_last_error(const ip_context* ctx);
+
+/* Cap the SIMD level for the whole process: "scalar" | "ssse3" | "avx2" | "avx512"
+   (default: the best the CPU supports). Not for use while another thread is in ip_process. */
+IP_API ip_status ip_set_isa_limit(const char* isa);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IMAGE_PIPELINE_H */
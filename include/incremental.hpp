@@ -0,0 +1,88 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <vector>
+#include "frame_ops.hpp"
+
+/*
+Incremental video filtering (--incremental): only recompute what changed.
+
+A static camera changes a few blocks per frame, yet the graph redoes
+every pixel. Here each decoded frame is compared with the previous one
+in (block x block) tiles:
+
+  1) diff: a tile is dirty if any of its input bytes changed
+  2) an output pixel depends only on inputs within the graph's total
+     halo H (blur radius + 1 for Sobel, ...), so output tiles within
+     ceil(H / block) tiles of a dirty tile are the only ones that can
+     differ from the previous output; the rest keep last frame's pixels
+  3) those tiles are merged into rectangles, and each rectangle runs the
+     graph on its input crop grown by H (clamped to the frame), exactly
+     like a tiled band: pixels near a crop edge that is not a frame edge
+     are wrong, but only within H of it, and only the rectangle itself
+     is copied into the persisted output
+
+So the output is bit-identical to filtering every frame in full. When
+most of the frame changed (cuts, camera motion) the frame is simply
+processed in full.
+
+Rectangles are independent: they run in parallel on the pool, each
+worker with its own single-threaded graph + workspace.
+*/
+
+struct IncrementalStats {
+    uint64_t frames = 0;
+    uint64_t fullFrames = 0;      // first frame + frames above the dirty limit
+    uint64_t blocks = 0;          // tiles seen (all frames)
+    uint64_t changedBlocks = 0;   // tiles whose input changed
+    uint64_t recomputedBlocks = 0;// tiles whose output was recomputed (full frames: all)
+    uint64_t computedPixels = 0;  // input pixels the graph ran on (crops include the halo)
+    uint64_t framePixels = 0;     // w * h * frames
+    uint64_t rects = 0;           // crops run on partial frames
+    LatencyHistogram diff;        // diff + bookkeeping per frame
+};
+
+class IncrementalFilter {
+public:
+    // Same graph as buf (built by FrameBuffers::setup), tiles of `block` px
+    void setup(const Args& args, const FrameBuffers& buf, int w, int h, CpuWorkspace& ws,
+               PixelFormat input = PixelFormat::BGR8);
+
+    // Filter `frame` into buf.edges. buf.edges must still hold the previous
+    // frame's output (it is patched, not rewritten). t receives the stage
+    // times (partial frames: summed over every crop).
+    void process(const cv::Mat& frame, FrameBuffers& buf, CpuWorkspace& ws,
+                 const Args& args, StageTimes& t);
+
+    const IncrementalStats& stats() const { return stats_; }
+
+private:
+    // Per pool worker: its own graph and buffers for crops
+    struct CropWorker {
+        FilterGraph graph;
+        CpuWorkspace ws;
+        ArenaArray<uint8_t> out; // backing store of one crop's output (in ws's arena)
+        StageTimes t;             // summed over this frame's crops
+    };
+
+    void diff(const cv::Mat& frame, ThreadPool* pool);
+    void markRecompute();
+    void buildRects();
+
+    int w_ = 0, h_ = 0;
+    int block_ = 32;
+    int halo_ = 0;
+    int bw_ = 0, bh_ = 0;            // tiles per row / column
+    size_t rowBytes_ = 0;            // bytes per input row
+    int elemSize_ = 1;               // bytes per input pixel
+    bool havePrev_ = false;
+    cv::Mat prev_;                   // last input (only changed tiles are copied in)
+    std::vector<uint8_t> changed_;   // bw_ * bh_: input tile differs from prev_
+    std::vector<uint8_t> recompute_; // bw_ * bh_: output tile must be recomputed
+    std::vector<cv::Rect> rects_;    // output rectangles to recompute this frame
+    std::vector<CropWorker> workers_;
+    IncrementalStats stats_;
+};
+
+// "incremental: 32 px tiles, 91.2% skipped (input changed in 3.1%), ..."
+void printIncrementalStats(const IncrementalStats& s, int block);
@@ -1,5 +1,8 @@
 #pragma once
+#include <opencv2/opencv.hpp>
 #include <string>
+#include <vector>
+#include "sobel_norm.hpp"
 
 enum class Mode {
     CPU_SINGLE,
@@ -10,10 +13,85 @@ enum class Mode {
 struct Args {
     std::string imagePath;
     std::string videoPath;
-    std::string outPath;
+    std::string outPath;  // batch: output directory
+    std::string inputDir; // batch: every image in this directory
+    std::string listPath; // batch: text file, one image path per line
     Mode mode = Mode::CPU_SINGLE;
     int threads = 4;
     int radius = 1;
+    bool fused = false; // gray+blur+sobel in one line-buffered pass
+    bool color = false; // blur + edges per channel on planar frames, BGR output
+    std::string stages; // filter chain, e.g. "gray,blur:2,sobel" (empty = that with --radius)
+    SobelNorm sobelNorm = SobelNorm::L2;
+    std::string tracePath; // non-empty: write a Chrome trace-event JSON here
+
+    // Video: decode / compute / encode on separate threads
+    bool pipelined = false;
+    int queueDepth = 4; // frames allowed to wait between two stages
+
+    // Video: N whole frames processed at once, one frame per worker
+    // (each worker still uses `threads` threads inside its frame in cpu-mt)
+    int framesInFlight = 1;
+
+    // Video (serial): recompute only tiles whose output can change since
+    // the previous frame (exact), tiles of incrementalBlock px
+    bool incremental = false;
+    int incrementalBlock = 32;
+
+    // Video: replay the file at its frame rate x rtSpeed as a live source,
+    // each frame due within rtBudgetMs of capture (0 = one frame period).
+    // Overload: "drop" late frames, "degrade" to blur radius
+    // rtFallbackRadius, or "both" (degrade first, drop if still late)
+    bool realtime = false;
+    double rtSpeed = 1.0;
+    double rtBudgetMs = 0.0;
+    std::string rtOverload = "both";
+    int rtFallbackRadius = 1;
+
+    // Batch: decoder threads and encoder threads (each)
+    int ioThreads = 2;
+
+    // Raw video I/O (y4m | gray); empty = from the file extension.
+    // Raw gray input has no header, so its size comes from --raw-size.
+    std::string inFormat;
+    std::string outFormat;
+    int rawWidth = 0;
+    int rawHeight = 0;
+
+    // Image: blur at every one of these radii from one summed-area table
+    // (rest of the chain runs per radius, one output file each)
+    std::vector<int> blurRadii;
+
+    // Image / serial video: filter only the ROI (roiW = 0: whole frame),
+    // at 1/scale, plus pyramidLevels - 1 further levels each half the size
+    int roiX = 0, roiY = 0, roiW = 0, roiH = 0;
+    int scale = 1;
+    int pyramidLevels = 1;
+
+    // Image / serial video: write edges as a compact .edg container
+    // ("bitmap" | "rle" | "sparse", see edge_codec.hpp) of the pixels whose
+    // magnitude is >= edgeThreshold, instead of an 8-bit image / mp4
+    std::string edgeFormat;
+    int edgeThreshold = 64;
+
+    // Image: out-of-core, memory-mapped PGM/PPM/raw gray processed in row bands
+    bool tiled = false;
+    int tileRows = 0; // rows per band (0 = auto, ~1M pixels)
+
+    // Time kernel/parallel variants for this run's frame size and save the
+    // best in the machine's profile (autotune.hpp); with no input, tune
+    // tuneSizes offline. Later runs apply the profile unless noProfile.
+    bool autotune = false;
+    std::vector<std::pair<int, int>> tuneSizes;
+    std::string profilePath; // empty = TuneProfile::defaultPath()
+    bool noProfile = false;
+
+    // Knobs given on the command line: never tuned, never overridden by a profile
+    bool userThreads = false;
+    bool userGrain = false;
+    bool userIsa = false;
+    bool userFused = false;
+    bool userTileRows = false;
 };
 
 class Pipeline {
@@ -21,6 +99,20 @@ public:
     void run(const Args& args);
 
 private:
+    // The input image: decoded once if configureRun already did (to learn its size)
+    cv::Mat loadImage(const Args& args);
+
     void runImage(const Args& args);
     void runVideo(const Args& args);
+    void runVideoPipelined(const Args& args);     // pipeline_video.cpp
+    void runVideoFrameParallel(const Args& args); // pipeline_frames.cpp
+    void runBatch(const Args& args);              // pipeline_batch.cpp
+    void runVideoRaw(const Args& args);           // pipeline_raw.cpp
+    void runImageTiled(const Args& args);         // pipeline_tiled.cpp
+    void runImageMultiBlur(const Args& args);     // pipeline_multiscale.cpp
+    void runVideoRealtime(const Args& args);      // pipeline_realtime.cpp
+    void runImageRegion(const Args& args);        // pipeline_region.cpp
+    void runVideoRegion(const Args& args);        // pipeline_region.cpp
+
+    cv::Mat image_;
 };
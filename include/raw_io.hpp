@@ -0,0 +1,183 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "edge_codec.hpp"
+
+/*
+Raw frame I/O: YUV4MPEG2 (.y4m) and headerless 8-bit gray frames.
+
+The OpenCV video path decodes mp4v to BGR, the gray stage throws the
+colour away, and the writer converts back to BGR and encodes again.
+When the tools on either side speak raw frames, none of that is needed:
+  - a Y4M frame's Y plane IS the grayscale image (chroma is skipped)
+  - an edges frame can be written as-is (Y4M "Cmono" or raw bytes)
+
+Input files are memory-mapped and every frame is handed out as a
+CV_8UC1 Mat header pointing into the mapping: no read(), no copy, no
+allocation per frame. Pipes ("-" = stdin/stdout) can't be mapped, so
+frames are read into one reused buffer instead.
+*/
+
+enum class RawFormat {
+    Y4M,  // YUV4MPEG2, 8-bit; only the Y plane is used / written as Cmono
+    GRAY  // headerless w*h bytes per frame (size from --raw-size)
+};
+
+const char* rawFormatName(RawFormat f);
+
+// "y4m" | "gray"; throws on anything else
+RawFormat parseRawFormat(const std::string& s);
+
+// From the file extension: .y4m -> Y4M, .gray/.y/.raw -> GRAY.
+// False if the extension isn't a raw format (e.g. .mp4, or "-").
+bool rawFormatFromPath(const std::string& path, RawFormat& f);
+
+// --in-format/--out-format value if given, else from the path's extension.
+// False if neither names a raw format (use the OpenCV codecs).
+bool resolveRawFormat(const std::string& flag, const std::string& path, RawFormat& f);
+
+// Mapping of a whole file (POSIX mmap). Unmapped on destruction.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Read-only. Throws if the file can't be opened or mapped.
+    void open(const std::string& path);
+
+    // Create/truncate path to `size` bytes and map it writable (shared:
+    // stores go to the file). Throws on failure.
+    void create(const std::string& path, size_t size);
+
+    // Writable mappings: flush, then unmap. Throws if the flush fails.
+    void close();
+
+    // Drop the pages fully inside [offset, offset + n) from this process
+    // (written ones are flushed first). They stay in the file / page cache
+    // and are faulted back in if touched again. Keeps RSS bounded when a
+    // huge file is streamed through the mapping front to back.
+    void release(size_t offset, size_t n);
+
+    const uint8_t* data() const { return data_; }
+    uint8_t* writableData() { return writable_ ? data_ : nullptr; }
+    size_t size() const { return size_; }
+
+private:
+    uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    bool writable_ = false;
+};
+
+// Binary PGM (P5) / PPM (P6) header, 8-bit only
+struct PnmHeader {
+    int w = 0;
+    int h = 0;
+    int channels = 0;     // 1 = P5 gray, 3 = P6 RGB
+    size_t dataOffset = 0; // first pixel byte
+};
+
+// Parse the header at the start of data. Throws on anything but 8-bit P5/P6.
+PnmHeader parsePnmHeader(const uint8_t* data, size_t size);
+
+// "P5\n<w> <h>\n255\n"
+std::string pgmHeader(int w, int h);
+
+class RawFrameReader {
+public:
+    ~RawFrameReader();
+
+    // path "-" reads stdin. GRAY needs w x h; Y4M takes its size from the header.
+    void open(const std::string& path, RawFormat fmt, int w = 0, int h = 0);
+
+    // Next frame's luma as a CV_8UC1 view, valid until the next call.
+    // False at end of stream; throws on a truncated or malformed frame.
+    bool next(cv::Mat& gray);
+
+    int width() const { return w_; }
+    int height() const { return h_; }
+    int fpsNum() const { return fpsNum_; }
+    int fpsDen() const { return fpsDen_; }
+    bool mapped() const { return file_.data() != nullptr; } // zero-copy frames
+    uint64_t bytesRead() const { return bytes_; }
+
+private:
+    void parseY4mHeader(const std::string& line);
+    bool readLine(std::string& line); // up to '\n' (not included); false at EOF
+
+    RawFormat fmt_ = RawFormat::GRAY;
+    int w_ = 0;
+    int h_ = 0;
+    int fpsNum_ = 30;
+    int fpsDen_ = 1;
+    size_t chromaBytes_ = 0; // per frame, skipped
+
+    // Mapped input: frames are views at pos_
+    MappedFile file_;
+    size_t pos_ = 0;
+
+    // Pipe input: frames are copied into luma_
+    std::FILE* pipe_ = nullptr;
+    std::vector<uint8_t> luma_;
+    std::vector<uint8_t> skip_;
+
+    uint64_t bytes_ = 0;
+};
+
+class RawFrameWriter {
+public:
+    ~RawFrameWriter();
+
+    // path "-" writes stdout. fps only goes into the Y4M header.
+    void open(const std::string& path, RawFormat fmt, int w, int h, int fpsNum = 30, int fpsDen = 1);
+
+    // gray: CV_8UC1, w x h. Throws on a write error.
+    void write(const cv::Mat& gray);
+
+    // Flush and close (also done by the destructor, which can't report errors)
+    void close();
+
+    uint64_t bytesWritten() const { return bytes_; }
+
+private:
+    void put(const void* p, size_t n);
+
+    RawFormat fmt_ = RawFormat::GRAY;
+    int w_ = 0;
+    int h_ = 0;
+    std::FILE* f_ = nullptr;
+    bool ownsFile_ = false;
+    std::vector<char> ioBuf_; // stdio buffer of a file (not stdout), a few frames deep
+    uint64_t bytes_ = 0;
+};
+
+// Compact edge container (.edg, layout in edge_codec.hpp): file header
+// at open, then one record per EdgeEncoder frame
+class EdgeFileWriter {
+public:
+    ~EdgeFileWriter();
+
+    // path "-" writes stdout
+    void open(const std::string& path, const EdgeEncoder& enc);
+
+    // The frame enc encoded last. Throws on a write error.
+    void write(const EdgeEncoder& enc);
+
+    // Flush and close (also done by the destructor, which can't report errors)
+    void close();
+
+    uint64_t bytesWritten() const { return bytes_; }
+
+private:
+    void put(const void* p, size_t n);
+
+    std::FILE* f_ = nullptr;
+    bool ownsFile_ = false;
+    std::vector<char> ioBuf_; // stdio buffer of a file (not stdout)
+    uint64_t bytes_ = 0;
+};
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include "sobel_norm.hpp"
+
+/*
+Row-level building blocks shared by every filter path.
+
+The full-frame filters (filters_cpu.cpp) and the fused streaming path
+(fused_cpu.cpp) both call these, one row at a time, so the two paths can
+never compute a pixel differently.
+
+All pointers point at the first pixel of a row; w = row width in pixels.
+*/
+
+// One row of BGR (3 bytes per pixel) -> one row of gray.
+// Fixed-point weights (see simd_gray.cpp); SIMD kernel picked at runtime.
+void grayscale_row(const uint8_t* bgr, uint8_t* gray, int w);
+
+// One row of BGR <-> three rows, one per channel (simd_planar.cpp)
+void deinterleave_row(const uint8_t* bgr, uint8_t* b, uint8_t* g, uint8_t* r, int w);
+void interleave_row(const uint8_t* b, const uint8_t* g, const uint8_t* r, uint8_t* bgr, int w);
+
+// One pyramid step (simd_downsample.cpp): out[x] = rounded mean of
+// a[2x], a[2x+1], b[2x], b[2x+1] for x < ow. out may alias a (in place).
+void downsample2_row(const uint8_t* a, const uint8_t* b, uint8_t* out, int ow);
+
+// Edge map row -> packed bits (simd_threshold.cpp): bit (x & 7) of
+// bits[x / 8] = mag[x] >= threshold. Writes (w + 7) / 8 bytes; bits past
+// w in the last byte are 0.
+void threshold_bits_row(const uint8_t* mag, uint8_t* bits, int w, uint8_t threshold);
+
+// Canny gradient row (simd_canny.cpp): Sobel like sobel_row (same row and
+// column clamping), but keeps mag[x] = |gx| + |gy| unclipped (<= 2040) and
+// dir[x] = which neighbour pair non-maximum suppression compares:
+const uint8_t kCannyDirH = 0; // left / right            (gradient ~horizontal)
+const uint8_t kCannyDirD = 1; // above-left / below-right (gx, gy same sign)
+const uint8_t kCannyDirV = 2; // above / below            (gradient ~vertical)
+const uint8_t kCannyDirA = 3; // above-right / below-left (gx, gy opposite signs)
+void canny_grad_row(const uint8_t* row_m1, const uint8_t* row_0, const uint8_t* row_p1,
+                    int16_t* mag, uint8_t* dir, int w);
+
+// Non-maximum suppression + double threshold for one row (simd_canny.cpp).
+// up/mc/dn = magnitude rows y-1, y, y+1, each readable at [-1, w] (the
+// caller pads them). out[x] = kCannyStrong (> hi), kCannyWeak (> lo) or
+// 0, nonzero only if mc[x] is strictly above its left/upper neighbour
+// along dir[x] and at least the other one.
+const uint8_t kCannyStrong = 255;
+const uint8_t kCannyWeak = 1;
+void canny_nms_row(const int16_t* up, const int16_t* mc, const int16_t* dn, const uint8_t* dir,
+                   uint8_t* out, int w, int lo, int hi);
+
+// Horizontal box-blur sums for one row (window [x-radius, x+radius], edge pixels repeated)
+// sums[x] is NOT divided yet; the vertical pass divides by (2r+1)^2
+void blur_hsum_row(const uint8_t* row, int* sums, int w, int radius);
+
+// Vertical blur pass, one row at a time (colSum = running sum per column)
+void blur_vsum_add_row(int* colSum, const int* sums, int w);                    // colSum += sums
+void blur_vsum_slide_row(int* colSum, const int* in, const int* out, int w);    // colSum += in - out
+void blur_divide_row(const int* colSum, uint8_t* outRow, int w, int area);      // out = colSum / area
+
+// One row of Sobel magnitude from the rows above/at/below (simd_sobel.cpp).
+// The caller clamps the row pointers at the top/bottom of the frame
+// (row -1 = row 0); columns 0 and w-1 repeat the edge pixel inside.
+void sobel_row(const uint8_t* row_m1, const uint8_t* row_0, const uint8_t* row_p1,
+               uint8_t* outRow, int w, SobelNorm norm);
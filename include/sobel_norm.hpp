@@ -0,0 +1,20 @@
+#pragma once
+#include <string>
+
+/*
+How the Sobel gradient (gx, gy) becomes one 8-bit edge value.
+
+Every Sobel path (cpu-single, cpu-mt, fused, scalar or SIMD) goes through
+the same sobel_row kernel, so for a given norm they all produce the
+same pixels.
+*/
+enum class SobelNorm {
+    L1,      // |gx| + |gy|, saturated to 255 (cheapest)
+    L2,      // floor(sqrt(gx^2 + gy^2)), saturated to 255 (exact, the default)
+    SQUARED  // (gx^2 + gy^2) / 256, saturated to 255 (no sqrt; stronger edges stand out more)
+};
+
+const char* sobelNormName(SobelNorm n);
+
+// "l1" | "l2" | "sq"; throws on anything else
+SobelNorm parseSobelNorm(const std::string& s);
@@ -0,0 +1,131 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+/*
+SpscQueue = bounded single-producer / single-consumer ring buffer.
+
+Exactly one thread pushes and exactly one thread pops, so we need no
+mutex: the producer only writes tail_, the consumer only writes head_,
+and acquire/release ordering on those two counters publishes the slot
+contents. head_ and tail_ sit on separate cache lines so the two
+threads don't keep stealing the same line from each other.
+
+In the video pipeline the items are small slot indices; the frames
+themselves live in a fixed array and are recycled, never allocated.
+*/
+
+// What one side of a queue experienced.
+// Producer-side fields are only written by the producer, consumer-side
+// fields only by the consumer, so no atomics are needed for them.
+struct QueueStats {
+    // producer side
+    uint64_t pushes = 0;
+    uint64_t fullStalls = 0;  // pushes that found the queue full
+    double fullWaitMs = 0.0;  // time spent waiting for space
+
+    // consumer side
+    uint64_t pops = 0;
+    uint64_t emptyStalls = 0; // pops that found the queue empty
+    double emptyWaitMs = 0.0; // time spent waiting for an item
+    uint64_t occupancySum = 0; // queue length seen at each pop
+
+    double avgOccupancy() const { return pops ? (double)occupancySum / pops : 0.0; }
+};
+
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity) {
+        // Round up to a power of two so "index & mask_" replaces "%"
+        size_t cap = 1;
+        while (cap < capacity) cap <<= 1;
+        buf_.resize(cap);
+        mask_ = cap - 1;
+        capacity_ = capacity;
+    }
+
+    size_t capacity() const { return capacity_; }
+
+    size_t size() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    // Non-blocking; false if full
+    bool tryPush(const T& v) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) >= capacity_) return false;
+        buf_[tail & mask_] = v;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Non-blocking; false if empty
+    bool tryPop(T& v) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) return false;
+        v = buf_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Blocking push: spin, then yield, then sleep while full.
+    // Returns false (without pushing) if abort becomes true.
+    bool push(const T& v, const std::atomic<bool>& abort) {
+        stats_.pushes++;
+        if (tryPush(v)) return true;
+
+        stats_.fullStalls++;
+        auto t0 = std::chrono::steady_clock::now();
+        for (int spins = 0; !tryPush(v); spins++) {
+            if (abort.load(std::memory_order_relaxed)) return false;
+            backoff(spins);
+        }
+        stats_.fullWaitMs += msSince(t0);
+        return true;
+    }
+
+    // Blocking pop (same waiting strategy as push)
+    bool pop(T& v, const std::atomic<bool>& abort) {
+        stats_.pops++;
+        stats_.occupancySum += size();
+        if (tryPop(v)) return true;
+
+        stats_.emptyStalls++;
+        auto t0 = std::chrono::steady_clock::now();
+        for (int spins = 0; !tryPop(v); spins++) {
+            if (abort.load(std::memory_order_relaxed)) return false;
+            backoff(spins);
+        }
+        stats_.emptyWaitMs += msSince(t0);
+        return true;
+    }
+
+    // Read after both sides have finished (threads joined)
+    const QueueStats& stats() const { return stats_; }
+
+private:
+    static void backoff(int spins) {
+        if (spins < 64) return;                      // hot spin: item is usually close
+        if (spins < 1024) std::this_thread::yield(); // let the other stage run
+        else std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+
+    static double msSince(std::chrono::steady_clock::time_point t0) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    }
+
+    std::vector<T> buf_;
+    size_t mask_ = 0;
+    size_t capacity_ = 0;
+
+    alignas(64) std::atomic<size_t> head_{0}; // next slot to pop (consumer)
+    alignas(64) std::atomic<size_t> tail_{0}; // next slot to push (producer)
+
+    // Producer and consumer fields are disjoint; each is written by one thread
+    alignas(64) QueueStats stats_;
+};
@@ -0,0 +1,133 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ThreadPool = a fixed team of worker threads that we create ONCE and reuse.
+
+Why?
+- before, every MT filter did: spawn N std::threads -> work -> join
+- a video frame runs 4 of those batches (gray, blur x2, sobel)
+- creating/joining threads costs real time (tens of microseconds each)
+
+Now the threads are created once, sleep ("park") on a condition variable
+between jobs, and wake up when parallel_for() hands them a new range.
+
+The calling thread also does work: it is worker 0,
+so a pool of size N only owns N-1 std::threads.
+
+Scheduling: work stealing over row bands.
+A static split (one chunk per worker) makes every job as slow as its
+slowest worker: a preempted thread, or an E-core next to P-cores,
+finishes last and everybody waits at the join. Instead each job is cut
+into tasks of `grain` items (rows, for the row kernels), several per
+worker. Every worker starts on its own contiguous block of tasks (same
+locality as the old static split), and a worker that runs out steals
+the back half of the next non-empty block it finds.
+
+A worker's block is one 64-bit atomic word (next task, end task): the
+owner takes tasks from the front, thieves cut from the back, both with
+a compare-and-swap, so there is no lock on the task path.
+*/
+
+// Accumulated timing for every parallel_for() call on a pool.
+struct PoolStats {
+    uint64_t dispatches = 0; // how many parallel_for calls
+    double wallMs = 0.0;     // time from dispatch to "all chunks done"
+    double computeMs = 0.0;  // time of the slowest chunk in each call (critical path)
+    double busyMs = 0.0;     // sum of all chunk times (all threads)
+    double idleMs = 0.0;     // sum over workers of (job wall time - own busy time)
+    uint64_t tasks = 0;      // row bands run
+    uint64_t steals = 0;     // successful steals (each moves half a block)
+
+    // Everything that is not the slowest chunk's own work:
+    // waking workers, handing out ranges, waiting at the join.
+    double overheadMs() const { return wallMs > computeMs ? wallMs - computeMs : 0.0; }
+
+    PoolStats& operator+=(const PoolStats& o) {
+        dispatches += o.dispatches;
+        wallMs += o.wallMs;
+        computeMs += o.computeMs;
+        busyMs += o.busyMs;
+        idleMs += o.idleMs;
+        tasks += o.tasks;
+        steals += o.steals;
+        return *this;
+    }
+};
+
+class ThreadPool {
+public:
+    // Body of a parallel loop: process [begin, end) on worker `tid`.
+    // tid is in [0, size()) and can be used to pick per-thread scratch memory.
+    using RangeFn = std::function<void(int begin, int end, int tid)>;
+
+    explicit ThreadPool(int threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Number of workers including the calling thread
+    int size() const { return size_; }
+
+    // Split [begin, end) into tasks of grain items and run fn on each,
+    // balanced by work stealing. A worker may run several tasks (tid is
+    // the worker, so per-tid scratch is never used by two tasks at once).
+    // minGrain: smallest useful task (e.g. when every task recomputes a halo).
+    // Blocks until every task is done. If a task throws, the first
+    // exception is rethrown here after all tasks have finished.
+    void parallel_for(int begin, int end, const RangeFn& fn, int minGrain = 1);
+
+    // Items per task: 0 = auto (kTasksPerWorker tasks per worker).
+    // setDefaultGrain applies to pools created afterwards (--grain).
+    void setGrain(int items) { grain_ = items > 0 ? items : 0; }
+    int grain() const { return grain_; }
+    static void setDefaultGrain(int items);
+    static const int kTasksPerWorker = 4;
+
+    const PoolStats& stats() const { return stats_; }
+    void resetStats() { stats_ = PoolStats{}; }
+
+private:
+    void workerLoop(int id);
+    void runWorker(int id);
+    bool popOwn(int id, int& task);
+    bool steal(int id, int& task);
+
+    // One worker's block of tasks, packed as (next << 32 | end);
+    // a cache line each so workers don't contend on each other's words
+    struct alignas(64) TaskRange {
+        std::atomic<uint64_t> range{0};
+        uint64_t tasks = 0;  // this job, written by the owner only
+        uint64_t steals = 0;
+    };
+
+    int size_ = 1;
+    std::vector<std::thread> workers_;
+
+    std::mutex m_;
+    std::condition_variable cvWork_; // workers wait here for a new job
+    std::condition_variable cvDone_; // caller waits here for the join
+    uint64_t generation_ = 0;        // bumped once per job
+    int pending_ = 0;                // workers that have not finished the current job
+    bool stop_ = false;
+
+    // Current job (only valid while a parallel_for is running)
+    const RangeFn* fn_ = nullptr;
+    int begin_ = 0;
+    int end_ = 0;
+    int taskItems_ = 0;               // items per task for this job
+    std::vector<TaskRange> ranges_;   // one per worker
+    std::vector<double> chunkMs_;     // per-worker time spent in fn for this job
+    std::exception_ptr error_;
+    int grain_ = 0;
+
+    PoolStats stats_;
+};
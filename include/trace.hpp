@@ -0,0 +1,112 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+Instrumentation: latency histograms + optional timeline trace.
+
+Two things the old "sum the Timer values, print the average" couldn't do:
+
+1) Tail latency. One 40 ms frame in a thousand 8 ms frames barely moves
+   the average but breaks a real-time deadline. LatencyHistogram keeps
+   every sample in a fixed array of log-spaced buckets (~1.6% wide), so
+   recording is a couple of integer ops and p50/p90/p99/max come for free.
+
+2) What each thread did, when. With --trace out.json every TraceSpan
+   (frame, stage, pool chunk, decode, encode) is appended to a per-thread
+   span buffer and written at the end as Chrome trace-event JSON. Open it
+   in chrome://tracing or https://ui.perfetto.dev to see thread imbalance
+   and stalls on a timeline.
+
+Span buffers are allocated once per thread (on its first span) and never
+grow; when one is full further spans on that thread are counted as
+dropped instead of allocating. With tracing off a span is just the
+stopwatch it already was.
+*/
+
+// ---------- latency histogram ----------
+
+class LatencyHistogram {
+public:
+    void add(double ms);
+    void merge(const LatencyHistogram& o);
+
+    uint64_t count() const { return count_; }
+    double mean() const { return count_ ? sumMs_ / (double)count_ : 0.0; }
+    double max() const { return maxMs_; }
+
+    // p in [0, 1]. Returns the upper edge of the bucket holding that rank
+    // (never under-reports), capped at the true max.
+    double percentile(double p) const;
+
+private:
+    // Values are kept in nanoseconds. Below 64 ns: one bucket per ns.
+    // Above: 64 linear sub-buckets per power of two.
+    static const int kSub = 64;
+    static const int kMaxExp = 42; // ~73 minutes; larger values land in the last bucket
+    static int bucketOf(uint64_t ns);
+    static uint64_t bucketUpper(int b);
+
+    static const int kBuckets = kSub * (kMaxExp - 5);
+
+    uint32_t buckets_[kBuckets] = {};
+    uint64_t count_ = 0;
+    double sumMs_ = 0.0;
+    double maxMs_ = 0.0;
+};
+
+// ---------- timeline trace ----------
+
+// Start recording spans. spansPerThread bounds each thread's buffer.
+void traceEnable(size_t spansPerThread = (size_t)1 << 16);
+bool traceEnabled();
+
+// Label the calling thread in the timeline ("decoder", "frame worker 2", ...)
+void traceNameThread(const std::string& name);
+
+// Frame number attached to spans started on this thread (-1 = none)
+void traceSetFrame(int64_t frame);
+
+// Record a finished span that began at `start` and lasted durNs, on the calling thread
+void traceRecord(const char* name, const char* cat,
+                 std::chrono::steady_clock::time_point start, int64_t durNs);
+
+// Write everything recorded so far as Chrome trace-event JSON.
+// Call after the threads that recorded have been joined. Throws on IO error.
+// Returns the number of spans dropped because a buffer was full.
+uint64_t traceWriteChrome(const std::string& path);
+
+// RAII span + stopwatch: measures from construction to end() (or destruction)
+// and, if tracing is on, records it. name/cat must be string literals.
+class TraceSpan {
+public:
+    TraceSpan(const char* name, const char* cat)
+        : name_(name), cat_(cat), start_(std::chrono::steady_clock::now()) {}
+
+    ~TraceSpan() { end(); }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    // Stop (first call only) and return the elapsed milliseconds
+    double end() {
+        if (!done_) {
+            auto now = std::chrono::steady_clock::now();
+            durNs_ = std::chrono::duration_cast<std::chrono::nanoseconds>(now - start_).count();
+            done_ = true;
+            if (traceEnabled()) {
+                traceRecord(name_, cat_, start_, durNs_);
+            }
+        }
+        return (double)durNs_ / 1e6;
+    }
+
+private:
+    const char* name_;
+    const char* cat_;
+    std::chrono::steady_clock::time_point start_;
+    int64_t durNs_ = 0;
+    bool done_ = false;
+};
@@ -1,6 +1,10 @@
 #pragma once
 #include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <vector>
+#include "arena.hpp"
+#include "thread_pool.hpp"
 
 /*
 this struct stores reusable memory buffers for processing
@@ -9,23 +13,132 @@ Why do we want this?
 
 Because allocating memory every frame is wasteful
 we allocate once and keep reusing it
+
+All buffers are carved from one Arena (arena.hpp): 64-byte aligned,
+optionally on huge pages and prefaulted. Stages carve what they need
+when the graph is planned (FilterStage::reserve), so nothing is
+allocated or first-touched inside a frame.
 */
 
 struct CpuWorkspace {
+    // Backing memory of every buffer below, created on first use with
+    // Arena::defaultOptions() (--hugepages / --prefault)
+    std::unique_ptr<Arena> mem;
+
+    Arena& arena() {
+        if (!mem) mem = std::make_unique<Arena>();
+        return *mem;
+    }
+
     int w = 0;
     int h = 0;
-    std::vector<int> tmp; // used by blur (stores horizontal sums)
+    ArenaArray<uint16_t> tmp16; // used by blur (horizontal sums, radius <= 128)
+    ArenaArray<int> tmp;        // used by blur (horizontal sums, wider radii)
 
-    //Ensure tmp is big enough for an image of size (w x h)
-    //If size changed, resize once; otherwise do nothing
-    void ensureSize(int width, int height) {
-        if (width == w && height == h) {
-            return; // no change -> keep using exisiting memory
-        }
+    //Ensure the blur's tmp is big enough for an image of size (w x h)
+    //narrowBlur picks which one (see blur_narrow.hpp); the other stays empty
+    //Never shrinks: a smaller frame reuses the memory
+    void ensureSize(int width, int height, bool narrowBlur = true) {
         w = width;
         h = height;
+        size_t n = (size_t)w * (size_t)h;
+        if (narrowBlur) tmp16.ensure(arena(), n);
+        else tmp.ensure(arena(), n);
+    }
+
+    // Running column sums for the row-oriented vertical blur pass:
+    // one row of w ints per worker, indexed by the pool's tid
+    ArenaArray<int> colSums;
+
+    void ensureColSums(int workers) {
+        colSums.ensure(arena(), (size_t)workers * (size_t)w);
+    }
+
+    // Line buffers for the fused gray -> blur -> sobel path.
+    // One set per worker; each only holds a few rows, never a full frame.
+    struct LineBuffers {
+        ArenaArray<uint8_t> gray;    // 1 row: grayscale of the row being loaded
+        ArenaArray<int> hsum;        // (2r+2) rows: ring of horizontal blur sums
+        ArenaArray<int> colSum;      // 1 row: running vertical sum of hsum rows
+        ArenaArray<uint8_t> blurred; // 3 rows: ring of blurred rows for sobel
+    };
+    std::vector<LineBuffers> lines;
+
+    //Ensure there is one set of line buffers per worker for this width/radius
+    void ensureLines(int workers, int width, int radius) {
+        size_t ringRows = 2 * (size_t)radius + 2;
+        if (lines.size() != (size_t)workers) lines.resize(workers);
+        for (LineBuffers& lb : lines) {
+            lb.gray.ensure(arena(), width);
+            lb.hsum.ensure(arena(), ringRows * width);
+            lb.colSum.ensure(arena(), width);
+            lb.blurred.ensure(arena(), 3 * (size_t)width);
+        }
+    }
+
+    // Line buffers for canny_cpu (canny_cpu.cpp), one set per worker:
+    // gradient of the 3 rows around the row being thinned
+    struct CannyBuffers {
+        ArenaArray<int16_t> mag;    // 3 rows of (w + 2): ring of |gx| + |gy|, a 0 column each side
+        ArenaArray<uint8_t> dir;    // 3 rows of w: ring of quantized directions
+        std::vector<uint32_t> stack; // hysteresis flood (pixel indices); grows with the edges, kept
+    };
+    std::vector<CannyBuffers> canny;
 
-        //Allocate exactly w*h ints
-        tmp.assign((size_t)w * (size_t)h, 0);
+    void ensureCanny(int workers, int width) {
+        if (canny.size() < (size_t)workers) canny.resize(workers);
+        for (CannyBuffers& cb : canny) {
+            cb.mag.ensure(arena(), 3 * ((size_t)width + 2));
+            cb.dir.ensure(arena(), 3 * (size_t)width);
+        }
+    }
+
+    // Summed-area table for box_blur_sat_multi (sat_blur.cpp):
+    // (h + 2*pad + 1) rows of satStride = (w + 2*pad + 1) uint32 sums
+    ArenaArray<uint32_t> sat;
+    int satStride = 0;
+
+    void ensureSat(int width, int height, int pad) {
+        satStride = width + 2 * pad + 1;
+        size_t need = (size_t)satStride * ((size_t)height + 2 * pad + 1);
+        sat.ensure(arena(), need);
+    }
+
+    // Line buffers for grayscale_downsample (downsample_cpu.cpp):
+    // `factor` gray rows of downStride bytes per worker
+    ArenaArray<uint8_t> downRows;
+    int downStride = 0;
+
+    void ensureDownsample(int workers, int factor, int width) {
+        downStride = width;
+        size_t need = (size_t)workers * (size_t)factor * (size_t)width;
+        downRows.ensure(arena(), need);
+    }
+
+    // Intermediate frames for a FilterGraph (filter_graph.cpp).
+    // The planner decides how many and how big; stages whose outputs are
+    // never alive at the same time share one plane.
+    std::vector<ArenaArray<uint8_t>> planes;
+
+    //Ensure planes[i] holds at least bytes[i] bytes (never shrinks, so
+    //replanning for a smaller frame keeps the memory)
+    void ensurePlanes(const std::vector<size_t>& bytes) {
+        if (planes.size() < bytes.size()) planes.resize(bytes.size());
+        for (size_t i = 0; i < bytes.size(); i++) planes[i].ensure(arena(), bytes[i]);
+    }
+
+    // Worker threads for the MT filters.
+    // Created on first use and kept alive across stages and frames,
+    // so a video run spawns its threads exactly once.
+    std::unique_ptr<ThreadPool> workers;
+
+    //Ensure the pool has `threads` workers
+    //If the count changed, rebuild it once; otherwise reuse the parked threads
+    ThreadPool& ensureThreads(int threads) {
+        if (threads < 1) threads = 1;
+        if (!workers || workers->size() != threads) {
+            workers = std::make_unique<ThreadPool>(threads);
+        }
+        return *workers;
     }
 };
\ No newline at end of file
@@ -0,0 +1,132 @@
+#include "arena.hpp"
+
+#include <sys/mman.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// Address space reserved per arena. Only committed pages cost memory;
+// 16 GB of addresses is far beyond any frame's buffers.
+const size_t kReserveBytes = (size_t)1 << 34;
+const size_t kPageBytes = 4096;
+
+std::mutex g_optsMutex;
+ArenaOptions g_opts;
+
+size_t roundUp(size_t n, size_t a) {
+    return (n + a - 1) / a * a;
+}
+
+} // namespace
+
+const char* hugePagesName(HugePages h) {
+    switch (h) {
+        case HugePages::OFF:      return "off";
+        case HugePages::THP:      return "thp";
+        case HugePages::EXPLICIT: return "explicit";
+    }
+    return "unknown";
+}
+
+HugePages parseHugePages(const std::string& s) {
+    if (s == "off")      return HugePages::OFF;
+    if (s == "thp")      return HugePages::THP;
+    if (s == "explicit") return HugePages::EXPLICIT;
+    throw std::runtime_error("Unknown --hugepages mode: " + s + " (off|thp|explicit)");
+}
+
+void Arena::setDefaultOptions(ArenaOptions opts) {
+    std::lock_guard<std::mutex> lock(g_optsMutex);
+    g_opts = opts;
+}
+
+ArenaOptions Arena::defaultOptions() {
+    std::lock_guard<std::mutex> lock(g_optsMutex);
+    return g_opts;
+}
+
+Arena::Arena(ArenaOptions opts) : opts_(opts), pages_(opts.hugePages) {
+    // Reserve addresses only (PROT_NONE): commit() makes them usable.
+    // One extra commit step so the base can be rounded to a 2 MB boundary.
+    size_t want = kReserveBytes;
+    void* m = MAP_FAILED;
+    while (want >= ((size_t)1 << 28)) {
+        m = mmap(nullptr, want + kCommitStep, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (m != MAP_FAILED) break;
+        want /= 2; // small address space (32-bit, ulimit -v)
+    }
+    if (m == MAP_FAILED) throw std::runtime_error(std::string("Arena: mmap reserve failed: ") + std::strerror(errno));
+
+    mapping_ = m;
+    mappingBytes_ = want + kCommitStep;
+    base_ = reinterpret_cast<uint8_t*>(roundUp(reinterpret_cast<uintptr_t>(m), kCommitStep));
+    reserved_ = want;
+}
+
+Arena::~Arena() {
+    if (mapping_) munmap(mapping_, mappingBytes_);
+}
+
+// Back [committed_, upTo) with memory, in whole commit steps
+void Arena::commit(size_t upTo) {
+    if (upTo <= committed_) return;
+    size_t end = std::min(reserved_, roundUp(upTo, kCommitStep));
+    uint8_t* p = base_ + committed_;
+    size_t n = end - committed_;
+
+    bool mapped = false;
+#ifdef MAP_HUGETLB
+    if (pages_ == HugePages::EXPLICIT) {
+        void* r = mmap(p, n, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0);
+        if (r != MAP_FAILED) {
+            mapped = true;
+        } else {
+            // No hugetlb pages reserved: best effort from here on. A failed
+            // MAP_FIXED may already have dropped the reserve, so map it again.
+            pages_ = HugePages::THP;
+            r = mmap(p, n, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+            if (r == MAP_FAILED) throw std::runtime_error(std::string("Arena: commit failed: ") + std::strerror(errno));
+        }
+    }
+#else
+    if (pages_ == HugePages::EXPLICIT) pages_ = HugePages::THP;
+#endif
+    if (!mapped && mprotect(p, n, PROT_READ | PROT_WRITE) != 0) {
+        throw std::runtime_error(std::string("Arena: commit failed: ") + std::strerror(errno));
+    }
+#ifdef MADV_HUGEPAGE
+    if (!mapped && pages_ == HugePages::THP) madvise(p, n, MADV_HUGEPAGE);
+#else
+    if (pages_ == HugePages::THP) pages_ = HugePages::OFF;
+#endif
+
+    // First touch now, on the thread doing setup, instead of in frame 0
+    if (opts_.prefault) {
+        for (size_t off = 0; off < n; off += kPageBytes) p[off] = 0;
+    }
+    committed_ = end;
+}
+
+void* Arena::alloc(size_t bytes) {
+    size_t start = roundUp(used_, kAlign);
+    size_t end = start + roundUp(std::max<size_t>(bytes, 1), kAlign);
+    if (end > reserved_) throw std::runtime_error("Arena: reserved address space exhausted");
+    commit(end);
+    used_ = end;
+    return base_ + start;
+}
+
+bool Arena::extend(void* p, size_t oldBytes, size_t newBytes) {
+    uint8_t* q = static_cast<uint8_t*>(p);
+    if (q + roundUp(std::max<size_t>(oldBytes, 1), kAlign) != base_ + used_) return false; // not the last slice
+    size_t end = (size_t)(q - base_) + roundUp(std::max<size_t>(newBytes, 1), kAlign);
+    if (end > reserved_) return false;
+    commit(end);
+    used_ = std::max(used_, end);
+    return true;
+}
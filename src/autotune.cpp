@@ -0,0 +1,496 @@
+#include "autotune.hpp"
+#include "frame_ops.hpp"
+#include "raw_io.hpp"
+#include "utils.hpp"
+
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+const char* kProfileHeader = "# image_pipeline autotune profile v1";
+
+// Timed runs per candidate: kMinReps, more while under kMinCandidateMs
+// (small frames), never more than kMaxReps. Median of those.
+const int kWarmup = 2;
+const int kMinReps = 5;
+const int kMaxReps = 50;
+const double kMinCandidateMs = 150.0;
+
+// --tiled images can be far bigger than memory: tune on a strip this tall
+const int kTiledTuneRows = 4096;
+
+int hwThreads() {
+    return (int)std::max(1u, std::thread::hardware_concurrency());
+}
+
+std::string hostName() {
+    char buf[256] = {};
+    if (gethostname(buf, sizeof(buf) - 1) != 0 || !buf[0]) return "localhost";
+    return buf;
+}
+
+std::string machineLine() {
+    return "machine " + hostName() + " threads=" + std::to_string(hwThreads()) + " isa=" + cpuIsaName(detectCpuIsa());
+}
+
+Mode parseProfileMode(const std::string& s) {
+    if (s == "cpu-single") return Mode::CPU_SINGLE;
+    if (s == "cpu-mt")     return Mode::CPU_MT;
+    throw std::runtime_error("bad mode " + s);
+}
+
+// Gradients + noise with a fixed seed, like pipeline_bench's frames
+cv::Mat syntheticFrame(int w, int h, PixelFormat input) {
+    cv::Mat bgr(h, w, CV_8UC3);
+    std::mt19937 rng(12345);
+    for (int y = 0; y < h; y++) {
+        uint8_t* row = bgr.ptr<uint8_t>(y);
+        for (int x = 0; x < w; x++) {
+            int n = (int)(rng() & 63);
+            row[3 * x + 0] = (uint8_t)((x * 255 / std::max(1, w - 1) + n) & 255);
+            row[3 * x + 1] = (uint8_t)((y * 255 / std::max(1, h - 1) + n) & 255);
+            row[3 * x + 2] = (uint8_t)(((x ^ y) + n) & 255);
+        }
+    }
+    if (input == PixelFormat::BGR8) return bgr;
+    cv::Mat gray;
+    cv::cvtColor(bgr, gray, cv::COLOR_BGR2GRAY);
+    return gray;
+}
+
+std::string describe(const TuneResult& c, bool tiled) {
+    std::string s = "threads=" + std::to_string(c.threads) +
+                    " grain=" + (c.grain > 0 ? std::to_string(c.grain) : std::string("auto")) +
+                    " isa=" + cpuIsaName(c.isa) + " fused=" + (c.fused ? "1" : "0");
+    if (tiled) s += " tile_rows=" + (c.tileRows > 0 ? std::to_string(c.tileRows) : std::string("auto"));
+    return s;
+}
+
+// The run's arguments with candidate c in place of every tuned knob
+Args withCandidate(const Args& args, const TuneResult& c) {
+    Args a = args;
+    a.threads = c.threads;
+    a.fused = c.fused;
+    a.tileRows = c.tileRows;
+    return a;
+}
+
+// Median ms of one frame (--tiled: one strip, band by band) with candidate c
+double timeCandidate(const Args& args, const TuneResult& c, const cv::Mat& frame, PixelFormat input) {
+    Args a = withCandidate(args, c);
+    setCpuIsaLimit(c.isa);
+
+    CpuWorkspace ws;
+    if (a.mode == Mode::CPU_MT) {
+        ThreadPool& pool = ws.ensureThreads(a.threads);
+        if (!args.userGrain) pool.setGrain(c.grain);
+    }
+    int w = frame.cols, h = frame.rows;
+    FrameBuffers buf;
+    std::function<void()> once;
+    StageTimes t;
+    if (a.tiled) {
+        buf.graph = buildGraph(a, input);
+        int halo = buf.graph.totalHalo();
+        int bandRows = tiledBandRows(a, w, h);
+        once = [&, halo, bandRows]() {
+            for (int y0 = 0; y0 < h; y0 += bandRows) {
+                int y1 = std::min(h, y0 + bandRows);
+                cv::Mat band = frame(cv::Rect(0, std::max(0, y0 - halo), w,
+                                              std::min(h, y1 + halo) - std::max(0, y0 - halo)));
+                processFrame(band, buf, ws, a, t);
+            }
+        };
+    } else {
+        buf.setup(a, w, h, ws, input);
+        once = [&]() { processFrame(frame, buf, ws, a, t); };
+    }
+
+    for (int i = 0; i < kWarmup; i++) once();
+    std::vector<double> ms;
+    double spent = 0.0;
+    while ((int)ms.size() < kMinReps || (spent < kMinCandidateMs && (int)ms.size() < kMaxReps)) {
+        Timer timer;
+        once();
+        ms.push_back(timer.ms());
+        spent += ms.back();
+    }
+    std::nth_element(ms.begin(), ms.begin() + ms.size() / 2, ms.end());
+    return ms[ms.size() / 2];
+}
+
+// Does --fused change this chain? (only gray,blur,sobel runs fuse)
+bool fusable(const Args& args, PixelFormat input) {
+    Args a = args;
+    a.fused = false;
+    int staged = buildGraph(a, input).size();
+    a.fused = true;
+    return buildGraph(a, input).size() != staged;
+}
+
+// Size and pixel format of the run's frames without running it.
+// False if it can't be known up front (stdin without --raw-size, unreadable input).
+bool probeFrameSize(const Args& args, int& w, int& h, PixelFormat& input, cv::Mat& image) {
+    RawFormat raw;
+    if (!args.imagePath.empty() && args.tiled) {
+        if (resolveRawFormat(args.inFormat, args.imagePath, raw)) {
+            w = args.rawWidth;
+            h = args.rawHeight;
+            input = PixelFormat::GRAY8;
+            return w > 0 && h > 0;
+        }
+        MappedFile in;
+        in.open(args.imagePath);
+        PnmHeader hdr = parsePnmHeader(in.data(), in.size());
+        w = hdr.w;
+        h = hdr.h;
+        input = hdr.channels == 3 ? PixelFormat::BGR8 : PixelFormat::GRAY8;
+        return true;
+    }
+    if (!args.imagePath.empty()) {
+        image = cv::imread(args.imagePath, cv::IMREAD_COLOR);
+        if (image.empty()) return false;
+        w = image.cols;
+        h = image.rows;
+        input = PixelFormat::BGR8;
+        return true;
+    }
+    if (args.videoPath.empty()) return false;
+    if (resolveRawFormat(args.inFormat, args.videoPath, raw)) {
+        input = PixelFormat::GRAY8;
+        if (raw == RawFormat::GRAY || args.videoPath == "-") { // a pipe can't be read twice
+            w = args.rawWidth;
+            h = args.rawHeight;
+            return raw == RawFormat::GRAY && w > 0 && h > 0;
+        }
+        RawFrameReader r;
+        r.open(args.videoPath, raw);
+        w = r.width();
+        h = r.height();
+        return true;
+    }
+    cv::VideoCapture cap(args.videoPath);
+    if (!cap.isOpened()) return false;
+    w = (int)cap.get(cv::CAP_PROP_FRAME_WIDTH);
+    h = (int)cap.get(cv::CAP_PROP_FRAME_HEIGHT);
+    input = PixelFormat::BGR8;
+    return w > 0 && h > 0;
+}
+
+std::string profilePathFor(const Args& args) {
+    return args.profilePath.empty() ? TuneProfile::defaultPath() : args.profilePath;
+}
+
+void printForeign(const TuneProfile& p, const std::string& path) {
+    if (p.foreign()) {
+        std::cout << "[PROFILE] " << path << " was tuned on another machine; ignored (run --autotune)\n";
+    }
+}
+
+} // namespace
+
+std::string TuneProfile::defaultPath() {
+    std::string base;
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) base = xdg;
+    else if (const char* home = std::getenv("HOME"); home && *home) base = std::string(home) + "/.cache";
+    else return "";
+    return base + "/image_pipeline/" + hostName() + ".profile";
+}
+
+void TuneProfile::load(const std::string& path, bool strict) {
+    entries_.clear();
+    foreign_ = false;
+    std::ifstream f(path);
+    if (!f) return;
+
+    std::string line;
+    int lineNo = 0;
+    bool ours = false;
+    while (std::getline(f, line)) {
+        lineNo++;
+        if (line.empty() || line[0] == '#') continue;
+        if (line.compare(0, 8, "machine ") == 0) {
+            ours = line == machineLine();
+            foreign_ = !ours;
+            continue;
+        }
+        try {
+            std::istringstream ss(line);
+            std::string size, mode, kv;
+            ProfileEntry e;
+            if (!(ss >> size >> mode >> e.chain) || std::sscanf(size.c_str(), "%dx%d", &e.w, &e.h) != 2) {
+                throw std::runtime_error("expected <w>x<h> <mode> <chain> key=value...");
+            }
+            e.mode = parseProfileMode(mode);
+            while (ss >> kv) {
+                size_t eq = kv.find('=');
+                if (eq == std::string::npos) throw std::runtime_error("expected key=value, got " + kv);
+                std::string k = kv.substr(0, eq), v = kv.substr(eq + 1);
+                if (k == "threads")        e.result.threads = std::stoi(v);
+                else if (k == "grain")     e.result.grain = std::stoi(v);
+                else if (k == "isa")       e.result.isa = parseCpuIsa(v);
+                else if (k == "fused")     e.result.fused = v == "1";
+                else if (k == "tile_rows") e.result.tileRows = std::stoi(v);
+                else if (k == "ms")        e.result.ms = std::stod(v);
+                // unknown keys: written by a newer build, skipped
+            }
+            if (e.w < 1 || e.h < 1 || e.result.threads < 1 || e.result.grain < 0 || e.result.tileRows < 0) {
+                throw std::runtime_error("value out of range");
+            }
+            if (ours) put(e);
+        } catch (const std::exception& ex) {
+            std::string where = path + ":" + std::to_string(lineNo) + ": " + ex.what();
+            if (strict) throw std::runtime_error("Profile " + where);
+            std::cerr << "[PROFILE] " << where << " (line skipped)\n";
+        }
+    }
+}
+
+void TuneProfile::save(const std::string& path) const {
+    std::filesystem::path p(path);
+    if (p.has_parent_path()) std::filesystem::create_directories(p.parent_path());
+
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::trunc);
+        if (!f) throw std::runtime_error("Failed to write profile: " + tmp);
+        f << kProfileHeader << "\n" << machineLine() << "\n";
+        for (const ProfileEntry& e : entries_) {
+            const TuneResult& r = e.result;
+            f << e.w << "x" << e.h << " " << modeName(e.mode) << " " << e.chain << " threads=" << r.threads
+              << " grain=" << r.grain << " isa=" << cpuIsaName(r.isa) << " fused=" << (r.fused ? 1 : 0)
+              << " tile_rows=" << r.tileRows << " ms=" << r.ms << "\n";
+        }
+        if (!f.flush()) throw std::runtime_error("Failed to write profile: " + tmp);
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) throw std::runtime_error("Failed to replace profile: " + path);
+}
+
+const ProfileEntry* TuneProfile::find(int w, int h, Mode mode, const std::string& chain) const {
+    const ProfileEntry* best = nullptr;
+    double bestDist = std::log(2.0) + 1e-9; // within 2x the pixels
+    double px = (double)w * h;
+    for (const ProfileEntry& e : entries_) {
+        if (e.mode != mode || e.chain != chain) continue;
+        if (e.w == w && e.h == h) return &e;
+        double d = std::fabs(std::log((double)e.w * e.h / px));
+        if (d < bestDist) {
+            bestDist = d;
+            best = &e;
+        }
+    }
+    return best;
+}
+
+void TuneProfile::put(const ProfileEntry& e) {
+    for (ProfileEntry& old : entries_) {
+        if (old.w == e.w && old.h == e.h && old.mode == e.mode && old.chain == e.chain) {
+            old = e;
+            return;
+        }
+    }
+    entries_.push_back(e);
+}
+
+std::string chainKey(const Args& args, PixelFormat input) {
+    Args a = args;
+    a.fused = false;
+    FilterGraph g = buildGraph(a, input);
+    std::string key;
+    for (int i = 0; i < g.size(); i++) {
+        if (i) key += ",";
+        key += g.stage(i).label();
+    }
+    return key;
+}
+
+TuneResult autotune(const Args& args, int w, int h, PixelFormat input) {
+    if (args.mode == Mode::GPU) throw std::runtime_error("--autotune: GPU mode not available");
+    if (args.tiled && !buildGraph(args, input).local()) {
+        throw std::runtime_error("Tiled: the filter chain must be local (no canny)");
+    }
+    bool mt = args.mode == Mode::CPU_MT;
+    int tuneH = args.tiled ? std::min(h, kTiledTuneRows) : h;
+    cv::Mat frame = syntheticFrame(w, tuneH, input);
+    CpuIsa isaBefore = activeCpuIsa();
+
+    std::cout << "[AUTOTUNE] size=" << w << "x" << h << " mode=" << modeName(args.mode)
+              << " chain=" << chainKey(args, input) << " (" << hwThreads() << " hw threads, best isa "
+              << cpuIsaName(detectCpuIsa()) << ")";
+    if (args.tiled) std::cout << ", timed on a " << w << "x" << tuneH << " strip";
+    std::cout << "\n";
+
+    // Start from the run as the command line asked for it
+    TuneResult cur;
+    cur.threads = mt ? args.threads : 1;
+    cur.isa = isaBefore;
+    cur.fused = args.fused;
+    cur.tileRows = args.tileRows;
+    auto measure = [&](const TuneResult& c) {
+        double ms = timeCandidate(args, c, frame, input);
+        std::cout << "  " << describe(c, args.tiled) << ": " << ms << " ms\n";
+        return ms;
+    };
+    cur.ms = measure(cur);
+    double asGiven = cur.ms;
+
+    // One knob at a time, each at the best of the ones before it
+    auto tryValues = [&](const std::vector<TuneResult>& cands) {
+        for (const TuneResult& c : cands) {
+            double ms = measure(c);
+            if (ms < cur.ms) {
+                cur = c;
+                cur.ms = ms;
+            }
+        }
+    };
+
+    if (!args.userIsa) {
+        std::vector<TuneResult> c;
+        for (int i = 0; i <= (int)detectCpuIsa(); i++) {
+            if ((CpuIsa)i == cur.isa) continue;
+            c.push_back(cur);
+            c.back().isa = (CpuIsa)i;
+        }
+        tryValues(c);
+    }
+    if (!args.userFused && fusable(args, input)) {
+        TuneResult c = cur;
+        c.fused = !c.fused;
+        tryValues({c});
+    }
+    if (mt && !args.userThreads) {
+        std::vector<int> counts;
+        for (int t = 1; t < hwThreads(); t *= 2) counts.push_back(t);
+        counts.push_back(hwThreads());
+        std::vector<TuneResult> c;
+        for (int t : counts) {
+            if (t == cur.threads) continue;
+            c.push_back(cur);
+            c.back().threads = t;
+        }
+        tryValues(c);
+    }
+    if (mt && !args.userGrain && cur.threads > 1) {
+        std::vector<TuneResult> c;
+        for (int g : {0, 4, 16, 64}) {
+            if (g == cur.grain || g * cur.threads > tuneH) continue;
+            c.push_back(cur);
+            c.back().grain = g;
+        }
+        tryValues(c);
+    }
+    if (args.tiled && !args.userTileRows) {
+        std::vector<TuneResult> c;
+        for (int r : {0, 64, 256, 1024, 4096}) {
+            if (r == cur.tileRows || r > tuneH) continue;
+            c.push_back(cur);
+            c.back().tileRows = r;
+        }
+        tryValues(c);
+    }
+
+    setCpuIsaLimit(isaBefore);
+    std::cout << "  best:      " << describe(cur, args.tiled) << ": " << cur.ms << " ms";
+    if (cur.ms > 0) std::cout << " (" << asGiven / cur.ms << "x vs. the command line's settings)";
+    std::cout << "\n";
+    return cur;
+}
+
+void applyTuning(Args& args, const TuneResult& r) {
+    if (!args.userThreads && args.mode == Mode::CPU_MT) args.threads = r.threads;
+    if (!args.userGrain) ThreadPool::setDefaultGrain(r.grain);
+    if (!args.userIsa) setCpuIsaLimit(r.isa);
+    if (!args.userFused) args.fused = r.fused;
+    if (!args.userTileRows && args.tiled) args.tileRows = r.tileRows;
+}
+
+void configureRun(Args& args, cv::Mat& image) {
+    bool batch = !args.inputDir.empty() || !args.listPath.empty();
+    bool region = args.roiW > 0 || args.scale != 1 || args.pyramidLevels != 1;
+    if (batch || region || args.framesInFlight > 1 || args.mode == Mode::GPU) {
+        if (args.autotune) {
+            throw std::runtime_error("--autotune tunes one image or video stream "
+                                     "(not batch, --frames-in-flight, --roi/--scale or gpu)");
+        }
+        return;
+    }
+
+    std::string path = args.noProfile ? std::string() : profilePathFor(args);
+    TuneProfile profile;
+    if (!path.empty()) profile.load(path, !args.profilePath.empty());
+    if (!args.autotune && profile.entries().empty()) {
+        if (!path.empty()) printForeign(profile, path);
+        return; // nothing to look up: don't probe the input
+    }
+
+    int w = 0, h = 0;
+    PixelFormat input = PixelFormat::BGR8;
+    if (!probeFrameSize(args, w, h, input, image)) {
+        if (args.autotune) throw std::runtime_error("--autotune: can't tell the input's frame size up front (pipes need --raw-size)");
+        return;
+    }
+    std::string chain = chainKey(args, input);
+
+    if (args.autotune) {
+        ProfileEntry e;
+        e.w = w;
+        e.h = h;
+        e.mode = args.mode;
+        e.chain = chain;
+        e.result = autotune(args, w, h, input);
+        applyTuning(args, e.result);
+        if (path.empty()) {
+            std::cout << "  profile:   not saved (" << (args.noProfile ? "--no-profile" : "no home directory; use --profile")
+                      << ")\n";
+            return;
+        }
+        profile.put(e);
+        profile.save(path);
+        std::cout << "  profile:   saved to " << path << "\n";
+        return;
+    }
+
+    const ProfileEntry* e = profile.find(w, h, args.mode, chain);
+    if (!e) return;
+    applyTuning(args, e->result);
+    std::cout << "[PROFILE] " << path << ": " << describe(e->result, args.tiled) << " (tuned for " << e->w << "x"
+              << e->h << ", " << e->result.ms << " ms; flags on the command line win)\n";
+}
+
+void tuneOffline(const Args& args) {
+    if (args.tuneSizes.empty()) throw std::runtime_error("--autotune without an input needs --tune-sizes WxH[,WxH...]");
+    PixelFormat input = args.inFormat.empty() ? PixelFormat::BGR8 : PixelFormat::GRAY8;
+
+    std::string path = args.noProfile ? std::string() : profilePathFor(args);
+    TuneProfile profile;
+    if (!path.empty()) profile.load(path, !args.profilePath.empty());
+
+    for (const auto& s : args.tuneSizes) {
+        ProfileEntry e;
+        e.w = s.first;
+        e.h = s.second;
+        e.mode = args.mode;
+        e.chain = chainKey(args, input);
+        e.result = autotune(args, e.w, e.h, input);
+        profile.put(e);
+    }
+    if (path.empty()) {
+        std::cout << "  profile:   not saved (" << (args.noProfile ? "--no-profile" : "no home directory; use --profile")
+                  << ")\n";
+        return;
+    }
+    profile.save(path);
+    std::cout << "  profile:   " << args.tuneSizes.size() << " size(s) saved to " << path << "\n";
+}
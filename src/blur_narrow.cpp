@@ -0,0 +1,126 @@
+#include "blur_narrow.hpp"
+
+#include <algorithm>
+
+BlurDivisor blur_divisor(int area) {
+    // With mul = ceil(2^k / area), mul * area = 2^k + e (0 <= e < area), and
+    // (s * mul) >> k == floor(s / area) as long as s * e < 2^k.
+    // s <= 255 * area, so 2^k > 255 * area^2 is enough. mul (<= 510 * area)
+    // then fits in 32 bits for any area below 2^23.
+    uint64_t limit = 255ull * (uint64_t)area * (uint64_t)area;
+    int k = 0;
+    while (k < 63 && (1ull << k) <= limit) k++;
+    BlurDivisor d;
+    d.shift = k;
+    d.mul = (uint32_t)(((1ull << k) + (uint64_t)area - 1) / (uint64_t)area);
+    return d;
+}
+
+// ---------- r = 1, 2, 3: window size known at compile time ----------
+
+template <int R>
+static void hsum_row_fixed(const uint8_t* row, uint16_t* sums, int w) {
+    // Borders: repeat the edge pixel (same as blur_hsum_row)
+    auto clamped = [&](int x) {
+        int s = 0;
+        for (int dx = -R; dx <= R; dx++) s += row[std::clamp(x + dx, 0, w - 1)];
+        return (uint16_t)s;
+    };
+    int lo = std::min(R, w);
+    int hi = std::max(lo, w - R);
+    for (int x = 0; x < lo; x++) sums[x] = clamped(x);
+    // Interior: 2R+1 shifted loads per output, independent per x -> vectorizes
+    for (int x = lo; x < hi; x++) {
+        unsigned s = 0;
+        for (int dx = -R; dx <= R; dx++) s += row[x + dx];
+        sums[x] = (uint16_t)s;
+    }
+    for (int x = hi; x < w; x++) sums[x] = clamped(x);
+}
+
+template <int R>
+static void vpass_fixed(const uint16_t* tmp, int w, int h, cv::Mat& blurred, int y0, int y1) {
+    const int k = 2 * R + 1;
+    // Largest sum is 255 * k^2 (12495 for R = 3): the whole divide fits in 32 bits
+    const BlurDivisor d = blur_divisor(k * k);
+    const uint32_t mul = d.mul;
+    const int shift = d.shift;
+
+    const uint16_t* rows[k];
+    for (int y = y0; y < y1; y++) {
+        for (int i = 0; i < k; i++) rows[i] = tmp + (size_t)std::clamp(y - R + i, 0, h - 1) * w;
+        uint8_t* out = blurred.ptr<uint8_t>(y);
+        for (int x = 0; x < w; x++) {
+            uint32_t s = 0;
+            for (int i = 0; i < k; i++) s += rows[i][x];
+            out[x] = (uint8_t)((s * mul) >> shift);
+        }
+    }
+}
+
+// ---------- 4 <= r <= 128: sliding windows, uint16 tmp ----------
+
+static void hsum_row_sliding(const uint8_t* row, uint16_t* sums, int w, int radius) {
+    int sum = 0;
+    for (int dx = -radius; dx <= radius; dx++) sum += row[std::clamp(dx, 0, w - 1)];
+    sums[0] = (uint16_t)sum;
+    for (int x = 1; x < w; x++) {
+        sum -= row[std::clamp(x - 1 - radius, 0, w - 1)];
+        sum += row[std::clamp(x + radius, 0, w - 1)];
+        sums[x] = (uint16_t)sum;
+    }
+}
+
+static void vpass_sliding(const uint16_t* tmp, int w, int h, cv::Mat& blurred, int radius,
+                          int y0, int y1, int* colSum) {
+    int k = 2 * radius + 1;
+    const BlurDivisor d = blur_divisor(k * k);
+    const uint64_t mul = d.mul;
+    const int shift = d.shift;
+
+    auto tmpRow = [&](int yy) { return tmp + (size_t)std::clamp(yy, 0, h - 1) * w; };
+    auto emit = [&](int y) {
+        uint8_t* out = blurred.ptr<uint8_t>(y);
+        for (int x = 0; x < w; x++) out[x] = (uint8_t)(((uint64_t)(uint32_t)colSum[x] * mul) >> shift);
+    };
+
+    std::fill(colSum, colSum + w, 0);
+    for (int yy = y0 - radius; yy <= y0 + radius; yy++) {
+        const uint16_t* r = tmpRow(yy);
+        for (int x = 0; x < w; x++) colSum[x] += r[x];
+    }
+    emit(y0);
+    for (int y = y0 + 1; y < y1; y++) {
+        const uint16_t* in = tmpRow(y + radius);
+        const uint16_t* out = tmpRow(y - 1 - radius);
+        for (int x = 0; x < w; x++) colSum[x] += (int)in[x] - (int)out[x];
+        emit(y);
+    }
+}
+
+// ---------- dispatch on the radius ----------
+
+void blur_hpass_u16(const cv::Mat& gray, uint16_t* tmp, int radius, int y0, int y1) {
+    int w = gray.cols;
+    for (int y = y0; y < y1; y++) {
+        const uint8_t* row = gray.ptr<uint8_t>(y);
+        uint16_t* dst = tmp + (size_t)y * w;
+        switch (radius) {
+            case 1:  hsum_row_fixed<1>(row, dst, w); break;
+            case 2:  hsum_row_fixed<2>(row, dst, w); break;
+            case 3:  hsum_row_fixed<3>(row, dst, w); break;
+            default: hsum_row_sliding(row, dst, w, radius); break;
+        }
+    }
+}
+
+void blur_vpass_u16(const uint16_t* tmp, int w, int h, cv::Mat& blurred, int radius,
+                    int y0, int y1, int* colSum) {
+    if (y0 >= y1) return;
+    switch (radius) {
+        case 1:  vpass_fixed<1>(tmp, w, h, blurred, y0, y1); break;
+        case 2:  vpass_fixed<2>(tmp, w, h, blurred, y0, y1); break;
+        case 3:  vpass_fixed<3>(tmp, w, h, blurred, y0, y1); break;
+        default: vpass_sliding(tmp, w, h, blurred, radius, y0, y1, colSum); break;
+    }
+}
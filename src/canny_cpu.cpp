@@ -0,0 +1,196 @@
+#include "filters_cpu.hpp"
+#include "row_kernels.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+/*
+Canny as one stage: Sobel -> non-maximum suppression -> hysteresis
+
+Run as separate filters this would write gx, gy (or magnitude + angle)
+as full frames, then a thinned frame, then flood it. Here:
+
+1) Gradient + NMS, one streaming pass per row band.
+   canny_grad_row computes gx/gy once per pixel and keeps only what NMS
+   needs: the L1 magnitude and the direction quantized to 4 neighbour
+   pairs (in-register, no atan). Rows live in a 3-row ring (ws.canny);
+   row y is thinned (canny_nms_row, branch-free) as soon as row y+1
+   exists. Rows outside the frame count as magnitude 0, as do the zero
+   columns on either side.
+   A pixel survives if it is strictly above the neighbour on one side
+   (left / above) and at least the one on the other, so a plateau of
+   equal values keeps one pixel instead of none. Each survivor is written
+   to the output as a state: kCannyStrong (> hi), kCannyWeak (> lo), else 0.
+
+2) Hysteresis: keep every weak pixel 8-connected to a strong one.
+   a) each band, right after its NMS (still in cache), floods from its
+      strong pixels without leaving its own rows -- bands run in parallel
+   b) seams: a connection that crosses a band boundary is a strong pixel
+      next to a weak one across it. Those are the only seeds left; one
+      thread finds them and floods from them, this time frame-wide.
+      Work is one scan of 2 rows per seam plus the pixels it promotes.
+   c) weak pixels that were never reached are cleared (parallel).
+
+Bands are fixed (not the pool's stolen ranges) so that phase b) knows
+where the seams are. Results don't depend on the band count: the output
+is the same for every thread count.
+*/
+
+namespace {
+
+// Each band recomputes the gradient of 2 rows around it; keep that small
+const int kMinBandRows = 16;
+
+struct Band {
+    int y0, y1;
+};
+
+Band bandRows(int b, int bands, int h) {
+    return {(int)((int64_t)b * h / bands), (int)((int64_t)(b + 1) * h / bands)};
+}
+
+// Promote the weak 8-neighbours of (x, y) within rows [ylo, yhi), queue them
+inline void promoteAround(cv::Mat& state, int x, int y, int ylo, int yhi, std::vector<uint32_t>& stack) {
+    int w = state.cols;
+    int ya = std::max(ylo, y - 1), yb = std::min(yhi - 1, y + 1);
+    int xa = std::max(0, x - 1), xb = std::min(w - 1, x + 1);
+    for (int yy = ya; yy <= yb; yy++) {
+        uint8_t* row = state.ptr<uint8_t>(yy);
+        for (int xx = xa; xx <= xb; xx++) {
+            if (row[xx] == kCannyWeak) {
+                row[xx] = kCannyStrong;
+                stack.push_back((uint32_t)yy * (uint32_t)w + (uint32_t)xx);
+            }
+        }
+    }
+}
+
+// Drain the stack: everything promoted promotes its own neighbours
+void flood(cv::Mat& state, std::vector<uint32_t>& stack, int ylo, int yhi) {
+    uint32_t w = (uint32_t)state.cols;
+    while (!stack.empty()) {
+        uint32_t i = stack.back();
+        stack.pop_back();
+        promoteAround(state, (int)(i % w), (int)(i / w), ylo, yhi, stack);
+    }
+}
+
+// Gradient, NMS and in-band hysteresis for rows [y0, y1)
+void cannyBand(const cv::Mat& gray, cv::Mat& state, int lo, int hi, int y0, int y1,
+               CpuWorkspace::CannyBuffers& cb) {
+    int w = gray.cols;
+    int h = gray.rows;
+    size_t stride = (size_t)w + 2;
+
+    // Row yy (>= -1) lives in ring slot (yy + 1) % 3
+    auto magRow = [&](int yy) -> int16_t* { return cb.mag.data() + (size_t)((yy + 1) % 3) * stride + 1; };
+    auto dirRow = [&](int yy) -> uint8_t* { return cb.dir.data() + (size_t)((yy + 1) % 3) * w; };
+    auto grad = [&](int yy) {
+        int16_t* m = magRow(yy);
+        m[-1] = 0;
+        m[w] = 0;
+        if (yy < 0 || yy >= h) {
+            std::memset(m, 0, (size_t)w * sizeof(int16_t));
+            return;
+        }
+        canny_grad_row(gray.ptr<uint8_t>(std::max(yy - 1, 0)), gray.ptr<uint8_t>(yy),
+                       gray.ptr<uint8_t>(std::min(yy + 1, h - 1)), m, dirRow(yy), w);
+    };
+
+    grad(y0 - 1);
+    grad(y0);
+    for (int y = y0; y < y1; y++) {
+        grad(y + 1);
+        canny_nms_row(magRow(y - 1), magRow(y), magRow(y + 1), dirRow(y), state.ptr<uint8_t>(y), w, lo, hi);
+    }
+
+    // Flood from the band's strong pixels, inside the band
+    std::vector<uint32_t>& stack = cb.stack;
+    for (int y = y0; y < y1; y++) {
+        const uint8_t* row = state.ptr<uint8_t>(y);
+        int x = 0;
+        // 8 states at a time: only kCannyStrong has the top bit set
+        for (; x + 8 <= w; x += 8) {
+            uint64_t v;
+            std::memcpy(&v, row + x, 8);
+            for (v &= 0x8080808080808080ull; v; v &= v - 1) {
+                promoteAround(state, x + (__builtin_ctzll(v) >> 3), y, y0, y1, stack);
+                flood(state, stack, y0, y1);
+            }
+        }
+        for (; x < w; x++) {
+            if (row[x] != kCannyStrong) continue;
+            promoteAround(state, x, y, y0, y1, stack);
+            flood(state, stack, y0, y1);
+        }
+    }
+}
+
+// Seeds across the seam between row ys-1 (band above) and ys (band below):
+// weak pixels 8-adjacent to a strong pixel on the other side
+void seedSeam(cv::Mat& state, int ys, std::vector<uint32_t>& stack) {
+    int w = state.cols;
+    uint8_t* rows[2] = {state.ptr<uint8_t>(ys - 1), state.ptr<uint8_t>(ys)};
+    for (int side = 0; side < 2; side++) {
+        const uint8_t* from = rows[side];
+        uint8_t* to = rows[1 - side];
+        int yTo = ys - 1 + (1 - side);
+        for (int x = 0; x < w; x++) {
+            if (from[x] != kCannyStrong) continue;
+            for (int xx = std::max(0, x - 1); xx <= std::min(w - 1, x + 1); xx++) {
+                if (to[xx] == kCannyWeak) {
+                    to[xx] = kCannyStrong;
+                    stack.push_back((uint32_t)yTo * (uint32_t)w + (uint32_t)xx);
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+void canny_cpu(const cv::Mat& gray, cv::Mat& edges, int lo, int hi, int threads, CpuWorkspace& ws) {
+    if (gray.empty()) throw std::runtime_error("canny_cpu: input empty");
+    if (gray.type() != CV_8UC1) throw std::runtime_error("canny_cpu: expected CV_8UC1");
+    if (lo < 0 || hi < lo) throw std::runtime_error("canny_cpu: thresholds must satisfy 0 <= lo <= hi");
+    if ((uint64_t)gray.cols * (uint64_t)gray.rows > UINT32_MAX) {
+        throw std::runtime_error("canny_cpu: frame too large (pixel indices are 32-bit)");
+    }
+
+    int w = gray.cols;
+    int h = gray.rows;
+    edges.create(h, w, CV_8UC1);
+
+    ThreadPool* pool = threads > 1 ? &ws.ensureThreads(threads) : nullptr;
+    int workers = pool ? pool->size() : 1;
+    ws.ensureCanny(workers, w);
+
+    // 1) + 2a) per band
+    int bands = pool ? std::max(1, std::min(h / kMinBandRows, workers * ThreadPool::kTasksPerWorker)) : 1;
+    auto runBands = [&](int b0, int b1, int tid) {
+        for (int b = b0; b < b1; b++) {
+            Band r = bandRows(b, bands, h);
+            cannyBand(gray, edges, lo, hi, r.y0, r.y1, ws.canny[tid]);
+        }
+    };
+    if (pool && bands > 1) pool->parallel_for(0, bands, runBands);
+    else runBands(0, bands, 0);
+
+    // 2b) stitch the seams
+    if (bands > 1) {
+        std::vector<uint32_t>& stack = ws.canny[0].stack;
+        for (int b = 1; b < bands; b++) seedSeam(edges, bandRows(b, bands, h).y0, stack);
+        flood(edges, stack, 0, h);
+    }
+
+    // 2c) unreached weak pixels are not edges
+    auto clearWeak = [&](int y0, int y1, int) {
+        for (int y = y0; y < y1; y++) {
+            uint8_t* row = edges.ptr<uint8_t>(y);
+            for (int x = 0; x < w; x++) row[x] = row[x] == kCannyStrong ? kCannyStrong : 0;
+        }
+    };
+    if (pool) pool->parallel_for(0, h, clearWeak);
+    else clearWeak(0, h, 0);
+}
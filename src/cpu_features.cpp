@@ -0,0 +1,48 @@
+#include "cpu_features.hpp"
+#include <atomic>
+#include <stdexcept>
+
+// No limit by default
+static std::atomic<int> g_isaLimit{static_cast<int>(CpuIsa::AVX512)};
+
+CpuIsa detectCpuIsa() {
+    // Function-local static: detection runs once, thread-safe
+    static const CpuIsa detected = [] {
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return CpuIsa::AVX512;
+        if (__builtin_cpu_supports("avx2")) return CpuIsa::AVX2;
+        if (__builtin_cpu_supports("ssse3")) return CpuIsa::SSSE3;
+#endif
+        return CpuIsa::SCALAR;
+    }();
+    return detected;
+}
+
+CpuIsa activeCpuIsa() {
+    int detected = static_cast<int>(detectCpuIsa());
+    int limit = g_isaLimit.load(std::memory_order_relaxed);
+    return static_cast<CpuIsa>(detected < limit ? detected : limit);
+}
+
+void setCpuIsaLimit(CpuIsa limit) {
+    g_isaLimit.store(static_cast<int>(limit), std::memory_order_relaxed);
+}
+
+const char* cpuIsaName(CpuIsa isa) {
+    switch (isa) {
+        case CpuIsa::SCALAR: return "scalar";
+        case CpuIsa::SSSE3:  return "ssse3";
+        case CpuIsa::AVX2:   return "avx2";
+        case CpuIsa::AVX512: return "avx512";
+    }
+    return "unknown";
+}
+
+CpuIsa parseCpuIsa(const std::string& s) {
+    if (s == "scalar") return CpuIsa::SCALAR;
+    if (s == "ssse3")  return CpuIsa::SSSE3;
+    if (s == "avx2")   return CpuIsa::AVX2;
+    if (s == "avx512") return CpuIsa::AVX512;
+    throw std::runtime_error("Unknown ISA: " + s);
+}
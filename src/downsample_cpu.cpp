@@ -0,0 +1,96 @@
+#include "filters_cpu.hpp"
+#include "row_kernels.hpp"
+
+#include <stdexcept>
+#include <string>
+
+/*
+Downsampling for --scale / --pyramid-levels.
+
+One pyramid step is the rounded mean of each 2x2 block (downsample2_row,
+SIMD). Scaling by f = 2^k is k such steps, so --scale 4 gives exactly
+level 2 of a --pyramid-levels run, and a pyramid level can be built
+from the level below it instead of from the source.
+
+grayscale_downsample fuses the first k steps into the grayscale stage:
+for each output row, the f source rows it covers are converted by the
+same grayscale_row as the full-size path into per-worker line buffers
+and halved k times in place there. No full-size gray frame is ever
+written; the gray conversion stays the fast SIMD row kernel.
+
+Sizes round down at every step (w / 2): a partial block at the right or
+bottom edge is dropped, so a crop that starts on a multiple of f
+downsamples to exactly the matching part of the downsampled full frame.
+*/
+
+namespace {
+
+void forRows(int rows, int threads, CpuWorkspace& ws, const ThreadPool::RangeFn& fn) {
+    if (threads > 1) ws.ensureThreads(threads).parallel_for(0, rows, fn);
+    else fn(0, rows, 0);
+}
+
+} // namespace
+
+bool downsample_factor_ok(int factor) {
+    return factor >= 1 && factor <= kMaxDownsampleFactor && (factor & (factor - 1)) == 0;
+}
+
+void grayscale_downsample(const cv::Mat& bgr, cv::Mat& gray, int factor, int threads, CpuWorkspace& ws) {
+    if (bgr.empty()) throw std::runtime_error("grayscale_downsample: input empty");
+    if (bgr.type() != CV_8UC3) throw std::runtime_error("grayscale_downsample: expected CV_8UC3");
+    if (!downsample_factor_ok(factor)) {
+        throw std::runtime_error("grayscale_downsample: factor must be a power of two <= " +
+                                 std::to_string(kMaxDownsampleFactor));
+    }
+
+    int w = bgr.cols;
+    int oh = bgr.rows / factor;
+    int ow = w;
+    for (int f = factor; f > 1; f /= 2) ow /= 2;
+    if (ow < 1 || oh < 1) throw std::runtime_error("grayscale_downsample: image smaller than one block");
+    gray.create(oh, ow, CV_8UC1);
+
+    if (factor == 1) {
+        forRows(oh, threads, ws, [&](int y0, int y1, int) {
+            for (int y = y0; y < y1; y++) grayscale_row(bgr.ptr<uint8_t>(y), gray.ptr<uint8_t>(y), w);
+        });
+        return;
+    }
+
+    ws.ensureDownsample(threads > 1 ? ws.ensureThreads(threads).size() : 1, factor, w);
+
+    forRows(oh, threads, ws, [&](int y0, int y1, int tid) {
+        size_t stride = ws.downStride;
+        uint8_t* rows = &ws.downRows[(size_t)tid * stride * factor];
+        for (int y = y0; y < y1; y++) {
+            for (int k = 0; k < factor; k++) {
+                grayscale_row(bgr.ptr<uint8_t>(y * factor + k), rows + k * stride, w);
+            }
+            // Halve in place: row i <- rows 2i, 2i+1 (out[x] never passes in[2x])
+            int n = factor, cw = w;
+            for (; n > 2; n /= 2, cw /= 2) {
+                for (int i = 0; i < n / 2; i++) {
+                    downsample2_row(rows + 2 * i * stride, rows + (2 * i + 1) * stride, rows + i * stride, cw / 2);
+                }
+            }
+            downsample2_row(rows, rows + stride, gray.ptr<uint8_t>(y), ow);
+        }
+    });
+}
+
+void downsample2_gray(const cv::Mat& gray, cv::Mat& out, int threads, CpuWorkspace& ws) {
+    if (gray.empty()) throw std::runtime_error("downsample2_gray: input empty");
+    if (gray.type() != CV_8UC1) throw std::runtime_error("downsample2_gray: expected CV_8UC1");
+
+    int ow = gray.cols / 2;
+    int oh = gray.rows / 2;
+    if (ow < 1 || oh < 1) throw std::runtime_error("downsample2_gray: image smaller than 2x2");
+    out.create(oh, ow, CV_8UC1);
+
+    forRows(oh, threads, ws, [&](int y0, int y1, int) {
+        for (int y = y0; y < y1; y++) {
+            downsample2_row(gray.ptr<uint8_t>(2 * y), gray.ptr<uint8_t>(2 * y + 1), out.ptr<uint8_t>(y), ow);
+        }
+    });
+}
@@ -0,0 +1,178 @@
+#include "edge_codec.hpp"
+#include "row_kernels.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+// Rows per encode task: small enough to balance, big enough that a
+// band's output buffer amortises its bookkeeping
+const int kBandRows = 16;
+
+uint64_t loadWord(const uint8_t* bits, int word) {
+    uint64_t v;
+    std::memcpy(&v, bits + (size_t)word * 8, 8);
+    return v;
+}
+
+// First x >= from whose bit equals `set`, or w. Bits past w are 0 (the
+// scan row is padded with zeros), so a search for 0 stops there anyway.
+int nextBit(const uint8_t* bits, int from, int w, bool set) {
+    int word = from >> 6;
+    int words = (w + 63) >> 6;
+    uint64_t v = loadWord(bits, word);
+    if (!set) v = ~v;
+    v &= ~0ull << (from & 63);
+    while (true) {
+        if (v) return std::min(w, (word << 6) + __builtin_ctzll(v));
+        if (++word >= words) return w;
+        v = loadWord(bits, word);
+        if (!set) v = ~v;
+    }
+}
+
+void putVarint(std::vector<uint8_t>& out, uint32_t v) {
+    while (v >= 0x80) {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+uint64_t popcountRow(const uint8_t* bits, size_t bytes) {
+    uint64_t n = 0;
+    size_t i = 0;
+    for (; i + 8 <= bytes; i += 8) {
+        uint64_t v;
+        std::memcpy(&v, bits + i, 8);
+        n += (uint64_t)__builtin_popcountll(v);
+    }
+    for (; i < bytes; i++) n += (uint64_t)__builtin_popcount(bits[i]);
+    return n;
+}
+
+void encodeRleRow(const uint8_t* bits, int w, std::vector<uint8_t>& out) {
+    bool edge = false;
+    for (int x = 0; x < w;) {
+        int next = nextBit(bits, x, w, !edge);
+        putVarint(out, (uint32_t)(next - x));
+        x = next;
+        edge = !edge;
+    }
+}
+
+// `edges` = set bits in the row (its records are appended in one resize)
+void encodeSparseRow(const uint8_t* bits, const uint8_t* mag, int w, int y, uint64_t edges,
+                     std::vector<uint8_t>& out) {
+    size_t at = out.size();
+    out.resize(at + 5 * edges);
+    uint8_t* rec = out.data() + at;
+    int words = (w + 63) >> 6;
+    for (int word = 0; word < words; word++) {
+        uint64_t v = loadWord(bits, word);
+        while (v) {
+            int x = (word << 6) + __builtin_ctzll(v);
+            v &= v - 1;
+            rec[0] = (uint8_t)x;
+            rec[1] = (uint8_t)(x >> 8);
+            rec[2] = (uint8_t)y;
+            rec[3] = (uint8_t)(y >> 8);
+            rec[4] = mag[x];
+            rec += 5;
+        }
+    }
+}
+
+} // namespace
+
+const char* edgeFormatName(EdgeFormat f) {
+    switch (f) {
+        case EdgeFormat::BITMAP: return "bitmap";
+        case EdgeFormat::RLE:    return "rle";
+        case EdgeFormat::SPARSE: return "sparse";
+    }
+    return "unknown";
+}
+
+EdgeFormat parseEdgeFormat(const std::string& s) {
+    if (s == "bitmap") return EdgeFormat::BITMAP;
+    if (s == "rle")    return EdgeFormat::RLE;
+    if (s == "sparse") return EdgeFormat::SPARSE;
+    throw std::runtime_error("Unknown edge format: " + s + " (bitmap|rle|sparse)");
+}
+
+void EdgeEncoder::setup(EdgeFormat fmt, int w, int h, int threshold) {
+    if (w < 1 || h < 1) throw std::runtime_error("EdgeEncoder: empty frame");
+    if (threshold < 1 || threshold > 255) throw std::runtime_error("--threshold must be 1..255");
+    if (fmt == EdgeFormat::SPARSE && (w > 65536 || h > 65536)) {
+        throw std::runtime_error("--edge-format sparse: frames up to 65536x65536 (16-bit coordinates)");
+    }
+    fmt_ = fmt;
+    w_ = w;
+    h_ = h;
+    threshold_ = threshold;
+    rowBytes_ = ((size_t)w + 7) / 8;
+    scanStride_ = ((size_t)w + 63) / 64 * 8;
+
+    int bands = (h + kBandRows - 1) / kBandRows;
+    counts_.assign(bands, 0);
+    if (fmt == EdgeFormat::BITMAP) {
+        parts_.assign(1, std::vector<uint8_t>(rowBytes_ * h));
+    } else {
+        parts_.assign(bands, std::vector<uint8_t>());
+    }
+    scanRows_.clear();
+    payloadBytes_ = 0;
+    edgeCount_ = 0;
+}
+
+void EdgeEncoder::encode(const cv::Mat& edges, int threads, CpuWorkspace& ws) {
+    if (edges.type() != CV_8UC1 || edges.cols != w_ || edges.rows != h_) {
+        throw std::runtime_error("EdgeEncoder: expected a " + std::to_string(w_) + "x" + std::to_string(h_) +
+                                 " CV_8UC1 edge map");
+    }
+    ThreadPool* pool = threads > 1 ? &ws.ensureThreads(threads) : nullptr;
+    int workers = pool ? pool->size() : 1;
+    if (fmt_ != EdgeFormat::BITMAP && scanRows_.size() < (size_t)workers * scanStride_) {
+        scanRows_.assign((size_t)workers * scanStride_, 0); // padding stays 0 for nextBit
+    }
+    uint8_t t = (uint8_t)threshold_;
+
+    auto bands = [&](int b0, int b1, int tid) {
+        for (int b = b0; b < b1; b++) {
+            int y0 = b * kBandRows;
+            int y1 = std::min(h_, y0 + kBandRows);
+            uint64_t count = 0;
+            if (fmt_ == EdgeFormat::BITMAP) {
+                for (int y = y0; y < y1; y++) {
+                    uint8_t* bits = parts_[0].data() + (size_t)y * rowBytes_;
+                    threshold_bits_row(edges.ptr<uint8_t>(y), bits, w_, t);
+                    count += popcountRow(bits, rowBytes_);
+                }
+            } else {
+                uint8_t* bits = scanRows_.data() + (size_t)tid * scanStride_;
+                std::vector<uint8_t>& out = parts_[b];
+                out.clear(); // keeps its capacity from earlier frames
+                for (int y = y0; y < y1; y++) {
+                    const uint8_t* mag = edges.ptr<uint8_t>(y);
+                    threshold_bits_row(mag, bits, w_, t);
+                    uint64_t n = popcountRow(bits, rowBytes_);
+                    count += n;
+                    if (fmt_ == EdgeFormat::RLE) encodeRleRow(bits, w_, out);
+                    else encodeSparseRow(bits, mag, w_, y, n, out);
+                }
+            }
+            counts_[b] = count;
+        }
+    };
+    int nBands = (int)counts_.size();
+    if (pool) pool->parallel_for(0, nBands, bands);
+    else bands(0, nBands, 0);
+
+    payloadBytes_ = 0;
+    for (const std::vector<uint8_t>& p : parts_) payloadBytes_ += p.size();
+    edgeCount_ = 0;
+    for (uint64_t c : counts_) edgeCount_ += c;
+}
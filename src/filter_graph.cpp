@@ -0,0 +1,404 @@
+#include "filter_graph.hpp"
+#include "filters_cpu.hpp"
+#include "blur_narrow.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+const char* pixelFormatName(PixelFormat f) {
+    switch (f) {
+        case PixelFormat::BGR8:  return "bgr";
+        case PixelFormat::GRAY8: return "gray";
+        case PixelFormat::PLANAR3: return "planar";
+    }
+    return "unknown";
+}
+
+static int bytesPerPixel(PixelFormat f) {
+    return f == PixelFormat::GRAY8 ? 1 : 3;
+}
+
+static int matType(PixelFormat f) {
+    return f == PixelFormat::BGR8 ? CV_8UC3 : CV_8UC1;
+}
+
+// Planar frames are their planes stacked vertically
+static int matRows(PixelFormat f, int h) {
+    return f == PixelFormat::PLANAR3 ? 3 * h : h;
+}
+
+void createFrame(cv::Mat& m, PixelFormat f, int w, int h) {
+    m.create(matRows(f, h), w, matType(f));
+}
+
+void createFrame(cv::Mat& m, PixelFormat f, int w, int h, CpuWorkspace& ws) {
+    size_t bytes = (size_t)w * h * bytesPerPixel(f);
+    m = cv::Mat(matRows(f, h), w, matType(f), ws.arena().alloc(bytes));
+}
+
+/*
+The stages: thin wrappers that pick the MT (_ws, persistent pool) or
+single-thread variant of each kernel. Same calls processFrame used to
+hard-code, so the default chain produces the same pixels as before.
+*/
+
+namespace {
+
+class GrayStage : public FilterStage {
+public:
+    const char* name() const override { return "gray"; }
+    PixelFormat input() const override { return PixelFormat::BGR8; }
+    PixelFormat output() const override { return PixelFormat::GRAY8; }
+    int halo() const override { return 0; }
+
+    void run(const cv::Mat& in, cv::Mat& out, int threads, CpuWorkspace& ws) override {
+        if (threads > 1) grayscale_cpu_mt_ws(in, out, threads, ws);
+        else grayscale_cpu(in, out, 1);
+    }
+};
+
+// BGR -> planar / planar -> BGR around the colour stages (planar_cpu.cpp)
+class PlanarStage : public FilterStage {
+public:
+    const char* name() const override { return "planar"; }
+    PixelFormat input() const override { return PixelFormat::BGR8; }
+    PixelFormat output() const override { return PixelFormat::PLANAR3; }
+    int halo() const override { return 0; }
+
+    void run(const cv::Mat& in, cv::Mat& out, int threads, CpuWorkspace& ws) override {
+        bgr_to_planar(in, out, threads, ws);
+    }
+};
+
+class InterleaveStage : public FilterStage {
+public:
+    const char* name() const override { return "interleave"; }
+    PixelFormat input() const override { return PixelFormat::PLANAR3; }
+    PixelFormat output() const override { return PixelFormat::BGR8; }
+    int halo() const override { return 0; }
+
+    void run(const cv::Mat& in, cv::Mat& out, int threads, CpuWorkspace& ws) override {
+        planar_to_bgr(in, out, threads, ws);
+    }
+};
+
+// Blur and Sobel run on gray frames, or on every plane of a planar one
+class BlurStage : public FilterStage {
+public:
+    BlurStage(int radius, PixelFormat format) : radius_(radius), format_(format) {}
+
+    const char* name() const override { return "blur"; }
+    std::string label() const override { return "blur:" + std::to_string(radius_); }
+    PixelFormat input() const override { return format_; }
+    PixelFormat output() const override { return format_; }
+    int halo() const override { return radius_; }
+    int radius() const { return radius_; }
+
+    void reserve(int w, int h, int workers, CpuWorkspace& ws) override {
+        // The planar path sums all three stacked planes in one narrow pass
+        bool narrow = radius_ <= kBlurNarrowMaxRadius;
+        bool stacked = format_ == PixelFormat::PLANAR3 && narrow;
+        ws.ensureSize(w, stacked ? 3 * h : h, narrow);
+        ws.ensureColSums(workers);
+    }
+
+    void run(const cv::Mat& in, cv::Mat& out, int threads, CpuWorkspace& ws) override {
+        if (format_ == PixelFormat::PLANAR3) box_blur_planar(in, out, radius_, threads, ws);
+        else if (threads > 1) box_blur_cpu_fast_mt_ws(in, out, radius_, threads, ws);
+        else box_blur_cpu_fast_ws(in, out, radius_, ws);
+    }
+
+private:
+    int radius_;
+    PixelFormat format_;
+};
+
+class SobelStage : public FilterStage {
+public:
+    SobelStage(SobelNorm norm, PixelFormat format) : norm_(norm), format_(format) {}
+
+    const char* name() const override { return "sobel"; }
+    std::string label() const override { return std::string("sobel:") + sobelNormName(norm_); }
+    PixelFormat input() const override { return format_; }
+    PixelFormat output() const override { return format_; }
+    int halo() const override { return 1; }
+    SobelNorm norm() const { return norm_; }
+
+    void run(const cv::Mat& in, cv::Mat& out, int threads, CpuWorkspace& ws) override {
+        if (format_ == PixelFormat::PLANAR3) sobel_planar(in, out, threads, ws, norm_);
+        else if (threads > 1) sobel_cpu_mt_ws(in, out, threads, ws, norm_);
+        else sobel_cpu(in, out, 1, norm_);
+    }
+
+private:
+    SobelNorm norm_;
+    PixelFormat format_;
+};
+
+// Sobel + NMS + hysteresis in one stage (canny_cpu.cpp). Hysteresis
+// follows edges any distance, so the stage is not local.
+class CannyStage : public FilterStage {
+public:
+    CannyStage(int lo, int hi) : lo_(lo), hi_(hi) {}
+
+    const char* name() const override { return "canny"; }
+    std::string label() const override { return "canny:" + std::to_string(lo_) + ":" + std::to_string(hi_); }
+    PixelFormat input() const override { return PixelFormat::GRAY8; }
+    PixelFormat output() const override { return PixelFormat::GRAY8; }
+    int halo() const override { return 2; } // Sobel + NMS; hysteresis is unbounded
+    bool local() const override { return false; }
+
+    void reserve(int w, int, int workers, CpuWorkspace& ws) override {
+        ws.ensureCanny(workers, w);
+    }
+
+    void run(const cv::Mat& in, cv::Mat& out, int threads, CpuWorkspace& ws) override {
+        canny_cpu(in, out, lo_, hi_, threads, ws);
+    }
+
+private:
+    int lo_;
+    int hi_;
+};
+
+// gray -> blur:r -> sobel as one line-buffered pass (fused_cpu.cpp)
+class FusedStage : public FilterStage {
+public:
+    FusedStage(int radius, SobelNorm norm) : radius_(radius), norm_(norm) {}
+
+    const char* name() const override { return "fused"; }
+    std::string label() const override {
+        return "fused(gray,blur:" + std::to_string(radius_) + ",sobel:" + sobelNormName(norm_) + ")";
+    }
+    PixelFormat input() const override { return PixelFormat::BGR8; }
+    PixelFormat output() const override { return PixelFormat::GRAY8; }
+    int halo() const override { return radius_ + 1; }
+
+    void reserve(int w, int, int workers, CpuWorkspace& ws) override {
+        ws.ensureLines(workers, w, radius_);
+    }
+
+    void run(const cv::Mat& in, cv::Mat& out, int threads, CpuWorkspace& ws) override {
+        fused_gray_blur_sobel(in, out, radius_, threads, ws, norm_);
+    }
+
+private:
+    int radius_;
+    SobelNorm norm_;
+};
+
+} // namespace
+
+FilterGraph FilterGraph::parse(const std::string& spec, int defaultRadius, SobelNorm defaultNorm,
+                               PixelFormat input) {
+    FilterGraph g;
+    g.input_ = input;
+    std::stringstream ss(spec);
+    std::string item;
+
+    while (std::getline(ss, item, ',')) {
+        if (item.empty()) continue;
+
+        // "name[:arg]"
+        std::string name = item, arg;
+        size_t colon = item.find(':');
+        if (colon != std::string::npos) {
+            name = item.substr(0, colon);
+            arg = item.substr(colon + 1);
+        }
+
+        // Blur/Sobel take the format of whatever comes before them
+        PixelFormat cur = g.stages_.empty() ? input : g.stages_.back()->output();
+
+        if (name == "gray") {
+            if (!arg.empty()) throw std::runtime_error("Stage 'gray' takes no argument: " + item);
+            // Already gray (raw/PGM input): grayscale of gray is the same image
+            if (cur == PixelFormat::GRAY8) continue;
+            g.stages_.push_back(std::make_unique<GrayStage>());
+        } else if (name == "planar" || name == "interleave") {
+            if (!arg.empty()) throw std::runtime_error("Stage '" + name + "' takes no argument: " + item);
+            if (name == "planar") g.stages_.push_back(std::make_unique<PlanarStage>());
+            else g.stages_.push_back(std::make_unique<InterleaveStage>());
+        } else if (name == "blur") {
+            int r = defaultRadius;
+            if (!arg.empty()) {
+                try {
+                    r = std::stoi(arg);
+                } catch (const std::exception&) {
+                    throw std::runtime_error("Bad blur radius: " + item);
+                }
+            }
+            if (r < 1) throw std::runtime_error("Blur radius must be >= 1: " + item);
+            g.stages_.push_back(std::make_unique<BlurStage>(r, cur == PixelFormat::PLANAR3 ? cur : PixelFormat::GRAY8));
+        } else if (name == "sobel") {
+            SobelNorm n = arg.empty() ? defaultNorm : parseSobelNorm(arg);
+            g.stages_.push_back(std::make_unique<SobelStage>(n, cur == PixelFormat::PLANAR3 ? cur : PixelFormat::GRAY8));
+        } else if (name == "canny") {
+            // "canny" or "canny:lo:hi" (thresholds on |gx| + |gy|, 0..2040)
+            int lo = kCannyDefaultLow, hi = kCannyDefaultHigh;
+            if (!arg.empty()) {
+                size_t sep = arg.find(':');
+                try {
+                    if (sep == std::string::npos) throw std::invalid_argument(arg);
+                    size_t n1 = 0, n2 = 0;
+                    lo = std::stoi(arg.substr(0, sep), &n1);
+                    hi = std::stoi(arg.substr(sep + 1), &n2);
+                    if (n1 != sep || n2 != arg.size() - sep - 1) throw std::invalid_argument(arg);
+                } catch (const std::exception&) {
+                    throw std::runtime_error("Bad canny thresholds (canny:lo:hi): " + item);
+                }
+            }
+            if (lo < 0 || hi < lo) throw std::runtime_error("Canny thresholds must satisfy 0 <= lo <= hi: " + item);
+            g.stages_.push_back(std::make_unique<CannyStage>(lo, hi));
+        } else {
+            throw std::runtime_error("Unknown stage: " + item +
+                                     " (expected gray, planar, interleave, blur[:r], sobel[:l1|l2|sq], canny[:lo:hi])");
+        }
+    }
+
+    // Planar is only an in-between format: re-interleave once, at the end
+    if (!g.stages_.empty() && g.stages_.back()->output() == PixelFormat::PLANAR3) {
+        g.stages_.push_back(std::make_unique<InterleaveStage>());
+    }
+
+    g.validate();
+    return g;
+}
+
+void FilterGraph::validate() const {
+    if (stages_.empty()) throw std::runtime_error("Filter graph has no stages");
+    if ((int)stages_.size() > kMaxStages) {
+        throw std::runtime_error("Filter graph has more than " + std::to_string(kMaxStages) + " stages");
+    }
+
+    // Frames come in as input_; each stage must accept what the previous one made
+    PixelFormat cur = input_;
+    for (const auto& st : stages_) {
+        if (st->input() != cur) {
+            throw std::runtime_error("Stage '" + st->label() + "' expects " + pixelFormatName(st->input()) +
+                                     " input but gets " + pixelFormatName(cur));
+        }
+        cur = st->output();
+    }
+    // Outputs are written as edge maps (gray -> BGR for video) or colour frames
+    if (cur == PixelFormat::PLANAR3) throw std::runtime_error("Filter graph must end with a gray or bgr image");
+}
+
+void FilterGraph::fuse() {
+    std::vector<std::unique_ptr<FilterStage>> out;
+    for (size_t i = 0; i < stages_.size(); i++) {
+        if (i + 2 < stages_.size()) {
+            auto* g = dynamic_cast<GrayStage*>(stages_[i].get());
+            auto* b = dynamic_cast<BlurStage*>(stages_[i + 1].get());
+            auto* s = dynamic_cast<SobelStage*>(stages_[i + 2].get());
+            if (g && b && s) {
+                out.push_back(std::make_unique<FusedStage>(b->radius(), s->norm()));
+                i += 2;
+                continue;
+            }
+        }
+        out.push_back(std::move(stages_[i]));
+    }
+    stages_ = std::move(out);
+    planW_ = planH_ = 0; // stage list changed -> replan
+}
+
+void FilterGraph::plan(int w, int h, CpuWorkspace& ws) {
+    if (w == planW_ && h == planH_ && plannedWs_ == &ws) return;
+
+    int n = (int)stages_.size();
+    planeOf_.assign(std::max(0, n - 1), -1);
+    planeBytes_.clear();
+
+    // Intermediate i is written by stage i and read by stage i+1: live [i, i+1].
+    // A plane is free for intermediate i if its last occupant was read
+    // before stage i starts (last use < i). Greedy, first fit by size.
+    std::vector<int> planeLastUse;
+    for (int i = 0; i + 1 < n; i++) {
+        size_t need = (size_t)w * h * bytesPerPixel(stages_[i]->output());
+        int best = -1;
+        for (int p = 0; p < (int)planeBytes_.size(); p++) {
+            if (planeLastUse[p] >= i) continue; // still being read
+            // Prefer a plane that is already big enough, else the biggest
+            if (best < 0 ||
+                (planeBytes_[p] >= need && planeBytes_[best] < need) ||
+                (planeBytes_[p] < need && planeBytes_[best] < need && planeBytes_[p] > planeBytes_[best])) {
+                best = p;
+            }
+        }
+        if (best < 0) {
+            best = (int)planeBytes_.size();
+            planeBytes_.push_back(0);
+            planeLastUse.push_back(-1);
+        }
+        planeBytes_[best] = std::max(planeBytes_[best], need);
+        planeLastUse[best] = i + 1;
+        planeOf_[i] = best;
+    }
+
+    // Allocate once, then point a Mat header at each intermediate's plane
+    ws.ensurePlanes(planeBytes_);
+    views_.assign(planeOf_.size(), cv::Mat());
+    for (size_t i = 0; i < planeOf_.size(); i++) {
+        PixelFormat f = stages_[i]->output();
+        views_[i] = cv::Mat(matRows(f, h), w, matType(f), ws.planes[planeOf_[i]].data());
+    }
+
+    // Stage scratch too, for as many workers as the pool has: the first
+    // frame then finds every buffer carved (and prefaulted)
+    int workers = ws.workers ? ws.workers->size() : 1;
+    for (auto& s : stages_) s->reserve(w, h, workers, ws);
+
+    planW_ = w;
+    planH_ = h;
+    plannedWs_ = &ws;
+}
+
+void FilterGraph::run(const cv::Mat& input, cv::Mat& out, int threads, CpuWorkspace& ws, double* stageMs) {
+    if (input.empty()) throw std::runtime_error("FilterGraph::run: input empty");
+    if (input.type() != matType(input_)) {
+        throw std::runtime_error("FilterGraph::run: expected " + std::string(pixelFormatName(input_)) + " input");
+    }
+    plan(input.cols, input.rows, ws);
+
+    int n = (int)stages_.size();
+    const cv::Mat* in = &input;
+    for (int i = 0; i < n; i++) {
+        cv::Mat& dst = (i + 1 < n) ? views_[i] : out;
+        TraceSpan span(stages_[i]->name(), "stage");
+        stages_[i]->run(*in, dst, threads, ws);
+        double ms = span.end();
+        if (stageMs) stageMs[i] = ms;
+        in = &dst;
+    }
+}
+
+int FilterGraph::totalHalo() const {
+    int h = 0;
+    for (const auto& st : stages_) h += st->halo();
+    return h;
+}
+
+bool FilterGraph::local() const {
+    for (const auto& st : stages_) {
+        if (!st->local()) return false;
+    }
+    return true;
+}
+
+std::string FilterGraph::describe() const {
+    std::string s;
+    for (size_t i = 0; i < stages_.size(); i++) {
+        if (i) s += " -> ";
+        s += stages_[i]->label();
+    }
+    return s;
+}
+
+size_t FilterGraph::plannedBytes() const {
+    size_t total = 0;
+    for (size_t b : planeBytes_) total += b;
+    return total;
+}
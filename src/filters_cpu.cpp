@@ -1,10 +1,10 @@
 #include "filters_cpu.hpp"
+#include "row_kernels.hpp"
+#include "blur_narrow.hpp"
 #include <cstdint>
 #include <opencv2/core/hal/interface.h>
 #include <stdexcept>
 #include <algorithm> //for std::clamp
-#include <cmath>
-#include <thread>
 #include <vector>
 /*
 Breakdown -
@@ -17,13 +17,64 @@ why grayscale input?
 // Forward declarations for multi-threaded versions
 void grayscale_cpu_mt(const cv::Mat& bgr, cv::Mat& gray, int threads);
 void box_blur_cpu_fast_mt(const cv::Mat& gray, cv::Mat& blurred, int radius, int threads);
-void sobel_cpu_mt(const cv::Mat& gray, cv::Mat& edges, int threads);
+void sobel_cpu_mt(const cv::Mat& gray, cv::Mat& edges, int threads, SobelNorm norm);
+static void blur_horizontal_rows_worker(const cv::Mat& gray, int* tmp, int radius, int y0, int y1);
+static void blur_vertical_rows_worker(const int* tmp, cv::Mat& blurred,
+                                      int w, int h, int radius, int y0, int y1, int* colSum);
 
-// Helper: clamp an integer into [0, 255]
-static inline uint8_t clamp_u8(int v){
-    if (v < 0) return 0;
-    if (v > 255) return 255;
-    return static_cast<uint8_t>(v);
+/*
+Row helpers (see row_kernels.hpp)
+- the full-frame filters below loop over rows and call these
+- the fused path (fused_cpu.cpp) calls the SAME functions on line buffers
+  so both paths produce identical pixels
+- grayscale_row lives in simd_gray.cpp, sobel_row in simd_sobel.cpp
+  (SIMD + runtime dispatch)
+*/
+
+void blur_hsum_row(const uint8_t* row, int* sums, int w, int radius) {
+    // Compute initial window sum for x=0
+    // Window covers [x-radius, x+radius], but we clamp to [0, w-1]
+    int sum = 0;
+    for (int dx = -radius; dx <= radius; dx++) {
+        int xx = std::clamp(dx, 0, w - 1); // since x=0, x+dx = dx
+        sum += row[xx];
+    }
+    sums[0] = sum;
+
+    // Slide window across the row
+    for (int x = 1; x < w; x++) {
+        // Pixel leaving window: x-1-radius
+        int x_out = std::clamp(x - 1 - radius, 0, w - 1);
+        // Pixel entering window: x+radius
+        int x_in  = std::clamp(x + radius, 0, w - 1);
+
+        sum -= row[x_out];
+        sum += row[x_in];
+
+        sums[x] = sum;
+    }
+}
+
+void blur_vsum_add_row(int* colSum, const int* sums, int w) {
+    for (int x = 0; x < w; x++) colSum[x] += sums[x];
+}
+
+void blur_vsum_slide_row(int* colSum, const int* in, const int* out, int w) {
+    for (int x = 0; x < w; x++) colSum[x] += in[x] - out[x];
+}
+
+void blur_divide_row(const int* colSum, uint8_t* outRow, int w, int area) {
+    // colSum / area as multiply + shift (exact for sums up to 255 * area);
+    // beyond r ~ 1450 the multiplier no longer fits 32 bits: plain division
+    if (area >= (1 << 23)) {
+        for (int x = 0; x < w; x++) outRow[x] = static_cast<uint8_t>(std::clamp(colSum[x] / area, 0, 255));
+        return;
+    }
+    const BlurDivisor d = blur_divisor(area);
+    const uint64_t mul = d.mul;
+    for (int x = 0; x < w; x++) {
+        outRow[x] = static_cast<uint8_t>(((uint64_t)(uint32_t)colSum[x] * mul) >> d.shift);
+    }
 }
 
 void grayscale_cpu(const cv::Mat& bgr, cv::Mat& gray, int threads) {
@@ -43,7 +94,7 @@ void grayscale_cpu(const cv::Mat& bgr, cv::Mat& gray, int threads) {
     // 2) Allocate output memory (same width/height), but 1 channel)
     gray.create(bgr.rows, bgr.cols, CV_8UC1);
     
-    // 3) loop through rows (y) and columns (x)
+    // 3) loop through rows (y); grayscale_row does the columns (x)
     for (int y = 0; y < bgr.rows; y++) {
         // ptr<uint8_t>(y) gives us a pointer to the FIRST byte of row y.
         // for CV_8UC3, each pixel is 3 bytes (B,G,R)
@@ -52,19 +103,7 @@ void grayscale_cpu(const cv::Mat& bgr, cv::Mat& gray, int threads) {
         // For CV_8UC1, each pixel is 1 byte (gray)
         uint8_t* outRow = gray.ptr<uint8_t>(y);
 
-        for (int x = 0; x < bgr.cols; x++) {
-            int idx = x * 3; //3 bytes per pixel in the input row
-
-            uint8_t B = inRow[idx + 0];
-            uint8_t G = inRow[idx + 1];
-            uint8_t R = inRow[idx + 2];
-
-            // Weighted grayscale (brightness perception)
-            int g = static_cast<int>(0.114 * B + 0.587 * G + 0.299 * R);
-
-            outRow[x] = clamp_u8(g);
-        }
-
+        grayscale_row(inRow, outRow, bgr.cols);
     }
 
 }
@@ -91,21 +130,31 @@ static void grayscale_rows_worker(const cv::Mat &bgr,
         const uint8_t* inRow = bgr.ptr<uint8_t>(y); // BGR data
         uint8_t* outRow = gray.ptr<uint8_t>(y); // grayscale data
 
-        //Process every pixel in the row
-        for (int x = 0; x < bgr.cols; x++) {
-            int idx = x * 3; //3 bytes per pixel in BGR
+        //Same row kernel as grayscale_cpu, so ST and MT can never differ
+        grayscale_row(inRow, outRow, bgr.cols);
+    }
+}
 
-            uint8_t B = inRow[idx + 0];
-            uint8_t G = inRow[idx + 1];
-            uint8_t R = inRow[idx + 2];
+// Grayscale MT core - splits rows across the pool's workers
+static void grayscale_mt_pool(const cv::Mat &bgr, cv::Mat &gray, ThreadPool &pool) {
+    // Allocate output once (shared output buffer)
+    gray.create(bgr.rows, bgr.cols, CV_8UC1);
 
-            int g = static_cast<int>(0.114 * B * 0.587 * G + 0.299 * R);
-            outRow[x] = clamp_u8(g);
-        }
-    }
+    /*
+    parallel_for cuts [0, rows) into grain-sized tasks (several per worker,
+    see thread_pool.hpp) and calls the lambda once per task; a worker that
+    runs out of tasks steals from the others, so any thread can run any range.
+
+    IMPORTANT - the lambda captures:
+    - bgr by reference (read-only)
+    - gray by reference (each chunk writes different rows)
+    */
+    pool.parallel_for(0, bgr.rows, [&](int y0, int y1, int) {
+        grayscale_rows_worker(bgr, gray, y0, y1);
+    });
 }
 
-// Grayscale MT - spawns threads and splits rows
+// Grayscale MT - one-shot pool (threads are created and joined in this call)
 void grayscale_cpu_mt(const cv::Mat &bgr, cv::Mat &gray, int threads) {
     // 1 - validate input
     if (bgr.empty()) throw std::runtime_error("grayscale_cpu_mt: input empty");
@@ -118,50 +167,21 @@ void grayscale_cpu_mt(const cv::Mat &bgr, cv::Mat &gray, int threads) {
     //If threads > rows, some threads would get 0 rows, so we can cap it
     threads = std::min(threads, bgr.rows);
 
-    // 3 - Allocate output once (shared output buffer)
-    gray.create(bgr.rows, bgr.cols, CV_8UC1);
-
-    // 4 - decide how many rows each each thread should handle
-    int totalRows = bgr.rows;
-
-    //chunk = rows per thread (ceiling division)
-    // ex - 100 rows, 6 threads -> chunk - 17
-    int chunk = (totalRows + threads - 1) / threads;
-
-    // 5 - Create the thread objects
-    std::vector<std::thread> workers;
-    workers.reserve(threads);
-
-    // 6 - spawn threads
-    for (int t = 0; t < threads; t++) {
-        int y0 = t * chunk; // start row
-        int y1 = std::min(totalRows, y0 + chunk); // end row (exclusive)
-
-        // if y0 >= y1, it means no rows left for this thread, stop creating threads
-        if (y0 >= y1) break;
-
-        /*
-       Create a thread that runs grayscale_rows_worker(...) 
-
-       IMPORTANT - We pass:
-       - bgr as const ref (read-only)
-       - gray as ref (write to different rows)
-       - y0/y1 range for this thread
-        
-        */
-        workers.emplace_back(grayscale_rows_worker, std::cref(bgr), std::ref(gray), y0, y1);
-    }
+    ThreadPool pool(threads);
+    grayscale_mt_pool(bgr, gray, pool);
+}
 
-    // 7 - join threads (wait until all are done)
-    // if uou forget to join, program may crash or exit early/
-    for (auto& th : workers) {
-        th.join();
-    }
+// Grayscale MT - reuses the workspace's persistent pool
+void grayscale_cpu_mt_ws(const cv::Mat &bgr, cv::Mat &gray, int threads, CpuWorkspace &ws) {
+    if (bgr.empty()) throw std::runtime_error("grayscale_cpu_mt_ws: input empty");
+    if (bgr.type() != CV_8UC3) throw std::runtime_error("grayscale_cpu_mt_ws: expected CV_8UC3");
 
+    grayscale_mt_pool(bgr, gray, ws.ensureThreads(threads));
 }
 
 // Fast box blur using two 1D passes (horizontal then vertical).
 // This is still a true box blur, just computed efficiently.
+// One-shot: allocates its scratch every call (the pipeline uses the _ws versions)
 void box_blur_cpu_fast(const cv::Mat& gray, cv::Mat& blurred, int radius, int threads) {
     if (threads > 1) {
         box_blur_cpu_fast_mt(gray, blurred, radius, threads);
@@ -174,140 +194,142 @@ void box_blur_cpu_fast(const cv::Mat& gray, cv::Mat& blurred, int radius, int th
 
     int w = gray.cols;
     int h = gray.rows;
-    int k = 2 * radius + 1;
+
+    // Radius <= 128: uint16 sums and radius-specialized passes (blur_narrow.cpp)
+    if (radius <= kBlurNarrowMaxRadius) {
+        std::vector<uint16_t> tmp16((size_t)w * h);
+        blur_hpass_u16(gray, tmp16.data(), radius, 0, h);
+        blurred.create(h, w, CV_8UC1);
+        std::vector<int> colSum(w);
+        blur_vpass_u16(tmp16.data(), w, h, blurred, radius, 0, h, colSum.data());
+        return;
+    }
 
     // 2) Temporary buffer for the horizontal pass (store ints so sums don't overflow)
     // tmp[y*w + x] will hold the horizontally blurred value (still not divided vertically yet)
     std::vector<int> tmp(w * h, 0);
 
     // PASS 1: Horizontal sliding sum
-    for (int y = 0; y < h; y++) {
-        const uint8_t* row = gray.ptr<uint8_t>(y);
-
-        // Compute initial window sum for x=0
-        // Window covers [x-radius, x+radius], but we clamp to [0, w-1]
-        int sum = 0;
-        for (int dx = -radius; dx <= radius; dx++) {
-            int xx = std::clamp(dx, 0, w - 1); // since x=0, x+dx = dx
-            sum += row[xx];
-        }
-
-        // Store result for x=0 (not divided by k yet? we can divide now)
-        tmp[y * w + 0] = sum;
-
-        // Slide window across the row
-        for (int x = 1; x < w; x++) {
-            // Pixel leaving window: x-1-radius
-            int x_out = std::clamp(x - 1 - radius, 0, w - 1);
-            // Pixel entering window: x+radius
-            int x_in  = std::clamp(x + radius, 0, w - 1);
-
-            sum -= row[x_out];
-            sum += row[x_in];
-
-            tmp[y * w + x] = sum;
-        }
-    }
+    blur_horizontal_rows_worker(gray, tmp.data(), radius, 0, h);
 
     // 3) Allocate output
     blurred.create(h, w, CV_8UC1);
 
-    // PASS 2: Vertical sliding sum
-    // Now we blur the horizontal sums vertically and divide by k*k.
-    for (int x = 0; x < w; x++) {
-        // Initial vertical window sum for y=0
-        int sum = 0;
-        for (int dy = -radius; dy <= radius; dy++) {
-            int yy = std::clamp(dy, 0, h - 1); // since y=0, y+dy = dy
-            sum += tmp[yy * w + x];
-        }
-
-        // Write output for y=0
-        int area = k * k;
-        blurred.ptr<uint8_t>(0)[x] = static_cast<uint8_t>(std::clamp(sum / area, 0, 255));
-
-        // Slide window down the column
-        for (int y = 1; y < h; y++) {
-            int y_out = std::clamp(y - 1 - radius, 0, h - 1);
-            int y_in  = std::clamp(y + radius, 0, h - 1);
-
-            sum -= tmp[y_out * w + x];
-            sum += tmp[y_in * w + x];
-
-            blurred.ptr<uint8_t>(y)[x] = static_cast<uint8_t>(std::clamp(sum / area, 0, 255));
-        }
-    }
+    // PASS 2: Vertical sliding sum, one whole row at a time
+    // (colSum = running sum of 2r+1 tmp rows for every column)
+    std::vector<int> colSum(w);
+    blur_vertical_rows_worker(tmp.data(), blurred, w, h, radius, 0, h, colSum.data());
 }
+
 // pass 1 worker - horizontal blur for rows [y0, y1]
 // writes into tmp[] but only for those rows -> safe
 static void blur_horizontal_rows_worker(
     const cv::Mat& gray,
-    std::vector<int>& tmp,
+    int* tmp,
     int radius,
     int y0, 
     int y1
 ) {
     int w = gray.cols; //width of image in pixels
-    int k = 2 * radius + 1; //k = kernel width (how many pixels in the horizontal window)
 
-    //initial sum for x = 0
-    int sum = 0;
     for (int y = y0; y < y1; y++) {
-        const uint8_t* row = gray.ptr<uint8_t>(y); // pointer to the start of row y (faster than calling gray.at<> 4 every pixel) 
-
-        // Initial sum for x=0
-        // compute initial window sum or x=0
-        int sum = 0;
-        for (int dx = -radius; dx <= radius; dx++) {
-            int xx = std::clamp(dx, 0, w - 1);
-            sum += row[xx];
-        }
-        tmp[y * w + 0] = sum;
-
-        // Slide across the row
-        for (int x = 1; x < w; x++) {
-            int x_out = std::clamp(x - 1 - radius, 0, w -1);
-            int x_in = std::clamp(x + radius, 0, w - 1);
-            sum -= row[x_out];
-            sum += row[x_in];
-            tmp[y * w + x] = sum;
-        }
+        // pointer to the start of row y (faster than calling gray.at<> 4 every pixel)
+        const uint8_t* row = gray.ptr<uint8_t>(y);
+        blur_hsum_row(row, &tmp[(size_t)y * w], w, radius);
     }
 }
 
-static void blur_vertical_cols_worker(
-    const std::vector<int>& tmp,
+/*
+pass 2 worker - vertical blur for output rows [y0, y1)
+
+Instead of walking each column top to bottom (stride of w ints per step,
+which thrashes cache and TLB on wide frames), we keep a whole row of
+running column sums and slide the window down one ROW at a time:
+  colSum += tmp[row entering] - tmp[row leaving]
+Every inner loop is a straight pass over contiguous memory, so the
+compiler can vectorize it, and splitting by rows means threads never
+write to the same cache line.
+
+colSum must hold w ints (scratch owned by the caller, one per thread)
+*/
+static void blur_vertical_rows_worker(
+    const int* tmp,
     cv::Mat& blurred,
     int w,
     int h,
     int radius,
-    int x0,
-    int x1
+    int y0,
+    int y1,
+    int* colSum
 ) {
     int k = 2 * radius + 1;
     int area = k * k;
 
-    for (int x = x0; x < x1; x++) {
-        // Initial sum for y=0
-        int sum = 0;
-        for (int dy = -radius; dy <= radius; dy++) {
-            int yy = std::clamp(dy, 0, h - 1);
-            sum += tmp[yy * w + x];
-        }
+    // Row yy of tmp, with rows above/below the image repeating the edge row
+    auto tmpRow = [&](int yy) -> const int* {
+        return &tmp[(size_t)std::clamp(yy, 0, h - 1) * w];
+    };
+
+    // Initial window for y0: rows [y0-r, y0+r]
+    std::fill(colSum, colSum + w, 0);
+    for (int yy = y0 - radius; yy <= y0 + radius; yy++) {
+        blur_vsum_add_row(colSum, tmpRow(yy), w);
+    }
+    blur_divide_row(colSum, blurred.ptr<uint8_t>(y0), w, area);
+
+    // Slide down
+    for (int y = y0 + 1; y < y1; y++) {
+        blur_vsum_slide_row(colSum, tmpRow(y + radius), tmpRow(y - 1 - radius), w);
+        blur_divide_row(colSum, blurred.ptr<uint8_t>(y), w, area);
+    }
+}
+
+// Both blur passes on a pool, both split by rows.
+// colSums holds one row of w ints per pool worker.
+static void box_blur_mt_pool(
+    const cv::Mat& gray,
+    cv::Mat& blurred,
+    int* tmp,
+    int* colSums,
+    int radius,
+    ThreadPool& pool
+) {
+    int w = gray.cols;
+    int h = gray.rows;
 
-        blurred.ptr<uint8_t>(0)[x] = (uint8_t)std::clamp(sum / area, 0, 255);
+    pool.parallel_for(0, h, [&](int y0, int y1, int) {
+        blur_horizontal_rows_worker(gray, tmp, radius, y0, y1);
+    });
 
-        // Slide down
-        for (int y = 1; y < h; y++) {
-            int y_out = std::clamp(y - 1 - radius, 0, h - 1);
-            int y_in  = std::clamp(y + radius,     0, h - 1);
+    // Allocate output (OpenCV Mat reuses memory if same shape/type)
+    blurred.create(h, w, CV_8UC1);
 
-            sum -= tmp[y_out * w + x];
-            sum += tmp[y_in  * w + x];
+    pool.parallel_for(0, h, [&](int y0, int y1, int tid) {
+        blur_vertical_rows_worker(tmp, blurred, w, h, radius, y0, y1, colSums + (size_t)tid * w);
+    });
+}
 
-            blurred.ptr<uint8_t>(y)[x] = (uint8_t)std::clamp(sum / area, 0, 255);
-        }
-    }
+// Same two passes with uint16 sums (radius <= kBlurNarrowMaxRadius)
+static void box_blur_mt_pool_u16(
+    const cv::Mat& gray,
+    cv::Mat& blurred,
+    uint16_t* tmp,
+    int* colSums,
+    int radius,
+    ThreadPool& pool
+) {
+    int w = gray.cols;
+    int h = gray.rows;
+
+    pool.parallel_for(0, h, [&](int y0, int y1, int) {
+        blur_hpass_u16(gray, tmp, radius, y0, y1);
+    });
+
+    blurred.create(h, w, CV_8UC1);
+
+    pool.parallel_for(0, h, [&](int y0, int y1, int tid) {
+        blur_vpass_u16(tmp, w, h, blurred, radius, y0, y1, colSums + (size_t)tid * w);
+    });
 }
 
 void box_blur_cpu_fast_mt(const cv::Mat& gray, cv::Mat& blurred, int radius, int threads) {
@@ -323,170 +345,81 @@ void box_blur_cpu_fast_mt(const cv::Mat& gray, cv::Mat& blurred, int radius, int
     if (threads < 1) threads = 1;
     threads = std::min(threads, h); // for row-splitting pass
 
-    // 3) tmp holds horizontal sums
-    std::vector<int> tmp(w * h, 0);
+    // 3) One-shot pool for both passes (+ one column-sum row per thread)
+    ThreadPool pool(threads);
+    std::vector<int> colSums((size_t)threads * w);
 
-    // 4) PASS 1: split by rows
-    {
-        int chunk = (h + threads - 1) / threads;
-        std::vector<std::thread> workers;
-        workers.reserve(threads);
-
-        for (int t = 0; t < threads; t++) {
-            int y0 = t * chunk;
-            int y1 = std::min(h, y0 + chunk);
-            if (y0 >= y1) break;
-
-            workers.emplace_back(blur_horizontal_rows_worker,
-                                 std::cref(gray), std::ref(tmp),
-                                 radius, y0, y1);
-        }
-        for (auto& th : workers) th.join();
-    }
-
-    // 5) Allocate output
-    blurred.create(h, w, CV_8UC1);
-
-    // 6) PASS 2: split by columns
-    // Here, splitting by columns makes sense because each worker writes different columns.
-    {
-        int threads2 = std::min(threads, w); // cap by number of columns
-        int chunk = (w + threads2 - 1) / threads2;
-        std::vector<std::thread> workers;
-        workers.reserve(threads2);
-
-        for (int t = 0; t < threads2; t++) {
-            int x0 = t * chunk;
-            int x1 = std::min(w, x0 + chunk);
-            if (x0 >= x1) break;
-
-            workers.emplace_back(blur_vertical_cols_worker,
-                                 std::cref(tmp), std::ref(blurred),
-                                 w, h, radius, x0, x1);
-        }
-        for (auto& th : workers) th.join();
+    // 4) tmp holds horizontal sums (uint16 when the radius allows)
+    if (radius <= kBlurNarrowMaxRadius) {
+        std::vector<uint16_t> tmp16((size_t)w * h);
+        box_blur_mt_pool_u16(gray, blurred, tmp16.data(), colSums.data(), radius, pool);
+        return;
     }
+    std::vector<int> tmp(w * h, 0);
+    box_blur_mt_pool(gray, blurred, tmp.data(), colSums.data(), radius, pool);
 }
     
-void sobel_cpu(const cv::Mat& gray, cv::Mat& edges, int threads) {
+// Sobel rows [y0, y1). Rows above/below the frame repeat the edge row,
+// so every output pixel (borders included) is a real gradient.
+static void sobel_rows_worker(const cv::Mat& gray, cv::Mat& edges, int y0, int y1, SobelNorm norm) {
+    int h = gray.rows;
+    for (int y = y0; y < y1; y++) {
+        sobel_row(gray.ptr<uint8_t>(std::max(y - 1, 0)),
+                  gray.ptr<uint8_t>(y),
+                  gray.ptr<uint8_t>(std::min(y + 1, h - 1)),
+                  edges.ptr<uint8_t>(y), gray.cols, norm);
+    }
+}
+
+void sobel_cpu(const cv::Mat& gray, cv::Mat& edges, int threads, SobelNorm norm) {
     if (threads > 1) {
-        sobel_cpu_mt(gray, edges, threads);
+        sobel_cpu_mt(gray, edges, threads, norm);
         return;
     }
     // Validate input
     if (gray.empty()) throw std::runtime_error("sobel_cpu: input empty");
     if (gray.type() != CV_8UC1) throw std::runtime_error("sobel_cpu: expected CV_8UC1");
 
-    int w = gray.cols;
-    int h = gray.rows;
-
     // Allocate output
-    edges.create(h, w, CV_8UC1);
-
-    // Sobel kernels
-    // Gx (horizontal gradient):
-    //  -1  0  1
-    //  -2  0  2
-    //  -1  0  1
-    // Gy (vertical gradient):
-    //  -1 -2 -1
-    //   0  0  0
-    //   1  2  1
-
-    for (int y = 1; y < h - 1; y++) {
-        const uint8_t* row_m1 = gray.ptr<uint8_t>(y - 1);
-        const uint8_t* row_0  = gray.ptr<uint8_t>(y);
-        const uint8_t* row_p1 = gray.ptr<uint8_t>(y + 1);
-        uint8_t* outRow = edges.ptr<uint8_t>(y);
-
-        for (int x = 1; x < w - 1; x++) {
-            // Compute Gx (horizontal gradient)
-            int gx = -1 * row_m1[x - 1] + 1 * row_m1[x + 1]
-                   + -2 * row_0[x - 1]  + 2 * row_0[x + 1]
-                   + -1 * row_p1[x - 1] + 1 * row_p1[x + 1];
-
-            // Compute Gy (vertical gradient)
-            int gy = -1 * row_m1[x - 1] + -2 * row_m1[x] + -1 * row_m1[x + 1]
-                   +  1 * row_p1[x - 1] +  2 * row_p1[x] +  1 * row_p1[x + 1];
-
-            // Magnitude: sqrt(gx^2 + gy^2)
-            int magnitude = static_cast<int>(std::sqrt(gx * gx + gy * gy));
-            outRow[x] = clamp_u8(magnitude);
-        }
-    }
+    edges.create(gray.rows, gray.cols, CV_8UC1);
 
-    // Set border pixels to 0 (can't compute gradient at edges)
-    for (int y = 0; y < h; y++) {
-        uint8_t* outRow = edges.ptr<uint8_t>(y);
-        if (y == 0 || y == h - 1) {
-            for (int x = 0; x < w; x++) {
-                outRow[x] = 0;
-            }
-        } else {
-            outRow[0] = 0;
-            outRow[w - 1] = 0;
-        }
-    }
+    // Same row kernel as the MT version, just one band covering the frame
+    sobel_rows_worker(gray, edges, 0, gray.rows, norm);
 }
-static void sobel_rows_worker(const cv::Mat& gray, cv::Mat& edges, int y0, int y1) {
-    const int Gx[3][3] = {{-1,0,1},{-2,0,2},{-1,0,1}};
-    const int Gy[3][3] = {{-1,-2,-1},{0,0,0},{1,2,1}};
 
-    for (int y = y0; y < y1; y++) {
-        uint8_t* outRow = edges.ptr<uint8_t>(y);
-
-        for (int x = 0; x < gray.cols; x++) {
-            int sx = 0, sy = 0;
-
-            for (int dy = -1; dy <= 1; dy++) {
-                int yy = std::clamp(y + dy, 0, gray.rows - 1);
-                const uint8_t* row = gray.ptr<uint8_t>(yy);
-
-                for (int dx = -1; dx <= 1; dx++) {
-                    int xx = std::clamp(x + dx, 0, gray.cols - 1);
-                    int p = row[xx];
-                    sx += p * Gx[dy + 1][dx + 1];
-                    sy += p * Gy[dy + 1][dx + 1];
-                }
-            }
-
-            int mag = std::abs(sx) + std::abs(sy);
-            outRow[x] = (uint8_t)std::clamp(mag, 0, 255);
-        }
-    }
+static void sobel_mt_pool(const cv::Mat& gray, cv::Mat& edges, SobelNorm norm, ThreadPool& pool) {
+    edges.create(gray.rows, gray.cols, CV_8UC1);
+
+    pool.parallel_for(0, gray.rows, [&](int y0, int y1, int) {
+        sobel_rows_worker(gray, edges, y0, y1, norm);
+    });
 }
 
-void sobel_cpu_mt(const cv::Mat& gray, cv::Mat& edges, int threads) {
+void sobel_cpu_mt(const cv::Mat& gray, cv::Mat& edges, int threads, SobelNorm norm) {
     if (gray.empty()) throw std::runtime_error("sobel_cpu_mt: input empty");
     if (gray.type() != CV_8UC1) throw std::runtime_error("sobel_cpu_mt: expected CV_8UC1");
 
     if (threads < 1) threads = 1;
     threads = std::min(threads, gray.rows);
 
-    edges.create(gray.rows, gray.cols, CV_8UC1);
-
-    int h = gray.rows;
-    int chunk = (h + threads - 1) / threads;
-
-    std::vector<std::thread> workers;
-    workers.reserve(threads);
+    ThreadPool pool(threads);
+    sobel_mt_pool(gray, edges, norm, pool);
+}
 
-    for (int t = 0; t < threads; t++) {
-        int y0 = t * chunk;
-        int y1 = std::min(h, y0 + chunk);
-        if (y0 >= y1) break;
+void sobel_cpu_mt_ws(const cv::Mat& gray, cv::Mat& edges, int threads, CpuWorkspace& ws,
+                     SobelNorm norm) {
+    if (gray.empty()) throw std::runtime_error("sobel_cpu_mt_ws: input empty");
+    if (gray.type() != CV_8UC1) throw std::runtime_error("sobel_cpu_mt_ws: expected CV_8UC1");
 
-        workers.emplace_back(sobel_rows_worker, std::cref(gray), std::ref(edges), y0, y1);
-    }
-    for (auto& th : workers) th.join();
+    sobel_mt_pool(gray, edges, norm, ws.ensureThreads(threads));
 }
 // We reuse your existing workers:
 // - blur_horizontal_rows_worker(...)
-// - blur_vertical_cols_worker(...)
+// - blur_vertical_rows_worker(...)
 //
-// The ONLY difference is where tmp comes from:
-// - BEFORE: tmp = new vector every call
-// - NOW: tmp = ws.tmp reused
+// The ONLY differences are where tmp and the threads come from:
+// - BEFORE: tmp = new vector every call, threads spawned every call
+// - NOW: tmp = ws.tmp reused, threads = ws.workers reused (+ ws.colSums)
 
 void box_blur_cpu_fast_mt_ws(
     const cv::Mat& gray,
@@ -500,61 +433,35 @@ void box_blur_cpu_fast_mt_ws(
     if (gray.type() != CV_8UC1) throw std::runtime_error("box_blur_cpu_fast_mt_ws: expected CV_8UC1");
     if (radius < 1) throw std::runtime_error("box_blur_cpu_fast_mt_ws: radius must be >= 1");
 
-    int w = gray.cols;
-    int h = gray.rows;
-
     // 2) Ensure workspace has correct size (allocates only if needed)
-    ws.ensureSize(w, h);
-
-    // tmp is now a reference to the workspace buffer
-    std::vector<int>& tmp = ws.tmp;
+    bool narrow = radius <= kBlurNarrowMaxRadius;
+    ws.ensureSize(gray.cols, gray.rows, narrow);
+
+    // 3) Both passes on the persistent pool
+    ThreadPool& pool = ws.ensureThreads(threads);
+    ws.ensureColSums(pool.size());
+    if (narrow) box_blur_mt_pool_u16(gray, blurred, ws.tmp16.data(), ws.colSums.data(), radius, pool);
+    else box_blur_mt_pool(gray, blurred, ws.tmp.data(), ws.colSums.data(), radius, pool);
+}
 
-    // 3) Clamp thread count
-    if (threads < 1) threads = 1;
-    threads = std::min(threads, h);
-
-    // -----------------------------
-    // PASS 1: Horizontal (split by rows)
-    // -----------------------------
-    {
-        int chunk = (h + threads - 1) / threads;
-        std::vector<std::thread> workers;
-        workers.reserve(threads);
-
-        for (int t = 0; t < threads; t++) {
-            int y0 = t * chunk;
-            int y1 = std::min(h, y0 + chunk);
-            if (y0 >= y1) break;
-
-            workers.emplace_back(blur_horizontal_rows_worker,
-                                 std::cref(gray), std::ref(tmp),
-                                 radius, y0, y1);
-        }
-        for (auto& th : workers) th.join();
-    }
+// Same passes on the caller's thread, on the same workspace buffers
+void box_blur_cpu_fast_ws(const cv::Mat& gray, cv::Mat& blurred, int radius, CpuWorkspace& ws) {
+    if (gray.empty()) throw std::runtime_error("box_blur_cpu_fast_ws: input empty");
+    if (gray.type() != CV_8UC1) throw std::runtime_error("box_blur_cpu_fast_ws: expected CV_8UC1");
+    if (radius < 1) throw std::runtime_error("box_blur_cpu_fast_ws: radius must be >= 1");
 
-    // 4) Allocate output (OpenCV Mat reuses memory if same shape/type)
+    int w = gray.cols;
+    int h = gray.rows;
+    bool narrow = radius <= kBlurNarrowMaxRadius;
+    ws.ensureSize(w, h, narrow);
+    ws.ensureColSums(1);
     blurred.create(h, w, CV_8UC1);
 
-    // -----------------------------
-    // PASS 2: Vertical (split by columns)
-    // -----------------------------
-    {
-        int threads2 = std::min(threads, w);
-        int chunk = (w + threads2 - 1) / threads2;
-
-        std::vector<std::thread> workers;
-        workers.reserve(threads2);
-
-        for (int t = 0; t < threads2; t++) {
-            int x0 = t * chunk;
-            int x1 = std::min(w, x0 + chunk);
-            if (x0 >= x1) break;
-
-            workers.emplace_back(blur_vertical_cols_worker,
-                                 std::cref(tmp), std::ref(blurred),
-                                 w, h, radius, x0, x1);
-        }
-        for (auto& th : workers) th.join();
+    if (narrow) {
+        blur_hpass_u16(gray, ws.tmp16.data(), radius, 0, h);
+        blur_vpass_u16(ws.tmp16.data(), w, h, blurred, radius, 0, h, ws.colSums.data());
+    } else {
+        blur_horizontal_rows_worker(gray, ws.tmp.data(), radius, 0, h);
+        blur_vertical_rows_worker(ws.tmp.data(), blurred, w, h, radius, 0, h, ws.colSums.data());
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,160 @@
+#include "frame_ops.hpp"
+#include "cpu_features.hpp"
+
+#include <iostream>
+#include <string>
+#include <stdexcept>
+
+FilterGraph buildGraph(const Args& args, PixelFormat input) {
+    std::string spec = args.stages;
+    if (spec.empty()) {
+        if (args.color) spec = "planar,blur,sobel";
+        else spec = (input == PixelFormat::GRAY8) ? "blur,sobel" : "gray,blur,sobel";
+    }
+    FilterGraph g = FilterGraph::parse(spec, args.radius, args.sobelNorm, input);
+    if (args.fused) g.fuse();
+    return g;
+}
+
+void FrameBuffers::setup(const Args& args, int w, int h, CpuWorkspace& ws, PixelFormat input) {
+    graph = buildGraph(args, input);
+    graph.plan(w, h, ws);
+    createFrame(edges, graph.outputFormat(), w, h, ws);
+}
+
+const cv::Mat& writerFrame(const cv::Mat& out, cv::Mat& bgr) {
+    if (out.type() == CV_8UC3) return out; // colour chain: already BGR
+    cv::cvtColor(out, bgr, cv::COLOR_GRAY2BGR);
+    return bgr;
+}
+
+void processFrame(const cv::Mat& bgr, FrameBuffers& buf, CpuWorkspace& ws,
+                  const Args& args, StageTimes& t) {
+    int threads = (args.mode == Mode::CPU_MT) ? args.threads : 1;
+    TraceSpan frameSpan("frame", "frame");
+
+    buf.graph.run(bgr, buf.edges, threads, ws, t.ms);
+    t.count = buf.graph.size();
+}
+
+void openVideoInput(const Args& args, cv::VideoCapture& cap, int& w, int& h, double& fps) {
+    cap.open(args.videoPath);
+    if (!cap.isOpened()) throw std::runtime_error("Failed to open video: " + args.videoPath);
+
+    if (args.mode == Mode::GPU) {
+        throw std::runtime_error("GPU mode not available on this machine (CUDA requires NVIDIA).");
+    }
+
+    w = (int)cap.get(cv::CAP_PROP_FRAME_WIDTH);
+    h = (int)cap.get(cv::CAP_PROP_FRAME_HEIGHT);
+    fps = cap.get(cv::CAP_PROP_FPS);
+    if (fps <= 0) fps = 30.0;
+}
+
+void openVideoWriter(cv::VideoWriter& writer, const std::string& path, double fps, int w, int h) {
+    // Output writer (expects BGR frames)
+    int fourcc = cv::VideoWriter::fourcc('m','p','4','v');
+    writer.open(path, fourcc, fps, cv::Size(w, h), true);
+    if (!writer.isOpened()) throw std::runtime_error("Failed to open VideoWriter: " + path);
+}
+
+void openVideoIO(const Args& args, cv::VideoCapture& cap, cv::VideoWriter& writer,
+                 int& w, int& h, double& fps) {
+    openVideoInput(args, cap, w, h, fps);
+    openVideoWriter(writer, args.outPath, fps, w, h);
+}
+
+int tiledBandRows(const Args& args, int w, int h) {
+    int rows = args.tileRows > 0 ? args.tileRows : std::max(64, (1 << 20) / std::max(1, w));
+    return std::min(rows, h);
+}
+
+std::string suffixedPath(const std::string& path, const std::string& suffix) {
+    size_t slash = path.find_last_of("/\\");
+    size_t dot = path.rfind('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) dot = path.size();
+    return path.substr(0, dot) + suffix + path.substr(dot);
+}
+
+// Helper: convert Mode to string for printing
+const char* modeName(Mode m) {
+    switch (m) {
+        case Mode::CPU_SINGLE: return "cpu-single";
+        case Mode::CPU_MT:     return "cpu-mt";
+        case Mode::GPU:        return "gpu";
+    }
+    return "unknown";
+}
+
+// Helper: print how much of the MT time went to the pool itself
+// (waking workers + join) versus the slowest chunk's actual work,
+// after the workspace's arena footprint.
+void printPoolStats(const CpuWorkspace& ws) {
+    if (ws.mem) {
+        const Arena& a = *ws.mem;
+        std::cout << "  arena:     " << a.used() / 1024 << " KB used / " << a.committed() / 1024
+                  << " KB committed, " << Arena::kAlign << " B aligned, pages=" << hugePagesName(a.pages())
+                  << (a.prefaulted() ? ", prefaulted" : "") << "\n";
+    }
+    if (!ws.workers) return;
+    printPoolStats(ws.workers->stats(), 1, ws.workers->size());
+}
+
+void printPoolStats(const PoolStats& s, int pools, int poolSize) {
+    double pct = (s.wallMs > 0) ? 100.0 * s.overheadMs() / s.wallMs : 0.0;
+    std::cout << "  pool:      ";
+    if (pools > 1) std::cout << pools << " x ";
+    std::cout << poolSize << " workers, " << s.dispatches << " dispatches\n";
+    std::cout << "    compute:  " << s.computeMs << " ms (critical path), "
+              << s.busyMs << " ms (all workers)\n";
+    std::cout << "    overhead: " << s.overheadMs() << " ms (" << pct << "% of parallel time)\n";
+    // Idle = workers waiting at the join; steals = blocks that moved to an idle worker
+    double workerMs = s.wallMs * pools * poolSize;
+    double idlePct = (workerMs > 0) ? 100.0 * s.idleMs / workerMs : 0.0;
+    std::cout << "    tasks:    " << s.tasks << " (" << (s.dispatches ? (double)s.tasks / s.dispatches : 0.0)
+              << " per dispatch), " << s.steals << " steals\n";
+    std::cout << "    idle:     " << s.idleMs << " ms (" << idlePct << "% of worker time)\n";
+}
+
+void printRunHeader(const char* tag, int w, int h, const Args& args) {
+    std::cout << "[" << tag << "] mode=" << modeName(args.mode)
+;
+    if (w > 0) std::cout << " size=" << w << "x" << h;
+    std::cout << " threads=" << args.threads
+              << " isa=" << cpuIsaName(activeCpuIsa())
+              << " norm=" << sobelNormName(args.sobelNorm);
+    if (!args.inputDir.empty() || !args.listPath.empty()) {
+        std::cout << " filter-workers=" << args.framesInFlight << " io-threads=" << args.ioThreads;
+    } else if (!args.videoPath.empty()) {
+        if (args.framesInFlight > 1) std::cout << " frames-in-flight=" << args.framesInFlight;
+        else if (args.pipelined) std::cout << " pipelined depth=" << args.queueDepth;
+    }
+    std::cout << "\n";
+}
+
+static void printLatencyLine(const char* label, const LatencyHistogram& h) {
+    if (h.count() == 0) return;
+    std::cout << "  " << label << h.mean()
+              << " ms  (p50 " << h.percentile(0.50)
+              << ", p90 " << h.percentile(0.90)
+              << ", p99 " << h.percentile(0.99)
+              << ", max " << h.max() << ")\n";
+}
+
+void printGraphPlan(const FilterGraph& g) {
+    std::cout << "  stages:    " << g.describe() << "\n";
+    std::cout << "    planned: " << g.plannedPlanes() << " intermediate plane(s), "
+              << g.plannedBytes() / 1024 << " KB, halo "
+              << (g.local() ? std::to_string(g.totalHalo()) + " px" : std::string("unbounded (non-local stage)")) << "\n";
+}
+
+void printStageStats(const StageStats& st, const FilterGraph& g) {
+    printLatencyLine("avg decode: ", st.decode);
+    for (int i = 0; i < g.size(); i++) {
+        std::string label = "avg " + g.stage(i).label() + ": ";
+        printLatencyLine(label.c_str(), st.stage[i]);
+    }
+    if (g.size() > 1) printLatencyLine("avg filters: ", st.compute);
+    printLatencyLine("avg encode: ", st.encode);
+    printLatencyLine("latency:   ", st.latency);
+}
@@ -0,0 +1,120 @@
+#include "filters_cpu.hpp"
+#include "row_kernels.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+/*
+Fused gray -> blur -> sobel
+
+The staged path writes three full frames (gray, blurred, edges) plus the
+w*h int tmp buffer, and every stage streams the whole frame through memory
+before the next one starts.
+
+Here each worker walks its band of output rows top to bottom and keeps only:
+- 1 gray row           (converted, summed horizontally, then forgotten)
+- 2r+2 hsum rows       (ring: enough to slide the vertical window by one row)
+- 1 colSum row         (the running vertical sum, same trick as the blur)
+- 3 blurred rows       (ring: the 3x3 Sobel window)
+
+A new source row enters at the bottom of the windows, one edge row comes
+out. Everything stays in cache; only the BGR input and edges output touch DRAM.
+
+The row math is the same grayscale_row / blur_hsum_row / sobel_row
+used by the staged single-thread path, so the output is identical to it.
+*/
+
+// Produce edge rows [y0, y1) using one set of line buffers
+static void fused_band(const cv::Mat& bgr, cv::Mat& edges, int radius, SobelNorm norm,
+                       int y0, int y1, CpuWorkspace::LineBuffers& lb) {
+    int w = bgr.cols;
+    int h = bgr.rows;
+    int area = (2 * radius + 1) * (2 * radius + 1);
+    int ring = 2 * radius + 2;
+    if (y0 >= y1) return;
+
+    // Edge row y needs blurred rows y-1, y, y+1, clamped to the frame
+    // (same replicate rule as sobel_cpu), so this band needs blurred [b0, b1)
+    int b0 = std::max(0, y0 - 1);
+    int b1 = std::min(h, y1 + 1);
+
+    // hsum row for (unclamped) source row yy lives in ring slot yy mod ring.
+    // base keeps the modulo argument non-negative.
+    int base = b0 - radius - 1;
+    auto hrow = [&](int yy) -> int* {
+        return &lb.hsum[(size_t)((yy - base) % ring) * w];
+    };
+    // Load source row yy: gray it, then horizontal sums.
+    // Rows above/below the image repeat the edge row (same clamp as the blur).
+    auto load = [&](int yy) {
+        int src = std::clamp(yy, 0, h - 1);
+        grayscale_row(bgr.ptr<uint8_t>(src), lb.gray.data(), w);
+        blur_hsum_row(lb.gray.data(), hrow(yy), w, radius);
+    };
+    auto brow = [&](int b) -> uint8_t* {
+        return &lb.blurred[(size_t)(b % 3) * w];
+    };
+    // Edge row y, once its lowest blurred row min(y+1, h-1) exists
+    auto emit = [&](int y) {
+        sobel_row(brow(std::max(y - 1, 0)), brow(y), brow(std::min(y + 1, h - 1)),
+                  edges.ptr<uint8_t>(y), w, norm);
+    };
+
+    int* colSum = lb.colSum.data();
+
+    // Prime the vertical window for blurred row b0: rows [b0-r, b0+r]
+    std::fill(colSum, colSum + w, 0);
+    for (int yy = b0 - radius; yy <= b0 + radius; yy++) {
+        load(yy);
+        blur_vsum_add_row(colSum, hrow(yy), w);
+    }
+
+    for (int b = b0; b < b1; b++) {
+        if (b > b0) {
+            // Slide down one row: add the row entering, subtract the row leaving
+            load(b + radius);
+            blur_vsum_slide_row(colSum, hrow(b + radius), hrow(b - radius - 1), w);
+        }
+
+        blur_divide_row(colSum, brow(b), w, area);
+
+        // Blurred row b completes edge row b-1 (its row below) ...
+        if (b - 1 >= y0 && b - 1 < y1) emit(b - 1);
+        // ... and, at the bottom of the frame, edge row h-1 (row below = itself)
+        if (b == h - 1 && b >= y0 && b < y1) emit(b);
+    }
+}
+
+void fused_gray_blur_sobel(
+    const cv::Mat& bgr,
+    cv::Mat& edges,
+    int radius,
+    int threads,
+    CpuWorkspace& ws,
+    SobelNorm norm
+) {
+    // 1) Validate input
+    if (bgr.empty()) throw std::runtime_error("fused_gray_blur_sobel: input empty");
+    if (bgr.type() != CV_8UC3) throw std::runtime_error("fused_gray_blur_sobel: expected CV_8UC3");
+    if (radius < 1) throw std::runtime_error("fused_gray_blur_sobel: radius must be >= 1");
+
+    if (threads < 1) threads = 1;
+
+    // 2) Allocate output (reused if same shape/type)
+    edges.create(bgr.rows, bgr.cols, CV_8UC1);
+
+    // 3) Single thread: one band covering the whole frame
+    if (threads == 1) {
+        ws.ensureLines(1, bgr.cols, radius);
+        fused_band(bgr, edges, radius, norm, 0, bgr.rows, ws.lines[0]);
+        return;
+    }
+
+    // 4) MT: bands handed out by the pool, line buffers per worker.
+    // Bands recompute the 2r+2 halo rows above them instead of sharing,
+    // so keep them at least 8x that tall (halo work <= ~1/8 extra).
+    ThreadPool& pool = ws.ensureThreads(threads);
+    ws.ensureLines(pool.size(), bgr.cols, radius);
+    pool.parallel_for(0, bgr.rows, [&](int y0, int y1, int tid) {
+        fused_band(bgr, edges, radius, norm, y0, y1, ws.lines[tid]);
+    }, 8 * (2 * radius + 2));
+}
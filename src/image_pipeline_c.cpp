@@ -0,0 +1,234 @@
+#include "image_pipeline.h"
+#include "pipeline.hpp"
+#include "frame_ops.hpp"
+#include "cpu_features.hpp"
+
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+/*
+The C API (image_pipeline.h) over the same pieces a Pipeline run uses:
+Args -> buildGraph for the chain, one CpuWorkspace for every buffer and
+the worker pool, FilterGraph::run for the frame.
+
+Caller buffers become cv::Mat headers with the caller's stride (no
+copy); every kernel addresses rows through Mat::ptr(y), and the graph's
+last stage writes straight into its output Mat, so with a header of the
+right size and type the result lands in the caller's memory directly.
+
+The graph is built for one input format and rebuilt if the next call
+brings the other (gray vs. BGR); planning for a new size only grows the
+workspace, it never shrinks it.
+*/
+
+struct ip_context {
+    Args args;
+    CpuWorkspace ws;
+    FilterGraph graph;
+    PixelFormat graphInput = PixelFormat::BGR8;
+    bool built = false;
+    std::string error;
+};
+
+namespace {
+
+// ip_create / ip_set_isa_limit failures have no context to keep the message in
+thread_local std::string tlsError;
+
+PixelFormat toPixelFormat(ip_format f) {
+    switch (f) {
+        case IP_GRAY8: return PixelFormat::GRAY8;
+        case IP_BGR8:  return PixelFormat::BGR8;
+    }
+    throw std::invalid_argument("unknown ip_format " + std::to_string((int)f));
+}
+
+int channels(ip_format f) {
+    return f == IP_BGR8 ? 3 : 1;
+}
+
+// Header over a caller image; checks what can be checked
+cv::Mat wrap(const ip_image* img, const char* what) {
+    if (!img) throw std::invalid_argument(std::string(what) + " is NULL");
+    toPixelFormat(img->format);
+    if (!img->data) throw std::invalid_argument(std::string(what) + ".data is NULL");
+    if (img->width < 1 || img->height < 1) {
+        throw std::invalid_argument(std::string(what) + " is " + std::to_string(img->width) + "x" +
+                                    std::to_string(img->height));
+    }
+    if (img->stride < (size_t)img->width * channels(img->format)) {
+        throw std::invalid_argument(std::string(what) + ".stride is smaller than a row");
+    }
+    int type = img->format == IP_BGR8 ? CV_8UC3 : CV_8UC1;
+    return cv::Mat(img->height, img->width, type, img->data, img->stride);
+}
+
+bool overlaps(const ip_image* a, const ip_image* b) {
+    const char* a0 = (const char*)a->data;
+    const char* b0 = (const char*)b->data;
+    const char* a1 = a0 + (size_t)(a->height - 1) * a->stride + (size_t)a->width * channels(a->format);
+    const char* b1 = b0 + (size_t)(b->height - 1) * b->stride + (size_t)b->width * channels(b->format);
+    return a0 < b1 && b0 < a1;
+}
+
+// The context's chain for input format f (built on first use / format change)
+FilterGraph& graphFor(ip_context* ctx, PixelFormat f) {
+    if (!ctx->built || ctx->graphInput != f) {
+        try {
+            ctx->graph = buildGraph(ctx->args, f);
+        } catch (const std::runtime_error& e) {
+            throw std::invalid_argument(e.what()); // the chain doesn't take this format
+        }
+        ctx->graphInput = f;
+        ctx->built = true;
+    }
+    return ctx->graph;
+}
+
+// Run fn, turning exceptions into a status + message
+template <class Fn>
+ip_status guarded(std::string& error, Fn&& fn) {
+    try {
+        fn();
+        return IP_OK;
+    } catch (const std::invalid_argument& e) {
+        error = e.what();
+        return IP_ERROR_ARGUMENT;
+    } catch (const std::bad_alloc&) {
+        error = "out of memory";
+        return IP_ERROR_MEMORY;
+    } catch (const std::exception& e) {
+        error = e.what();
+        return IP_ERROR_FAILED;
+    } catch (...) {
+        error = "unknown error";
+        return IP_ERROR_FAILED;
+    }
+}
+
+} // namespace
+
+extern "C" {
+
+int ip_api_version(void) {
+    return IP_API_VERSION;
+}
+
+void ip_options_init(ip_options* opt) {
+    if (!opt) return;
+    opt->threads = 1;
+    opt->radius = 1;
+    opt->stages = nullptr;
+    opt->sobel_norm = nullptr;
+    opt->fused = 0;
+    opt->color = 0;
+}
+
+ip_status ip_create(const ip_options* opt, ip_context** out) {
+    if (!out) {
+        tlsError = "ip_create: out is NULL";
+        return IP_ERROR_ARGUMENT;
+    }
+    *out = nullptr;
+    ip_options defaults;
+    ip_options_init(&defaults);
+    if (!opt) opt = &defaults;
+
+    ip_context* ctx = nullptr;
+    ip_status st = guarded(tlsError, [&]() {
+        if (opt->threads < 0) throw std::invalid_argument("threads must be >= 0");
+        if (opt->radius < 1) throw std::invalid_argument("radius must be >= 1");
+        int threads = opt->threads > 0 ? opt->threads : (int)std::max(1u, std::thread::hardware_concurrency());
+
+        Args args;
+        args.mode = threads > 1 ? Mode::CPU_MT : Mode::CPU_SINGLE;
+        args.threads = threads;
+        args.radius = opt->radius;
+        if (opt->stages) args.stages = opt->stages;
+        args.fused = opt->fused != 0;
+        args.color = opt->color != 0;
+
+        // A bad norm or stage list fails here, not in the first ip_process.
+        // The chain only has to work for one input format ("blur,sobel" takes
+        // gray only); ip_process checks the format it actually gets.
+        try {
+            if (opt->sobel_norm) args.sobelNorm = parseSobelNorm(opt->sobel_norm);
+            try {
+                buildGraph(args, PixelFormat::BGR8);
+            } catch (const std::runtime_error&) {
+                buildGraph(args, PixelFormat::GRAY8);
+            }
+        } catch (const std::runtime_error& e) {
+            throw std::invalid_argument(e.what());
+        }
+
+        ctx = new ip_context;
+        ctx->args = args;
+        if (args.mode == Mode::CPU_MT) ctx->ws.ensureThreads(threads);
+    });
+    if (st != IP_OK) {
+        delete ctx;
+        return st;
+    }
+    *out = ctx;
+    return IP_OK;
+}
+
+void ip_destroy(ip_context* ctx) {
+    delete ctx;
+}
+
+ip_status ip_output_format(ip_context* ctx, ip_format in, ip_format* out) {
+    if (!ctx) {
+        tlsError = "ip_output_format: ctx is NULL";
+        return IP_ERROR_ARGUMENT;
+    }
+    return guarded(ctx->error, [&]() {
+        if (!out) throw std::invalid_argument("ip_output_format: out is NULL");
+        FilterGraph& g = graphFor(ctx, toPixelFormat(in));
+        *out = g.outputFormat() == PixelFormat::BGR8 ? IP_BGR8 : IP_GRAY8;
+    });
+}
+
+ip_status ip_process(ip_context* ctx, const ip_image* in, const ip_image* out) {
+    if (!ctx) {
+        tlsError = "ip_process: ctx is NULL";
+        return IP_ERROR_ARGUMENT;
+    }
+    return guarded(ctx->error, [&]() {
+        cv::Mat src = wrap(in, "in");
+        cv::Mat dst = wrap(out, "out");
+        if (out->width != in->width || out->height != in->height) {
+            throw std::invalid_argument("out must be the size of in");
+        }
+        if (overlaps(in, out)) throw std::invalid_argument("out overlaps in");
+
+        FilterGraph& g = graphFor(ctx, toPixelFormat(in->format));
+        if (dst.type() != (g.outputFormat() == PixelFormat::BGR8 ? CV_8UC3 : CV_8UC1)) {
+            throw std::invalid_argument(std::string("out must be ") + pixelFormatName(g.outputFormat()) +
+                                        " for this chain");
+        }
+        g.run(src, dst, ctx->args.mode == Mode::CPU_MT ? ctx->args.threads : 1, ctx->ws, nullptr);
+        if (dst.data != out->data) throw std::runtime_error("ip_process: chain did not write into out");
+    });
+}
+
+const char* ip_last_error(const ip_context* ctx) {
+    return ctx ? ctx->error.c_str() : tlsError.c_str();
+}
+
+ip_status ip_set_isa_limit(const char* isa) {
+    return guarded(tlsError, [&]() {
+        if (!isa) throw std::invalid_argument("ip_set_isa_limit: isa is NULL");
+        try {
+            setCpuIsaLimit(parseCpuIsa(isa));
+        } catch (const std::runtime_error& e) {
+            throw std::invalid_argument(e.what());
+        }
+    });
+}
+
+} // extern "C"
@@ -0,0 +1,239 @@
+#include "incremental.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+// Above this share of recomputed tiles, crops + halos cost more than
+// just running the whole frame
+const double kFullFrameFraction = 0.5;
+
+// Crops at most this many tile rows tall, so a big moving object is still
+// several tasks for the pool
+const int kMaxRectBlockRows = 4;
+
+} // namespace
+
+void IncrementalFilter::setup(const Args& args, const FrameBuffers& buf, int w, int h,
+                              CpuWorkspace& ws, PixelFormat input) {
+    if (args.incrementalBlock < 8) throw std::runtime_error("--block must be >= 8");
+    w_ = w;
+    h_ = h;
+    if (!buf.graph.local()) throw std::runtime_error("--incremental: the filter chain must be local (no canny)");
+    block_ = args.incrementalBlock;
+    halo_ = buf.graph.totalHalo();
+    bw_ = (w + block_ - 1) / block_;
+    bh_ = (h + block_ - 1) / block_;
+    elemSize_ = input == PixelFormat::GRAY8 ? 1 : 3;
+    rowBytes_ = (size_t)w * elemSize_;
+    havePrev_ = false;
+    changed_.assign((size_t)bw_ * bh_, 0);
+    recompute_.assign((size_t)bw_ * bh_, 0);
+
+    int nWorkers = (args.mode == Mode::CPU_MT) ? ws.ensureThreads(args.threads).size() : 1;
+    workers_.clear();
+    workers_.resize(nWorkers);
+    for (CropWorker& cw : workers_) cw.graph = buildGraph(args, input);
+}
+
+// changed_ = tiles whose bytes differ from prev_; those tiles are copied
+// into prev_ on the way, so prev_ becomes this frame without a full copy
+void IncrementalFilter::diff(const cv::Mat& frame, ThreadPool* pool) {
+    auto rows = [&](int by0, int by1, int) {
+        size_t tileBytes = (size_t)block_ * elemSize_;
+        for (int by = by0; by < by1; by++) {
+            int y0 = by * block_;
+            int y1 = std::min(h_, y0 + block_);
+            uint8_t* ch = &changed_[(size_t)by * bw_];
+            std::fill(ch, ch + bw_, 0);
+            for (int y = y0; y < y1; y++) {
+                const uint8_t* cur = frame.ptr<uint8_t>(y);
+                const uint8_t* old = prev_.ptr<uint8_t>(y);
+                for (int bx = 0; bx < bw_; bx++) {
+                    if (ch[bx]) continue;
+                    size_t off = (size_t)bx * tileBytes;
+                    size_t n = std::min(tileBytes, rowBytes_ - off);
+                    if (std::memcmp(cur + off, old + off, n) != 0) ch[bx] = 1;
+                }
+            }
+            for (int y = y0; y < y1; y++) {
+                const uint8_t* cur = frame.ptr<uint8_t>(y);
+                uint8_t* old = prev_.ptr<uint8_t>(y);
+                for (int bx = 0; bx < bw_; bx++) {
+                    if (!ch[bx]) continue;
+                    size_t off = (size_t)bx * tileBytes;
+                    std::memcpy(old + off, cur + off, std::min(tileBytes, rowBytes_ - off));
+                }
+            }
+        }
+    };
+    if (pool) pool->parallel_for(0, bh_, rows);
+    else rows(0, bh_, 0);
+}
+
+// recompute_ = changed_ grown by the halo, in tiles
+void IncrementalFilter::markRecompute() {
+    int reach = (halo_ + block_ - 1) / block_;
+    std::fill(recompute_.begin(), recompute_.end(), 0);
+    for (int by = 0; by < bh_; by++) {
+        for (int bx = 0; bx < bw_; bx++) {
+            if (!changed_[(size_t)by * bw_ + bx]) continue;
+            int ya = std::max(0, by - reach), yb = std::min(bh_ - 1, by + reach);
+            int xa = std::max(0, bx - reach), xb = std::min(bw_ - 1, bx + reach);
+            for (int yy = ya; yy <= yb; yy++) {
+                std::fill(&recompute_[(size_t)yy * bw_ + xa], &recompute_[(size_t)yy * bw_ + xb] + 1, 1);
+            }
+        }
+    }
+}
+
+// Horizontal runs of recompute tiles, stacked with the run of the same
+// span in the tile row above (up to kMaxRectBlockRows tall)
+void IncrementalFilter::buildRects() {
+    rects_.clear();
+    std::vector<int> open; // rects_ indices that end at the current tile row
+    std::vector<int> nextOpen;
+    for (int by = 0; by < bh_; by++) {
+        nextOpen.clear();
+        int y0 = by * block_;
+        int y1 = std::min(h_, y0 + block_);
+        for (int bx = 0; bx < bw_;) {
+            if (!recompute_[(size_t)by * bw_ + bx]) {
+                bx++;
+                continue;
+            }
+            int bx0 = bx;
+            while (bx < bw_ && recompute_[(size_t)by * bw_ + bx]) bx++;
+            int x0 = bx0 * block_;
+            int x1 = std::min(w_, bx * block_);
+
+            int grow = -1;
+            for (int i : open) {
+                const cv::Rect& r = rects_[i];
+                if (r.x == x0 && r.width == x1 - x0 && r.height < kMaxRectBlockRows * block_) {
+                    grow = i;
+                    break;
+                }
+            }
+            if (grow >= 0) {
+                rects_[grow].height += y1 - y0;
+            } else {
+                grow = (int)rects_.size();
+                rects_.push_back(cv::Rect(x0, y0, x1 - x0, y1 - y0));
+            }
+            nextOpen.push_back(grow);
+        }
+        open.swap(nextOpen);
+    }
+}
+
+void IncrementalFilter::process(const cv::Mat& frame, FrameBuffers& buf, CpuWorkspace& ws,
+                                const Args& args, StageTimes& t) {
+    if (frame.cols != w_ || frame.rows != h_ || frame.elemSize() != (size_t)elemSize_) {
+        throw std::runtime_error("IncrementalFilter: frame size/format changed mid-stream");
+    }
+    int threads = (args.mode == Mode::CPU_MT) ? args.threads : 1;
+    ThreadPool* pool = threads > 1 ? &ws.ensureThreads(threads) : nullptr;
+    uint64_t tiles = (uint64_t)bw_ * bh_;
+    stats_.frames++;
+    stats_.blocks += tiles;
+    stats_.framePixels += (uint64_t)w_ * h_;
+
+    // First frame: everything, and it becomes the reference
+    if (!havePrev_) {
+        frame.copyTo(prev_);
+        havePrev_ = true;
+        processFrame(frame, buf, ws, args, t);
+        stats_.fullFrames++;
+        stats_.changedBlocks += tiles;
+        stats_.recomputedBlocks += tiles;
+        stats_.computedPixels += (uint64_t)w_ * h_;
+        return;
+    }
+
+    uint64_t changed = 0, recompute = 0;
+    {
+        TraceSpan s("diff", "incremental");
+        diff(frame, pool);
+        markRecompute();
+        for (size_t i = 0; i < changed_.size(); i++) {
+            changed += changed_[i];
+            recompute += recompute_[i];
+        }
+        stats_.diff.add(s.end());
+    }
+    stats_.changedBlocks += changed;
+    stats_.recomputedBlocks += recompute;
+
+    t = StageTimes{};
+    t.count = buf.graph.size();
+    if (recompute == 0) return; // nothing moved: last output stands
+
+    if ((double)recompute > kFullFrameFraction * (double)tiles) {
+        processFrame(frame, buf, ws, args, t);
+        stats_.fullFrames++;
+        stats_.recomputedBlocks += tiles - recompute; // whole frame was recomputed
+        stats_.computedPixels += (uint64_t)w_ * h_;
+        return;
+    }
+
+    buildRects();
+    stats_.rects += rects_.size();
+    for (CropWorker& cw : workers_) cw.t = StageTimes{};
+
+    TraceSpan frameSpan("frame", "frame");
+    std::vector<uint64_t> pixels(workers_.size(), 0);
+    auto crops = [&](int i0, int i1, int tid) {
+        CropWorker& cw = workers_[tid];
+        for (int i = i0; i < i1; i++) {
+            const cv::Rect& r = rects_[i];
+            // Input crop = the rectangle grown by the halo, clamped to the frame
+            int ax = std::max(0, r.x - halo_), ay = std::max(0, r.y - halo_);
+            int bx = std::min(w_, r.x + r.width + halo_), by = std::min(h_, r.y + r.height + halo_);
+            cv::Mat in = frame(cv::Rect(ax, ay, bx - ax, by - ay));
+
+            // Crop output in this worker's buffer (no allocation once it is big enough)
+            size_t need = (size_t)(bx - ax) * (by - ay) * buf.edges.elemSize();
+            cw.out.ensure(cw.ws.arena(), need);
+            cv::Mat out(by - ay, bx - ax, buf.edges.type(), cw.out.data());
+
+            double ms[FilterGraph::kMaxStages] = {};
+            cw.graph.run(in, out, 1, cw.ws, ms);
+            for (int k = 0; k < cw.graph.size(); k++) cw.t.ms[k] += ms[k];
+            pixels[tid] += (uint64_t)(bx - ax) * (by - ay);
+
+            // Keep only the rectangle itself: its border rows/cols are exact
+            size_t rowBytes = (size_t)r.width * buf.edges.elemSize();
+            for (int y = r.y; y < r.y + r.height; y++) {
+                std::memcpy(buf.edges.ptr<uint8_t>(y) + (size_t)r.x * buf.edges.elemSize(),
+                            out.ptr<uint8_t>(y - ay) + (size_t)(r.x - ax) * buf.edges.elemSize(), rowBytes);
+            }
+        }
+    };
+    if (pool) pool->parallel_for(0, (int)rects_.size(), crops, 1);
+    else crops(0, (int)rects_.size(), 0);
+
+    for (size_t i = 0; i < workers_.size(); i++) {
+        t += workers_[i].t;
+        stats_.computedPixels += pixels[i];
+    }
+    t.count = buf.graph.size();
+}
+
+void printIncrementalStats(const IncrementalStats& s, int block) {
+    if (s.frames == 0) return;
+    auto share = [](uint64_t a, uint64_t b) { return b ? 100.0 * (double)a / (double)b : 0.0; };
+    std::cout << "  incremental: " << block << " px tiles, "
+              << share(s.blocks - s.recomputedBlocks, s.blocks) << "% skipped (input changed in "
+              << share(s.changedBlocks, s.blocks) << "%)\n";
+    std::cout << "    computed:  " << share(s.computedPixels, s.framePixels)
+              << "% of the pixels (halos included), " << s.fullFrames << " full frame(s), "
+              << s.rects << " crops\n";
+    if (s.diff.count()) {
+        std::cout << "    diff:      " << s.diff.mean() << " ms avg (p99 " << s.diff.percentile(0.99) << ")\n";
+    }
+}
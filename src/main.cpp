@@ -1,5 +1,10 @@
 #include "pipeline.hpp"
+#include "arena.hpp"
+#include "cpu_features.hpp"
+#include "thread_pool.hpp"
+#include <cstdio>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <stdexcept>
 
@@ -8,13 +13,76 @@ static void usage() {
     std::cout <<
     "Usage:\n"
     "  Image:\n"
-    "    ./pipeline --image <path> --mode <cpu-single|cpu-mt> --out <path> [--threads N] [--radius R]\n"
+    "    ./pipeline --image <path> --mode <cpu-single|cpu-mt> --out <path> [--threads N] [--radius R] [--fused]\n"
+    "  Huge image (memory-mapped, processed in row bands; P5/P6 or raw gray in, PGM or raw out):\n"
+    "    ./pipeline --image <in.pgm|in.ppm> --tiled [--tile-rows N] --mode <cpu-single|cpu-mt> --out <out.pgm>\n"
     "  Video:\n"
-    "    ./pipeline --video <path> --mode <cpu-single|cpu-mt> --out <path> [--threads N] [--radius R]\n"
+    "    ./pipeline --video <path> --mode <cpu-single|cpu-mt> --out <path> [--threads N] [--radius R] [--fused]\n"
+    "                 [--pipelined] [--queue-depth N] [--frames-in-flight N]\n"
+    "  Real-time video (file replayed as a live source, late frames dropped or degraded):\n"
+    "    ./pipeline --video <path> --realtime [--speed X] [--budget MS] [--overload drop|degrade|both]\n"
+    "                 [--fallback-radius R] --mode <cpu-single|cpu-mt> --out <path>\n"
+    "  Raw video (y4m / headerless gray frames; either side, '-' = stdin/stdout):\n"
+    "    ./pipeline --video <in.y4m|-> --mode <cpu-single|cpu-mt> --out <out.y4m|out.gray|-> [--in-format F]\n"
+    "                 [--out-format F] [--raw-size WxH]\n"
+    "  Batch (many images, --out is a directory):\n"
+    "    ./pipeline (--input-dir <dir> | --list <file.txt>) --mode <cpu-single|cpu-mt> --out <dir>\n"
+    "                 [--frames-in-flight N] [--io-threads N] [--queue-depth N]\n"
+    "\nOptions:\n"
+    "  --stages <list>  filter chain, e.g. gray,blur:2,sobel:l1 (default gray,blur,sobel;\n"
+    "                   blur defaults to --radius, sobel to --sobel-norm;\n"
+    "                   canny[:lo:hi] = Sobel + NMS + hysteresis, default 50:150)\n"
+    "  --fused   run gray+blur+sobel as one line-buffered pass (no intermediate frames)\n"
+    "  --color   keep colour: blur and edges on every channel (default chain planar,blur,sobel;\n"
+    "            planar/interleave stages also usable in --stages, e.g. planar,blur:3)\n"
+    "  --isa <scalar|ssse3|avx2|avx512>  cap the SIMD level (default: best the CPU supports)\n"
+    "  --grain N        cpu-mt: rows per work-stealing task (default: auto, 4 tasks per worker)\n"
+    "  --hugepages <off|thp|explicit>  back the buffer arena with transparent or hugetlb pages\n"
+    "                   (explicit needs vm.nr_hugepages, falls back to thp; default off)\n"
+    "  --prefault       touch every arena page at setup instead of during the first frame\n"
+    "  --sobel-norm <l1|l2|sq>  edge magnitude: |gx|+|gy|, sqrt(gx^2+gy^2) (default), (gx^2+gy^2)/256\n"
+    "  --trace <path>   write a Chrome trace-event JSON (frames, stages, pool chunks per thread)\n"
+    "  --pipelined      video: decode, filter and encode on separate threads\n"
+    "  --incremental    video: only recompute tiles that changed since the last frame (exact)\n"
+    "  --block N        tile size for --incremental, in pixels (default 32)\n"
+    "  --realtime       video: pace input at the source frame rate, per-frame latency budget\n"
+    "  --speed X        realtime: source runs X times its frame rate (default 1)\n"
+    "  --budget MS      realtime: capture -> written budget per frame (default one frame period)\n"
+    "  --overload <drop|degrade|both>  realtime: skip late frames, fall back to a cheaper blur,\n"
+    "                   or degrade first and drop if still late (default both)\n"
+    "  --fallback-radius R  realtime: blur radius of the degraded chain (default 1)\n"
+    "  --queue-depth N  video: frames buffered between pipelined stages (default 4)\n"
+    "  --frames-in-flight N  video/batch: filter N frames at once, one per worker (mix with --threads)\n"
+    "  --in-format <y4m|gray>   raw video input (default: from the extension, .y4m/.gray/.y/.raw)\n"
+    "  --out-format <y4m|gray>  raw video output (edges as Y4M Cmono or bare bytes)\n"
+    "  --raw-size WxH   frame size of raw gray input\n"
+    "  --blur-radii <list>  image: blur at every radius (e.g. 1,4,16) from one summed-area table;\n"
+    "                   writes <out>_r<R>.<ext> per radius\n"
+    "  --roi x,y,w,h    image/video: filter only this rectangle (+ the chain's halo), output its size\n"
+    "  --scale N        image/video: filter at 1/N, N = 2, 4, 8, 16 (2x2 means fused into gray)\n"
+    "  --pyramid-levels L  image/video: also 1/2N, 1/4N, ... (L levels, <out>_l<k>.<ext> each)\n"
+    "  --edge-format <bitmap|rle|sparse>  image/video: write the pixels with magnitude >= --threshold\n"
+    "                   as a compact .edg container (1-bit rows, run lengths, or x,y,mag records)\n"
+    "  --threshold T    edge threshold for --edge-format, 1..255 (default 64)\n"
+    "  --tiled          image: out-of-core banded processing, RSS bounded by band size\n"
+    "  --tile-rows N    rows per band for --tiled (default: ~1M pixels)\n"
+    "  --input-dir <dir>  batch: every image file in dir (not recursive)\n"
+    "  --list <file>    batch: one image path per line ('#' comments allowed)\n"
+    "  --io-threads N   batch: decoder threads and encoder threads, each (default 2)\n"
+    "  --autotune       time --isa/--fused/--threads/--grain/--tile-rows variants on a synthetic frame of\n"
+    "                   the input's size, run with the fastest and save it to the machine's profile\n"
+    "                   (flags given on the command line are kept as they are)\n"
+    "  --tune-sizes WxH[,WxH...]  --autotune without --image/--video: tune these sizes offline\n"
+    "  --profile <path> tuning profile (default $XDG_CACHE_HOME/image_pipeline/<host>.profile);\n"
+    "                   image and serial video runs apply the entry for their size\n"
+    "  --no-profile     neither read nor write the profile\n"
     "\nExamples:\n"
     "  ./pipeline --image data/input.jpg --mode cpu-single --radius 1 --out output/out_edges.png\n"
     "  ./pipeline --image data/input.jpg --mode cpu-mt --threads 8 --radius 2 --out output/out_edges_mt.png\n"
-    "  ./pipeline --video data/input.mp4 --mode cpu-mt --threads 8 --radius 1 --out output/out_edges_mt.mp4\n";
+    "  ./pipeline --video data/input.mp4 --mode cpu-mt --threads 8 --radius 1 --out output/out_edges_mt.mp4\n"
+    "  ./pipeline --video data/input.mp4 --mode cpu-mt --frames-in-flight 4 --threads 4 --out output/out_edges_ff.mp4\n"
+    "  ./pipeline --autotune --tune-sizes 1920x1080,3840x2160 --mode cpu-mt\n"
+    "  ./pipeline --input-dir data --mode cpu-single --frames-in-flight 8 --io-threads 4 --out output/batch\n";
 }
 
 // Convert string -> Mode enum
@@ -33,6 +101,7 @@ int main(int argc, char** argv) {
 
     Args args;
     std::string modeStr;
+    ArenaOptions arenaOpts;
 
     // Simple flag parsing
     for (int i = 1; i < argc; i++) {
@@ -46,10 +115,89 @@ int main(int argc, char** argv) {
 
         if (a == "--image")   args.imagePath = needValue(a);
         else if (a == "--video")  args.videoPath = needValue(a);
+        else if (a == "--input-dir") args.inputDir = needValue(a);
+        else if (a == "--list")   args.listPath = needValue(a);
+        else if (a == "--in-format") args.inFormat = needValue(a);
+        else if (a == "--out-format") args.outFormat = needValue(a);
+        else if (a == "--raw-size") {
+            std::string v = needValue(a);
+            if (std::sscanf(v.c_str(), "%dx%d", &args.rawWidth, &args.rawHeight) != 2) {
+                throw std::runtime_error("--raw-size expects WxH, got " + v);
+            }
+        }
+        else if (a == "--roi") {
+            std::string v = needValue(a);
+            if (std::sscanf(v.c_str(), "%d,%d,%d,%d", &args.roiX, &args.roiY, &args.roiW, &args.roiH) != 4 ||
+                args.roiW < 1 || args.roiH < 1) {
+                throw std::runtime_error("--roi expects x,y,w,h, got " + v);
+            }
+        }
+        else if (a == "--scale")   args.scale = std::stoi(needValue(a));
+        else if (a == "--pyramid-levels") args.pyramidLevels = std::stoi(needValue(a));
+        else if (a == "--blur-radii") {
+            std::stringstream ss(needValue(a));
+            std::string r;
+            while (std::getline(ss, r, ',')) {
+                if (!r.empty()) args.blurRadii.push_back(std::stoi(r));
+            }
+        }
+        else if (a == "--edge-format") args.edgeFormat = needValue(a);
+        else if (a == "--threshold") args.edgeThreshold = std::stoi(needValue(a));
+        else if (a == "--tiled")   args.tiled = true;
+        else if (a == "--tile-rows") {
+            args.tileRows = std::stoi(needValue(a));
+            args.userTileRows = true;
+        }
+        else if (a == "--io-threads") args.ioThreads = std::stoi(needValue(a));
         else if (a == "--out")    args.outPath = needValue(a);
         else if (a == "--mode")   modeStr = needValue(a);
-        else if (a == "--threads") args.threads = std::stoi(needValue(a));
+        else if (a == "--threads") {
+            args.threads = std::stoi(needValue(a));
+            args.userThreads = true;
+        }
         else if (a == "--radius")  args.radius = std::stoi(needValue(a));
+        else if (a == "--fused") {
+            args.fused = true;
+            args.userFused = true;
+        }
+        else if (a == "--color")   args.color = true;
+        else if (a == "--stages")  args.stages = needValue(a);
+        else if (a == "--pipelined") args.pipelined = true;
+        else if (a == "--incremental") args.incremental = true;
+        else if (a == "--block")   args.incrementalBlock = std::stoi(needValue(a));
+        else if (a == "--realtime") args.realtime = true;
+        else if (a == "--speed")   args.rtSpeed = std::stod(needValue(a));
+        else if (a == "--budget")  args.rtBudgetMs = std::stod(needValue(a));
+        else if (a == "--overload") args.rtOverload = needValue(a);
+        else if (a == "--fallback-radius") args.rtFallbackRadius = std::stoi(needValue(a));
+        else if (a == "--queue-depth") args.queueDepth = std::stoi(needValue(a));
+        else if (a == "--frames-in-flight") args.framesInFlight = std::stoi(needValue(a));
+        else if (a == "--sobel-norm") args.sobelNorm = parseSobelNorm(needValue(a));
+        else if (a == "--trace")   args.tracePath = needValue(a);
+        else if (a == "--isa") {
+            setCpuIsaLimit(parseCpuIsa(needValue(a)));
+            args.userIsa = true;
+        }
+        else if (a == "--grain") {
+            ThreadPool::setDefaultGrain(std::stoi(needValue(a)));
+            args.userGrain = true;
+        }
+        else if (a == "--autotune") args.autotune = true;
+        else if (a == "--tune-sizes") {
+            std::stringstream ss(needValue(a));
+            std::string sz;
+            while (std::getline(ss, sz, ',')) {
+                int w = 0, h = 0;
+                if (std::sscanf(sz.c_str(), "%dx%d", &w, &h) != 2 || w < 1 || h < 1) {
+                    throw std::runtime_error("--tune-sizes expects WxH[,WxH...], got " + sz);
+                }
+                args.tuneSizes.push_back({w, h});
+            }
+        }
+        else if (a == "--profile") args.profilePath = needValue(a);
+        else if (a == "--no-profile") args.noProfile = true;
+        else if (a == "--hugepages") arenaOpts.hugePages = parseHugePages(needValue(a));
+        else if (a == "--prefault") arenaOpts.prefault = true;
         else {
             std::cerr << "Unknown flag: " << a << "\n";
             usage();
@@ -57,14 +205,18 @@ int main(int argc, char** argv) {
         }
     }
 
-    // Validate required inputs
-    if (args.outPath.empty()) {
+    Arena::setDefaultOptions(arenaOpts);
+
+    // Validate required inputs (offline --autotune has neither input nor output)
+    bool batch = !args.inputDir.empty() || !args.listPath.empty();
+    bool offlineTune = args.autotune && args.imagePath.empty() && args.videoPath.empty() && !batch;
+    if (args.outPath.empty() && !offlineTune) {
         std::cerr << "Missing --out\n";
         usage();
         return 1;
     }
-    if (args.imagePath.empty() && args.videoPath.empty()) {
-        std::cerr << "Missing --image or --video\n";
+    if (args.imagePath.empty() && args.videoPath.empty() && !batch && !offlineTune) {
+        std::cerr << "Missing --image, --video, --input-dir or --list\n";
         usage();
         return 1;
     }
@@ -82,7 +234,19 @@ int main(int argc, char** argv) {
         std::cerr << "--radius must be >= 1\n";
         return 1;
     }
+    for (int r : args.blurRadii) {
+        if (r < 1) {
+            std::cerr << "--blur-radii values must be >= 1\n";
+            return 1;
+        }
+    }
     if (args.threads < 1) args.threads = 1;
+    if (args.framesInFlight < 1) args.framesInFlight = 1;
+    if (args.ioThreads < 1) args.ioThreads = 1;
+    if (args.queueDepth < 1) {
+        std::cerr << "--queue-depth must be >= 1\n";
+        return 1;
+    }
 
     try {
         Pipeline p;
@@ -1,38 +1,136 @@
 #include "pipeline.hpp"
-#include "filters_cpu.hpp"
+#include "frame_ops.hpp"
 #include "workspace.hpp"
 #include "utils.hpp"
+#include "trace.hpp"
+#include "raw_io.hpp"
+#include "incremental.hpp"
+#include "edge_codec.hpp"
+#include "autotune.hpp"
 
 #include <opencv2/opencv.hpp>
 #include <iostream>
 #include <stdexcept>
 
-// Helper: convert Mode to string for printing
-static const char* modeName(Mode m) {
-    switch (m) {
-        case Mode::CPU_SINGLE: return "cpu-single";
-        case Mode::CPU_MT:     return "cpu-mt";
-        case Mode::GPU:        return "gpu";
+namespace {
+
+// --edge-format: the edge map is thresholded and packed into a .edg
+// container (edge_codec.hpp) instead of being written as an image / mp4
+struct EdgeOutput {
+    EdgeEncoder enc;
+    EdgeFileWriter file;
+    uint64_t edgePixels = 0;
+    uint64_t pixels = 0;
+
+    void open(const Args& args, const FrameBuffers& buf, int w, int h) {
+        if (buf.graph.outputFormat() != PixelFormat::GRAY8) {
+            throw std::runtime_error("--edge-format needs a chain that ends in a gray edge map (no --color)");
+        }
+        enc.setup(parseEdgeFormat(args.edgeFormat), w, h, args.edgeThreshold);
+        file.open(args.outPath, enc);
     }
-    return "unknown";
-}
 
-void Pipeline::run(const Args& args) {
-    // Decide which path is used
-    if (!args.imagePath.empty()) {
-        runImage(args);
-        return;
+    void write(const cv::Mat& edges, const Args& args, CpuWorkspace& ws) {
+        enc.encode(edges, (args.mode == Mode::CPU_MT) ? args.threads : 1, ws);
+        file.write(enc);
+        edgePixels += enc.edgeCount();
+        pixels += (uint64_t)enc.width() * enc.height();
     }
-    if (!args.videoPath.empty()) {
-        runVideo(args);
+
+    // "output: rle >= 64, 3.2% edge px, 1234 KB (0.04 B/px, 4.9% of 8-bit)"
+    void print() const {
+        double px = pixels ? (double)pixels : 1.0;
+        double bytes = (double)file.bytesWritten();
+        std::cout << "  output:    " << edgeFormatName(enc.format()) << " >= " << enc.threshold() << ", "
+                  << 100.0 * (double)edgePixels / px << "% edge px, " << file.bytesWritten() / 1024 << " KB ("
+                  << bytes / px << " B/px, " << 100.0 * bytes / px << "% of 8-bit)\n";
+    }
+};
+
+} // namespace
+
+void Pipeline::run(const Args& cmdArgs) {
+    Args args = cmdArgs; // the profile may fill in threads / --fused / --tile-rows
+    bool batch = !args.inputDir.empty() || !args.listPath.empty();
+    if (args.autotune && args.imagePath.empty() && args.videoPath.empty() && !batch) {
+        tuneOffline(args);
         return;
     }
-    throw std::runtime_error("You must provide --image or --video");
+    if (args.imagePath.empty() && args.videoPath.empty() && !batch) {
+        throw std::runtime_error("You must provide --image, --video, --input-dir or --list");
+    }
+    if (!args.tracePath.empty()) traceEnable();
+
+    RawFormat raw;
+    bool rawVideo = !args.videoPath.empty() &&
+                    (resolveRawFormat(args.inFormat, args.videoPath, raw) ||
+                     resolveRawFormat(args.outFormat, args.outPath, raw));
+
+    // Frames going to stdout: every report goes to stderr instead
+    struct CoutToCerr {
+        std::streambuf* saved = nullptr;
+        explicit CoutToCerr(bool on) { if (on) saved = std::cout.rdbuf(std::cerr.rdbuf()); }
+        ~CoutToCerr() { if (saved) std::cout.rdbuf(saved); }
+    } redirect((rawVideo || !args.edgeFormat.empty()) && args.outPath == "-");
+
+    if (args.incremental && (args.videoPath.empty() || args.pipelined || args.framesInFlight > 1)) {
+        throw std::runtime_error("--incremental needs a video on the serial path (no --pipelined / --frames-in-flight)");
+    }
+
+    if (args.realtime && (args.videoPath.empty() || rawVideo || args.pipelined ||
+                          args.framesInFlight > 1 || args.incremental)) {
+        throw std::runtime_error("--realtime needs a container video (no raw I/O, --pipelined, "
+                                 "--frames-in-flight or --incremental)");
+    }
+
+    bool region = args.roiW > 0 || args.scale != 1 || args.pyramidLevels != 1;
+    if (region && (batch || args.tiled || !args.blurRadii.empty() || rawVideo || args.pipelined ||
+                   args.framesInFlight > 1 || args.incremental || args.realtime)) {
+        throw std::runtime_error("--roi/--scale/--pyramid-levels work on one image or a serial container video");
+    }
+
+    if (!args.edgeFormat.empty()) {
+        parseEdgeFormat(args.edgeFormat); // fail before any work on a typo
+        if (batch || args.tiled || !args.blurRadii.empty() || region || rawVideo || args.pipelined ||
+            args.framesInFlight > 1 || args.realtime) {
+            throw std::runtime_error("--edge-format works on one image or a serial container video");
+        }
+    }
+
+    // Tuned settings for this machine and frame size (--autotune / profile)
+    configureRun(args, image_);
+
+    // Decide which path is used
+    if (batch) runBatch(args);
+    else if (!args.imagePath.empty() && args.tiled) runImageTiled(args);
+    else if (!args.imagePath.empty() && !args.blurRadii.empty()) runImageMultiBlur(args);
+    else if (!args.imagePath.empty() && region) runImageRegion(args);
+    else if (!args.imagePath.empty()) runImage(args);
+    else if (rawVideo) runVideoRaw(args);
+    else if (region) runVideoRegion(args);
+    else if (args.realtime) runVideoRealtime(args);
+    else if (args.framesInFlight > 1) runVideoFrameParallel(args);
+    else if (args.pipelined) runVideoPipelined(args);
+    else runVideo(args);
+
+    // Every thread that recorded spans has been joined by now
+    if (!args.tracePath.empty()) {
+        uint64_t dropped = traceWriteChrome(args.tracePath);
+        std::cout << "  trace:     " << args.tracePath;
+        if (dropped) std::cout << " (" << dropped << " spans dropped, buffers full)";
+        std::cout << "\n";
+    }
+}
+
+cv::Mat Pipeline::loadImage(const Args& args) {
+    cv::Mat bgr = image_.empty() ? cv::imread(args.imagePath, cv::IMREAD_COLOR) : image_;
+    image_.release();
+    return bgr;
 }
 
 void Pipeline::runImage(const Args& args) {
     // 1) Load image (OpenCV only for IO)
-    cv::Mat bgr = cv::imread(args.imagePath, cv::IMREAD_COLOR);
+    cv::Mat bgr = loadImage(args);
     if (bgr.empty()) throw std::runtime_error("Failed to load image: " + args.imagePath);
 
     if (args.mode == Mode::GPU) {
@@ -40,133 +138,118 @@ void Pipeline::runImage(const Args& args) {
         throw std::runtime_error("GPU mode not available on this machine (CUDA requires NVIDIA).");
     }
 
-    cv::Mat gray, blurred, edges;
     CpuWorkspace ws;
-    ws.ensureSize(bgr.cols, bgr.rows);
+    if (args.mode == Mode::CPU_MT) ws.ensureThreads(args.threads); // spawn workers before timing
+    FrameBuffers buf;
+    buf.setup(args, bgr.cols, bgr.rows, ws);
 
     Timer total;
 
-    // --- Stage 1: Grayscale ---
-    Timer t1;
-    if (args.mode == Mode::CPU_MT) {
-        grayscale_cpu_mt(bgr, gray, args.threads);
-    } else {
-        grayscale_cpu(bgr, gray, 1);
-    }
-    double msGray = t1.ms();
-
-    // --- Stage 2: Blur (fast + reusable workspace) ---
-    Timer t2;
-    if (args.mode == Mode::CPU_MT) {
-        box_blur_cpu_fast_mt_ws(gray, blurred, args.radius, args.threads, ws);
-    } else {
-        box_blur_cpu_fast(gray, blurred, args.radius, 1);
-    }
-    double msBlur = t2.ms();
-
-    // --- Stage 3: Sobel ---
-    Timer t3;
-    if (args.mode == Mode::CPU_MT) {
-        sobel_cpu_mt(blurred, edges, args.threads);
-    } else {
-        sobel_cpu(blurred, edges, 1);
-    }
-    double msSobel = t3.ms();
-
-    // 2) Save output (OpenCV only for IO)
-    if (!cv::imwrite(args.outPath, edges)) {
+    // --- The filter graph (gray -> blur -> sobel by default) ---
+    StageTimes t;
+    processFrame(bgr, buf, ws, args, t);
+
+    // 2) Save output (OpenCV only for IO, or the compact edge container)
+    EdgeOutput edgeOut;
+    Timer encode;
+    if (!args.edgeFormat.empty()) {
+        edgeOut.open(args, buf, bgr.cols, bgr.rows);
+        edgeOut.write(buf.edges, args, ws);
+        edgeOut.file.close();
+    } else if (!cv::imwrite(args.outPath, buf.edges)) {
         throw std::runtime_error("Failed to write output: " + args.outPath);
     }
+    double encodeMs = encode.ms();
 
     // 3) Print timing summary
-    std::cout << "[IMAGE] mode=" << modeName(args.mode)
-              << " size=" << bgr.cols << "x" << bgr.rows
-              << " radius=" << args.radius
-              << " threads=" << args.threads << "\n";
-    std::cout << "  grayscale: " << msGray  << " ms\n";
-    std::cout << "  blur:      " << msBlur  << " ms\n";
-    std::cout << "  sobel:     " << msSobel << " ms\n";
+    printRunHeader("IMAGE", bgr.cols, bgr.rows, args);
+    printGraphPlan(buf.graph);
+    for (int i = 0; i < t.count; i++) {
+        std::cout << "  " << buf.graph.stage(i).label() << ": " << t.ms[i] << " ms\n";
+    }
+    std::cout << "  encode:    " << encodeMs << " ms\n";
+    if (!args.edgeFormat.empty()) edgeOut.print();
     std::cout << "  total:     " << total.ms() << " ms\n";
+    printPoolStats(ws);
 }
 
 void Pipeline::runVideo(const Args& args) {
-    cv::VideoCapture cap(args.videoPath);
-    if (!cap.isOpened()) throw std::runtime_error("Failed to open video: " + args.videoPath);
-
-    if (args.mode == Mode::GPU) {
-        throw std::runtime_error("GPU mode not available on this machine (CUDA requires NVIDIA).");
-    }
-
-    int w = (int)cap.get(cv::CAP_PROP_FRAME_WIDTH);
-    int h = (int)cap.get(cv::CAP_PROP_FRAME_HEIGHT);
-    double fpsIn = cap.get(cv::CAP_PROP_FPS);
-    if (fpsIn <= 0) fpsIn = 30.0;
-
-    // Output writer (expects BGR frames)
+    cv::VideoCapture cap;
     cv::VideoWriter writer;
-    int fourcc = cv::VideoWriter::fourcc('m','p','4','v');
-    writer.open(args.outPath, fourcc, fpsIn, cv::Size(w, h), true);
-    if (!writer.isOpened()) throw std::runtime_error("Failed to open VideoWriter: " + args.outPath);
+    int w = 0, h = 0;
+    double fpsIn = 0.0;
+    bool compact = !args.edgeFormat.empty();
+    if (compact) openVideoInput(args, cap, w, h, fpsIn);
+    else openVideoIO(args, cap, writer, w, h, fpsIn);
 
     // Pre-allocate reusable buffers (VERY IMPORTANT)
     cv::Mat frame;
-    cv::Mat gray(h, w, CV_8UC1);
-    cv::Mat blurred(h, w, CV_8UC1);
-    cv::Mat edges(h, w, CV_8UC1);
-    cv::Mat edgesBgr(h, w, CV_8UC3);
 
     CpuWorkspace ws;
-    ws.ensureSize(w, h);
-
-    // We will compute average stage times across all frames
-    double sumGray = 0.0, sumBlur = 0.0, sumSobel = 0.0;
+    if (args.mode == Mode::CPU_MT) ws.ensureThreads(args.threads); // threads live for the whole video
+    FrameBuffers buf;
+    buf.setup(args, w, h, ws);
+    cv::Mat edgesBgr; // the writer's 3-channel copy, in the arena like the rest
+    if (!compact) createFrame(edgesBgr, PixelFormat::BGR8, w, h, ws);
+    IncrementalFilter inc;
+    if (args.incremental) inc.setup(args, buf, w, h, ws);
+    EdgeOutput edgeOut;
+    if (compact) edgeOut.open(args, buf, w, h);
+
+    // Per-stage averages + tail percentiles across all frames
+    StageStats stats;
     int frames = 0;
 
+    traceNameThread("main");
     Timer total;
 
     while (true) {
-        if (!cap.read(frame)) break;
+        Timer age; // decode -> written
+
+        {
+            TraceSpan s("decode", "io");
+            bool ok = cap.read(frame);
+            double ms = s.end();
+            if (!ok) break;
+            stats.decode.add(ms);
+        }
+        traceSetFrame(frames);
         frames++;
 
-        // Stage 1: grayscale
-        Timer t1;
-        if (args.mode == Mode::CPU_MT) grayscale_cpu_mt(frame, gray, args.threads);
-        else grayscale_cpu(frame, gray, 1);
-        sumGray += t1.ms();
-
-        // Stage 2: blur
-        Timer t2;
-        if (args.mode == Mode::CPU_MT) box_blur_cpu_fast_mt_ws(gray, blurred, args.radius, args.threads, ws);
-        else box_blur_cpu_fast(gray, blurred, args.radius, 1);
-        sumBlur += t2.ms();
-
-        // Stage 3: sobel
-        Timer t3;
-        if (args.mode == Mode::CPU_MT) sobel_cpu_mt(blurred, edges, args.threads);
-        else sobel_cpu(blurred, edges, 1);
-        sumSobel += t3.ms();
-
-        // Convert edges (1 channel) -> BGR so writer accepts it
-        cv::cvtColor(edges, edgesBgr, cv::COLOR_GRAY2BGR);
-        writer.write(edgesBgr);
+        // Stages 1-3
+        StageTimes t;
+        if (args.incremental) inc.process(frame, buf, ws, args, t);
+        else processFrame(frame, buf, ws, args, t);
+        stats.add(t);
+
+        // Convert edges (1 channel) -> BGR so writer accepts it (--color: already BGR),
+        // or threshold + pack them (--edge-format)
+        {
+            TraceSpan s("encode", "io");
+            if (compact) edgeOut.write(buf.edges, args, ws);
+            else writer.write(writerFrame(buf.edges, edgesBgr));
+            stats.encode.add(s.end());
+        }
+        stats.latency.add(age.ms());
 
         // Print occasional progress
         if (frames % 60 == 0) {
             std::cout << "frame " << frames << " processed\n";
         }
     }
+    traceSetFrame(-1);
+    if (compact) edgeOut.file.close(); // reports a failed flush
 
     double totalMs = total.ms();
     double fpsOut = (totalMs > 0) ? (frames / (totalMs / 1000.0)) : 0.0;
 
-    std::cout << "[VIDEO] mode=" << modeName(args.mode)
-              << " size=" << w << "x" << h
-              << " radius=" << args.radius
-              << " threads=" << args.threads << "\n";
+    printRunHeader("VIDEO", w, h, args);
+    printGraphPlan(buf.graph);
     std::cout << "  frames:    " << frames << "\n";
-    std::cout << "  avg gray:  " << (frames ? sumGray / frames : 0.0) << " ms\n";
-    std::cout << "  avg blur:  " << (frames ? sumBlur / frames : 0.0) << " ms\n";
-    std::cout << "  avg sobel: " << (frames ? sumSobel / frames : 0.0) << " ms\n";
+    printStageStats(stats, buf.graph);
     std::cout << "  total:     " << totalMs << " ms\n";
     std::cout << "  avg FPS:   " << fpsOut << "\n";
+    if (compact) edgeOut.print();
+    if (args.incremental) printIncrementalStats(inc.stats(), args.incrementalBlock);
+    printPoolStats(ws);
 }
@@ -0,0 +1,383 @@
+#include "pipeline.hpp"
+#include "frame_ops.hpp"
+#include "bounded_queue.hpp"
+#include "utils.hpp"
+#include "trace.hpp"
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+Batch mode: many images in one process.
+
+Running ./pipeline once per file pays process startup, OpenCV init,
+thread creation and workspace allocation for every image, and reads,
+filters and writes strictly one after the other. Here:
+
+  decoder xD :  freeQ -> read file + imdecode -> decodedQ
+  filter  xN :  decodedQ -> processFrame -> encodeQ
+  encoder xE :  encodeQ -> imencode + write file -> freeQ
+
+so disk, codecs and filter cores are all busy at once (D = E = --io-threads,
+N = --frames-in-flight, each with --threads pool workers in cpu-mt).
+
+Images live in a fixed set of slots that cycle through the queues; the
+file bytes, decoded frame, edges and encoded bytes of a slot are reused
+for the next image, so same-sized images allocate nothing. Each filter
+worker keeps its own CpuWorkspace and graph plan across images; the plan
+is only redone when the size changes.
+
+Output order doesn't matter here (one file per image), so there is no
+reorder buffer. A file that fails to load or save is reported and
+skipped; it does not stop the batch.
+*/
+
+namespace {
+
+struct ImageSlot {
+    int index = -1;                 // position in the file list
+    std::vector<uint8_t> fileBytes; // compressed input
+    cv::Mat bgr;                    // decoded
+    cv::Mat edges;                  // filter output
+    std::vector<uint8_t> encoded;   // compressed output
+    Timer age;                      // started before the file is read
+};
+
+// Everything one filter worker owns
+struct BatchWorker {
+    CpuWorkspace ws;
+    FrameBuffers buf;
+    StageStats stats;
+};
+
+// Per decoder/encoder thread (merged at the end, no sharing while running)
+struct IoCounters {
+    StageStats stats;
+    uint64_t bytes = 0;
+    int failed = 0;
+};
+
+bool isImageFile(const std::filesystem::path& p) {
+    std::string ext = p.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    static const char* known[] = {".jpg", ".jpeg", ".png", ".bmp", ".tif", ".tiff",
+                                  ".webp", ".pgm", ".ppm", ".pnm"};
+    for (const char* k : known) {
+        if (ext == k) return true;
+    }
+    return false;
+}
+
+// --input-dir: every image file directly inside dir (not recursive), sorted
+// --list: one path per line, blank lines and '#' comments skipped
+std::vector<std::string> collectInputs(const Args& args) {
+    std::vector<std::string> files;
+    if (!args.inputDir.empty()) {
+        namespace fs = std::filesystem;
+        if (!fs::is_directory(args.inputDir)) {
+            throw std::runtime_error("Not a directory: " + args.inputDir);
+        }
+        for (const fs::directory_entry& e : fs::directory_iterator(args.inputDir)) {
+            if (e.is_regular_file() && isImageFile(e.path())) files.push_back(e.path().string());
+        }
+        std::sort(files.begin(), files.end());
+    }
+    if (!args.listPath.empty()) {
+        std::ifstream in(args.listPath);
+        if (!in) throw std::runtime_error("Failed to open list: " + args.listPath);
+        std::string line;
+        while (std::getline(in, line)) {
+            while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) line.pop_back();
+            if (line.empty() || line[0] == '#') continue;
+            files.push_back(line);
+        }
+    }
+    return files;
+}
+
+// <out dir>/<name>.png per input, all distinct: the name is the input's
+// stem ("x"), or its file name ("x.ppm") if another input has the same
+// stem. Names still shared after that (--list entries from different
+// directories) get "_<n>", the first n that no other output uses.
+// Compared case-insensitively (X.png and x.png are one file on some
+// filesystems). Never two encoders writing one file.
+std::vector<std::string> outputPaths(const std::string& outDir, const std::vector<std::string>& files) {
+    namespace fs = std::filesystem;
+    auto key = [](std::string s) {
+        std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+        return s;
+    };
+    auto counts = [&](const std::vector<std::string>& names) {
+        std::map<std::string, int> n;
+        for (const std::string& s : names) n[key(s)]++;
+        return n;
+    };
+
+    std::vector<std::string> names;
+    for (const std::string& f : files) names.push_back(fs::path(f).stem().string());
+    std::map<std::string, int> n = counts(names);
+    for (size_t i = 0; i < files.size(); i++) {
+        if (n[key(names[i])] > 1) names[i] = fs::path(files[i]).filename().string();
+    }
+
+    // Unique names are kept as they are; the rest are numbered around them
+    n = counts(names);
+    std::set<std::string> taken;
+    for (const std::string& name : names) {
+        if (n[key(name)] == 1) taken.insert(key(name));
+    }
+    for (size_t i = 0; i < files.size(); i++) {
+        if (n[key(names[i])] == 1) continue;
+        std::string name = names[i];
+        for (int k = 1; taken.count(key(name)); k++) name = names[i] + "_" + std::to_string(k);
+        taken.insert(key(name));
+        names[i] = name;
+    }
+
+    std::vector<std::string> paths;
+    for (const std::string& name : names) paths.push_back((fs::path(outDir) / name).string() + ".png");
+    return paths;
+}
+
+// Read a whole file into buf (reusing its capacity)
+bool readFile(const std::string& path, std::vector<uint8_t>& buf) {
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+    std::fseek(f, 0, SEEK_END);
+    long n = std::ftell(f);
+    std::fseek(f, 0, SEEK_SET);
+    bool ok = n > 0;
+    if (ok) {
+        buf.resize((size_t)n);
+        ok = std::fread(buf.data(), 1, buf.size(), f) == buf.size();
+    }
+    std::fclose(f);
+    return ok;
+}
+
+bool writeFile(const std::string& path, const std::vector<uint8_t>& buf) {
+    std::FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) return false;
+    bool ok = std::fwrite(buf.data(), 1, buf.size(), f) == buf.size();
+    return std::fclose(f) == 0 && ok;
+}
+
+} // namespace
+
+void Pipeline::runBatch(const Args& args) {
+    if (args.mode == Mode::GPU) {
+        throw std::runtime_error("GPU mode not available on this machine (CUDA requires NVIDIA).");
+    }
+
+    std::vector<std::string> files = collectInputs(args);
+    if (files.empty()) throw std::runtime_error("Batch: no input images found");
+    std::vector<std::string> outPaths = outputPaths(args.outPath, files);
+    std::filesystem::create_directories(args.outPath);
+
+    bool mt = (args.mode == Mode::CPU_MT);
+    int nWorkers = std::max(1, args.framesInFlight);
+    int nIo = std::max(1, args.ioThreads);
+    int depth = std::max(1, args.queueDepth);
+
+    // One slot in the hands of every thread, plus what the queues can hold
+    int nSlots = 2 * nIo + nWorkers + 2 * depth;
+    std::vector<ImageSlot> slots(nSlots);
+
+    // Filter workers: graph built and threads spawned before timing.
+    // Planning waits for the first image (sizes differ per file).
+    std::vector<BatchWorker> workers(nWorkers);
+    for (BatchWorker& bw : workers) {
+        bw.buf.graph = buildGraph(args);
+        if (mt) bw.ws.ensureThreads(args.threads);
+    }
+    std::vector<IoCounters> decoders(nIo), encoders(nIo);
+
+    BoundedQueue<int> freeQ(nSlots);
+    BoundedQueue<int> decodedQ(depth);
+    BoundedQueue<int> encodeQ(depth);
+    for (int i = 0; i < nSlots; i++) freeQ.push(i);
+
+    std::atomic<int> nextFile{0};
+    std::mutex logMutex;
+    auto reportFailure = [&](const char* what, const std::string& path) {
+        std::lock_guard<std::mutex> lock(logMutex);
+        std::cerr << "[BATCH] failed to " << what << ": " << path << "\n";
+    };
+
+    // First error wins; closing every queue wakes all blocked threads
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    auto fail = [&] {
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) error = std::current_exception();
+        }
+        freeQ.close();
+        decodedQ.close();
+        encodeQ.close();
+    };
+
+    Timer total;
+
+    // --- decoders ---
+    std::atomic<int> decodersRunning{nIo};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < nIo; i++) {
+        threads.emplace_back([&, i] {
+            traceNameThread("decoder " + std::to_string(i));
+            IoCounters& io = decoders[i];
+            try {
+                int s;
+                while (freeQ.pop(s)) {
+                    int idx = nextFile++;
+                    if (idx >= (int)files.size()) break;
+
+                    ImageSlot& slot = slots[s];
+                    slot.index = idx;
+                    slot.age.reset();
+                    traceSetFrame(idx);
+                    TraceSpan span("decode", "io");
+                    // imdecode into the slot's Mat reuses it when the size matches
+                    bool ok = readFile(files[idx], slot.fileBytes) &&
+                              cv::imdecode(slot.fileBytes, cv::IMREAD_COLOR, &slot.bgr).data &&
+                              !slot.bgr.empty();
+                    double ms = span.end();
+                    if (!ok) {
+                        io.failed++;
+                        reportFailure("load", files[idx]);
+                        freeQ.push(s);
+                        continue;
+                    }
+                    io.bytes += slot.fileBytes.size();
+                    io.stats.decode.add(ms);
+                    if (!decodedQ.push(s)) break;
+                }
+            } catch (...) {
+                fail();
+            }
+            // Last decoder out: no more images for the filter workers
+            if (--decodersRunning == 0) decodedQ.close();
+        });
+    }
+
+    // --- filter workers ---
+    std::atomic<int> workersRunning{nWorkers};
+    for (int i = 0; i < nWorkers; i++) {
+        threads.emplace_back([&, i] {
+            traceNameThread("filter worker " + std::to_string(i));
+            BatchWorker& bw = workers[i];
+            try {
+                int s;
+                while (decodedQ.pop(s)) {
+                    ImageSlot& slot = slots[s];
+                    // Size the slot's output first so the graph writes straight into it
+                    createFrame(slot.edges, bw.buf.graph.outputFormat(), slot.bgr.cols, slot.bgr.rows);
+                    bw.buf.edges = slot.edges;
+                    traceSetFrame(slot.index);
+                    StageTimes t;
+                    processFrame(slot.bgr, bw.buf, bw.ws, args, t);
+                    bw.stats.add(t);
+                    if (!encodeQ.push(s)) break;
+                }
+            } catch (...) {
+                fail();
+            }
+            if (--workersRunning == 0) encodeQ.close();
+        });
+    }
+
+    // --- encoders ---
+    std::atomic<int> written{0};
+    for (int i = 0; i < nIo; i++) {
+        threads.emplace_back([&, i] {
+            traceNameThread("encoder " + std::to_string(i));
+            IoCounters& io = encoders[i];
+            try {
+                int s;
+                while (encodeQ.pop(s)) {
+                    ImageSlot& slot = slots[s];
+                    const std::string& outPath = outPaths[slot.index];
+                    traceSetFrame(slot.index);
+                    TraceSpan span("encode", "io");
+                    bool ok = cv::imencode(".png", slot.edges, slot.encoded) &&
+                              writeFile(outPath, slot.encoded);
+                    double ms = span.end();
+                    if (ok) {
+                        io.bytes += slot.encoded.size();
+                        io.stats.encode.add(ms);
+                        io.stats.latency.add(slot.age.ms());
+                        int n = ++written;
+                        if (n % 100 == 0) {
+                            std::lock_guard<std::mutex> lock(logMutex);
+                            std::cout << "image " << n << " processed\n";
+                        }
+                    } else {
+                        io.failed++;
+                        reportFailure("write", outPath);
+                    }
+                    if (!freeQ.push(s)) break;
+                }
+            } catch (...) {
+                fail();
+            }
+        });
+    }
+
+    for (std::thread& th : threads) th.join();
+    traceSetFrame(-1);
+    if (error) std::rethrow_exception(error);
+
+    double totalMs = total.ms();
+    double secs = totalMs / 1000.0;
+
+    StageStats stats;
+    uint64_t bytesIn = 0, bytesOut = 0;
+    int failed = 0;
+    for (const IoCounters& io : decoders) {
+        stats.merge(io.stats);
+        bytesIn += io.bytes;
+        failed += io.failed;
+    }
+    for (const IoCounters& io : encoders) {
+        stats.merge(io.stats);
+        bytesOut += io.bytes;
+        failed += io.failed;
+    }
+    PoolStats pools;
+    for (const BatchWorker& bw : workers) {
+        stats.merge(bw.stats);
+        if (bw.ws.workers) pools += bw.ws.workers->stats();
+    }
+
+    int images = written;
+    double mb = 1024.0 * 1024.0;
+    printRunHeader("BATCH", 0, 0, args);
+    std::cout << "  stages:    " << workers[0].buf.graph.describe() << "\n";
+    std::cout << "  images:    " << images << " written, " << failed << " failed, "
+              << files.size() << " listed\n";
+    printStageStats(stats, workers[0].buf.graph);
+    std::cout << "  total:     " << totalMs << " ms\n";
+    if (secs > 0) {
+        std::cout << "  throughput: " << images / secs << " images/s, "
+                  << bytesIn / mb / secs << " MB/s read, "
+                  << bytesOut / mb / secs << " MB/s written\n";
+    }
+    std::cout << "  frames per worker:";
+    for (const BatchWorker& bw : workers) std::cout << " " << bw.stats.frames;
+    std::cout << "\n";
+    if (mt) printPoolStats(pools, nWorkers, args.threads);
+}
@@ -0,0 +1,211 @@
+#include "pipeline.hpp"
+#include "frame_ops.hpp"
+#include "bounded_queue.hpp"
+#include "utils.hpp"
+#include "trace.hpp"
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+Frame-level parallelism: several whole frames at once.
+
+At small resolutions a frame is too little work to split 16 ways; the
+pool spends more time waking threads than filtering rows. Here each
+frame worker takes a complete frame and runs gray -> blur -> sobel on it
+alone, with its own CpuWorkspace and buffers (nothing shared, nothing
+to synchronize inside a frame).
+
+  main thread     :  freeQ -> cap.read -> workQ            (in order)
+  frame worker xN :  workQ -> processFrame -> reorder       (any order)
+  writer thread   :  reorder -> cvtColor + writer.write -> freeQ (in order)
+
+In cpu-mt each frame worker still owns a pool of --threads threads, so
+"--frames-in-flight 4 --threads 4" is 4 frames x 4 row bands.
+
+Throughput and latency now differ: with N frames in flight FPS goes up
+by up to N, but each single frame takes as long as before (longer if
+the workers fight over cores / memory bandwidth), plus time waiting in
+the queues. So both are reported.
+*/
+
+namespace {
+
+struct FrameSlot {
+    cv::Mat frame;     // decoded BGR
+    cv::Mat edges;     // filter output
+    cv::Mat edgesBgr;  // writer's 3-channel copy
+    Timer age;         // started just before decode -> per-frame latency
+};
+
+// Everything one frame worker owns
+struct FrameWorker {
+    CpuWorkspace ws;
+    FrameBuffers buf;
+    StageStats stats;
+};
+
+// Work item: which slot, and which frame of the video it holds
+struct FrameJob {
+    int slot = 0;
+    uint64_t seq = 0;
+};
+
+} // namespace
+
+void Pipeline::runVideoFrameParallel(const Args& args) {
+    cv::VideoCapture cap;
+    cv::VideoWriter writer;
+    int w = 0, h = 0;
+    double fpsIn = 0.0;
+    openVideoIO(args, cap, writer, w, h, fpsIn);
+
+    bool mt = (args.mode == Mode::CPU_MT);
+    int nWorkers = std::max(1, args.framesInFlight);
+
+    // One slot per busy worker, plus room to decode ahead and to write behind.
+    // Slots are only freed by the writer (in order), so every frame in flight
+    // has a sequence number within nSlots of the oldest -> ReorderBuffer window.
+    int nSlots = 2 * nWorkers + 2;
+    PixelFormat outFmt = buildGraph(args).outputFormat();
+    std::vector<FrameSlot> slots(nSlots);
+    for (FrameSlot& s : slots) {
+        s.frame.create(h, w, CV_8UC3);
+        createFrame(s.edges, outFmt, w, h);
+        s.edgesBgr.create(h, w, CV_8UC3);
+    }
+
+    // Per-worker state (allocated + threads spawned before timing)
+    std::vector<FrameWorker> workers(nWorkers);
+    for (FrameWorker& fw : workers) {
+        if (mt) fw.ws.ensureThreads(args.threads);
+        fw.buf.setup(args, w, h, fw.ws);
+    }
+
+    BoundedQueue<int> freeQ(nSlots);
+    BoundedQueue<FrameJob> workQ(nWorkers);
+    ReorderBuffer<int> reorder(nSlots);
+    for (int i = 0; i < nSlots; i++) freeQ.push(i);
+
+    StageStats ioStats; // decode (main thread), encode + latency (writer thread)
+    int written = 0;
+
+    // First error wins; closing every queue wakes all blocked threads
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    auto fail = [&] {
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) error = std::current_exception();
+        }
+        freeQ.close();
+        workQ.close();
+        reorder.close();
+    };
+
+    Timer total;
+
+    // --- frame workers ---
+    std::atomic<int> running{nWorkers};
+    std::vector<std::thread> threads;
+    threads.reserve(nWorkers);
+    for (int i = 0; i < nWorkers; i++) {
+        threads.emplace_back([&, i] {
+            traceNameThread("frame worker " + std::to_string(i));
+            FrameWorker& fw = workers[i];
+            try {
+                FrameJob job;
+                while (workQ.pop(job)) {
+                    fw.buf.edges = slots[job.slot].edges; // write straight into the slot
+                    traceSetFrame((int64_t)job.seq);
+                    StageTimes t;
+                    processFrame(slots[job.slot].frame, fw.buf, fw.ws, args, t);
+                    fw.stats.add(t);
+                    reorder.put(job.seq, job.slot);
+                }
+            } catch (...) {
+                fail();
+            }
+            // Last worker out: nothing more will reach the writer
+            if (--running == 0) reorder.close();
+        });
+    }
+
+    // --- writer (frames leave in the original order) ---
+    std::thread writerThread([&] {
+        traceNameThread("writer");
+        try {
+            int s;
+            while (reorder.next(s)) {
+                traceSetFrame(written);
+                TraceSpan span("encode", "io");
+                writer.write(writerFrame(slots[s].edges, slots[s].edgesBgr));
+                ioStats.encode.add(span.end());
+                ioStats.latency.add(slots[s].age.ms());
+
+                if (++written % 60 == 0) {
+                    std::cout << "frame " << written << " processed\n";
+                }
+                if (!freeQ.push(s)) break;
+            }
+        } catch (...) {
+            fail();
+        }
+    });
+
+    // --- decoder (this thread) ---
+    traceNameThread("decoder");
+    uint64_t decoded = 0;
+    try {
+        int s;
+        while (freeQ.pop(s)) {
+            slots[s].age.reset();
+            traceSetFrame((int64_t)decoded);
+            TraceSpan span("decode", "io");
+            bool ok = cap.read(slots[s].frame);
+            double ms = span.end();
+            if (!ok) break;
+            ioStats.decode.add(ms);
+            if (!workQ.push(FrameJob{s, decoded})) break;
+            decoded++;
+        }
+    } catch (...) {
+        fail();
+    }
+    workQ.close(); // end of stream: workers drain the queue and exit
+    traceSetFrame(-1);
+
+    for (std::thread& th : threads) th.join();
+    writerThread.join();
+    if (error) std::rethrow_exception(error);
+
+    double totalMs = total.ms();
+    int frames = written;
+    double fpsOut = (totalMs > 0) ? (frames / (totalMs / 1000.0)) : 0.0;
+
+    StageStats stats = ioStats;
+    PoolStats pools;
+    for (const FrameWorker& fw : workers) {
+        stats.merge(fw.stats);
+        if (fw.ws.workers) pools += fw.ws.workers->stats();
+    }
+
+    printRunHeader("VIDEO", w, h, args);
+    printGraphPlan(workers[0].buf.graph);
+    std::cout << "  frames:    " << frames << "\n";
+    printStageStats(stats, workers[0].buf.graph);
+    std::cout << "  total:     " << totalMs << " ms\n";
+    std::cout << "  throughput: " << fpsOut << " FPS\n";
+    std::cout << "  frames per worker:";
+    for (const FrameWorker& fw : workers) std::cout << " " << fw.stats.frames;
+    std::cout << " (max " << reorder.maxWaiting() << " waited for reordering)\n";
+    if (mt) printPoolStats(pools, nWorkers, args.threads);
+}
@@ -0,0 +1,120 @@
+#include "pipeline.hpp"
+#include "frame_ops.hpp"
+#include "filters_cpu.hpp"
+#include "utils.hpp"
+#include "trace.hpp"
+
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*
+One image, blurred at several radii (--blur-radii 1,4,16).
+
+The --stages chain is split at its blur stage:
+  prefix (e.g. gray)  -> runs once
+  blur                -> box_blur_sat_multi: one summed-area table, every radius
+  suffix (e.g. sobel) -> runs once per radius
+and each radius is written to <out>_r<R>.<ext>. "--stages gray,blur"
+writes the blurred frames themselves.
+*/
+
+void Pipeline::runImageMultiBlur(const Args& args) {
+    cv::Mat bgr = loadImage(args);
+    if (bgr.empty()) throw std::runtime_error("Failed to load image: " + args.imagePath);
+    if (args.mode == Mode::GPU) {
+        throw std::runtime_error("GPU mode not available on this machine (CUDA requires NVIDIA).");
+    }
+
+    // The table is built over one gray frame (no --color planes)
+    if (args.color) throw std::runtime_error("--blur-radii does not support --color");
+
+    // Split the chain around its one blur stage
+    std::string spec = args.stages.empty() ? "gray,blur,sobel" : args.stages;
+    std::vector<std::string> prefix, suffix;
+    int blurs = 0;
+    {
+        std::stringstream ss(spec);
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            if (item.empty()) continue;
+            if (item.substr(0, item.find(':')) == "blur") {
+                blurs++;
+                continue;
+            }
+            (blurs ? suffix : prefix).push_back(item);
+        }
+    }
+    if (blurs != 1) throw std::runtime_error("--blur-radii needs exactly one blur stage in --stages");
+    auto join = [](const std::vector<std::string>& v) {
+        std::string s;
+        for (const std::string& x : v) s += (s.empty() ? "" : ",") + x;
+        return s;
+    };
+
+    int threads = (args.mode == Mode::CPU_MT) ? args.threads : 1;
+    CpuWorkspace ws;
+    if (threads > 1) ws.ensureThreads(threads);
+
+    // Prefix: BGR -> gray, so it can't be empty for an image
+    if (prefix.empty()) throw std::runtime_error("--blur-radii: the chain must make a gray image before blur");
+    FilterGraph pre = FilterGraph::parse(join(prefix), args.radius, args.sobelNorm);
+    bool hasSuffix = !suffix.empty();
+    FilterGraph post;
+    if (hasSuffix) post = FilterGraph::parse(join(suffix), args.radius, args.sobelNorm, PixelFormat::GRAY8);
+
+    cv::Mat gray;
+    std::vector<cv::Mat> blurred;
+    std::vector<cv::Mat> results(args.blurRadii.size());
+    double preMs[FilterGraph::kMaxStages] = {};
+    std::vector<double> postMs(args.blurRadii.size(), 0.0);
+
+    Timer total;
+
+    pre.run(bgr, gray, threads, ws, preMs);
+
+    double satMs;
+    {
+        TraceSpan s("blur_sat", "stage");
+        box_blur_sat_multi(gray, blurred, args.blurRadii, threads, ws);
+        satMs = s.end();
+    }
+
+    for (size_t i = 0; i < args.blurRadii.size(); i++) {
+        if (!hasSuffix) {
+            results[i] = blurred[i];
+            continue;
+        }
+        double ms[FilterGraph::kMaxStages] = {};
+        post.run(blurred[i], results[i], threads, ws, ms);
+        for (int k = 0; k < post.size(); k++) postMs[i] += ms[k];
+    }
+    double computeMs = total.ms();
+
+    for (size_t i = 0; i < args.blurRadii.size(); i++) {
+        std::string path = suffixedPath(args.outPath, "_r" + std::to_string(args.blurRadii[i]));
+        if (!cv::imwrite(path, results[i])) throw std::runtime_error("Failed to write output: " + path);
+    }
+
+    printRunHeader("IMAGE", bgr.cols, bgr.rows, args);
+    std::cout << "  stages:    " << pre.describe() << " -> blur(sat) x" << args.blurRadii.size();
+    if (hasSuffix) std::cout << " -> " << post.describe() << " each";
+    std::cout << "\n";
+    for (int k = 0; k < pre.size(); k++) {
+        std::cout << "  " << pre.stage(k).label() << ": " << preMs[k] << " ms\n";
+    }
+    std::cout << "  blur(sat) radii";
+    for (int r : args.blurRadii) std::cout << " " << r;
+    std::cout << ": " << satMs << " ms (one table, "
+              << ws.sat.size() * sizeof(uint32_t) / 1024 << " KB)\n";
+    if (hasSuffix) {
+        for (size_t i = 0; i < args.blurRadii.size(); i++) {
+            std::cout << "  " << post.describe() << " @r" << args.blurRadii[i] << ": " << postMs[i] << " ms\n";
+        }
+    }
+    std::cout << "  compute:   " << computeMs << " ms\n";
+    printPoolStats(ws);
+}
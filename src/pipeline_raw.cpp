@@ -0,0 +1,140 @@
+#include "pipeline.hpp"
+#include "frame_ops.hpp"
+#include "raw_io.hpp"
+#include "incremental.hpp"
+#include "utils.hpp"
+#include "trace.hpp"
+
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <stdexcept>
+
+/*
+Video with raw frames on at least one side (raw_io.hpp).
+
+Same serial loop as runVideo, but:
+- raw input: frames are the Y plane itself, as a zero-copy view into the
+  mapped file, and the graph starts at gray (default "blur,sobel")
+- raw output: the edges frame is written as-is (no cvtColor to BGR,
+  no mp4v encode)
+The other side can still be an OpenCV capture/writer, e.g. mp4 -> y4m.
+*/
+
+void Pipeline::runVideoRaw(const Args& args) {
+    if (args.mode == Mode::GPU) {
+        throw std::runtime_error("GPU mode not available on this machine (CUDA requires NVIDIA).");
+    }
+
+    RawFormat inFmt = RawFormat::Y4M, outFmt = RawFormat::Y4M;
+    bool rawIn = resolveRawFormat(args.inFormat, args.videoPath, inFmt);
+    bool rawOut = resolveRawFormat(args.outFormat, args.outPath, outFmt);
+
+    // --- source ---
+    RawFrameReader reader;
+    cv::VideoCapture cap;
+    int w = 0, h = 0;
+    int fpsNum = 30, fpsDen = 1;
+    if (rawIn) {
+        reader.open(args.videoPath, inFmt, args.rawWidth, args.rawHeight);
+        w = reader.width();
+        h = reader.height();
+        fpsNum = reader.fpsNum();
+        fpsDen = reader.fpsDen();
+    } else {
+        cap.open(args.videoPath);
+        if (!cap.isOpened()) throw std::runtime_error("Failed to open video: " + args.videoPath);
+        w = (int)cap.get(cv::CAP_PROP_FRAME_WIDTH);
+        h = (int)cap.get(cv::CAP_PROP_FRAME_HEIGHT);
+        double fps = cap.get(cv::CAP_PROP_FPS);
+        if (fps > 0) {
+            fpsNum = (int)(fps * 1000 + 0.5);
+            fpsDen = 1000;
+        }
+    }
+
+    // --- sink ---
+    RawFrameWriter rawWriter;
+    cv::VideoWriter writer;
+    cv::Mat edgesBgr;
+    if (rawOut) {
+        rawWriter.open(args.outPath, outFmt, w, h, fpsNum, fpsDen);
+    } else {
+        int fourcc = cv::VideoWriter::fourcc('m','p','4','v');
+        writer.open(args.outPath, fourcc, (double)fpsNum / fpsDen, cv::Size(w, h), true);
+        if (!writer.isOpened()) throw std::runtime_error("Failed to open VideoWriter: " + args.outPath);
+    }
+
+    CpuWorkspace ws;
+    if (args.mode == Mode::CPU_MT) ws.ensureThreads(args.threads);
+    FrameBuffers buf;
+    buf.setup(args, w, h, ws, rawIn ? PixelFormat::GRAY8 : PixelFormat::BGR8);
+    if (rawOut && buf.graph.outputFormat() != PixelFormat::GRAY8) {
+        throw std::runtime_error("Raw output is gray only; the filter chain ends in colour");
+    }
+    if (!rawOut) createFrame(edgesBgr, PixelFormat::BGR8, w, h, ws); // mp4 sink's 3-channel copy
+    IncrementalFilter inc;
+    if (args.incremental) inc.setup(args, buf, w, h, ws, rawIn ? PixelFormat::GRAY8 : PixelFormat::BGR8);
+
+    StageStats stats;
+    int frames = 0;
+    cv::Mat frame;
+
+    traceNameThread("main");
+    Timer total;
+
+    while (true) {
+        Timer age;
+
+        {
+            TraceSpan s("decode", "io");
+            bool ok = rawIn ? reader.next(frame) : cap.read(frame);
+            double ms = s.end();
+            if (!ok) break;
+            stats.decode.add(ms);
+        }
+        traceSetFrame(frames);
+        frames++;
+
+        StageTimes t;
+        if (args.incremental) inc.process(frame, buf, ws, args, t);
+        else processFrame(frame, buf, ws, args, t);
+        stats.add(t);
+
+        {
+            TraceSpan s("encode", "io");
+            if (rawOut) {
+                rawWriter.write(buf.edges);
+            } else {
+                writer.write(writerFrame(buf.edges, edgesBgr));
+            }
+            stats.encode.add(s.end());
+        }
+        stats.latency.add(age.ms());
+
+        if (frames % 60 == 0) {
+            std::cout << "frame " << frames << " processed\n";
+        }
+    }
+    traceSetFrame(-1);
+    if (rawOut) rawWriter.close();
+
+    double totalMs = total.ms();
+    double fpsOut = (totalMs > 0) ? (frames / (totalMs / 1000.0)) : 0.0;
+    double mb = 1024.0 * 1024.0;
+
+    printRunHeader("VIDEO", w, h, args);
+    std::cout << "  raw io:    in=" << (rawIn ? rawFormatName(inFmt) : "opencv")
+              << (rawIn && reader.mapped() ? " (mmap, zero-copy)" : "")
+              << " out=" << (rawOut ? rawFormatName(outFmt) : "opencv") << "\n";
+    printGraphPlan(buf.graph);
+    std::cout << "  frames:    " << frames << "\n";
+    printStageStats(stats, buf.graph);
+    std::cout << "  total:     " << totalMs << " ms\n";
+    std::cout << "  avg FPS:   " << fpsOut << "\n";
+    if (totalMs > 0) {
+        if (rawIn) std::cout << "  read:      " << reader.bytesRead() / mb / (totalMs / 1000.0) << " MB/s\n";
+        if (rawOut) std::cout << "  written:   " << rawWriter.bytesWritten() / mb / (totalMs / 1000.0) << " MB/s\n";
+    }
+    if (args.incremental) printIncrementalStats(inc.stats(), args.incrementalBlock);
+    printPoolStats(ws);
+}
@@ -0,0 +1,264 @@
+#include "pipeline.hpp"
+#include "frame_ops.hpp"
+#include "utils.hpp"
+#include "trace.hpp"
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+/*
+Real-time video (--realtime): keep up with a live source or degrade.
+
+runVideo takes frames as fast as it can, so when a stage spikes the
+backlog (and the latency) just grows. Here a camera thread replays the
+file at its own frame rate (x --speed) and publishes each frame into a
+one-frame mailbox, like a live feed: if the filter thread hasn't taken
+the previous frame yet, it is overwritten (a source drop).
+
+Every frame has a latency budget (--budget, default one frame period),
+counted from the moment it was "captured". Before filtering a frame the
+filter thread predicts its finish time with a moving average of how
+long each quality level took (filter + encode):
+  age + est[full]     <= budget -> full quality
+  age + est[fallback] <= budget -> cheaper chain, blur radius capped at
+                                   --fallback-radius (--overload degrade|both)
+  otherwise                     -> drop it unfiltered (--overload drop|both),
+                                   or run the cheapest level and miss
+A processed frame that still ends past its budget is a deadline miss.
+
+Only processed frames are written, so the output is what a viewer of
+the live feed would have seen.
+*/
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double msBetween(Clock::time_point a, Clock::time_point b) {
+    return std::chrono::duration<double, std::milli>(b - a).count();
+}
+
+// Latest frame from the camera; a new frame replaces one not yet taken
+struct Mailbox {
+    std::mutex m;
+    std::condition_variable cv;
+    cv::Mat frame;
+    Clock::time_point captured;
+    int64_t seq = -1;
+    bool full = false;
+    bool done = false;       // camera reached the end of the file
+    bool stop = false;       // filter thread failed: camera quits early
+    uint64_t overwritten = 0;
+};
+
+// "gray,blur:5,sobel" -> every blur radius capped at r
+std::string capBlurRadius(const std::string& spec, int r) {
+    std::stringstream ss(spec);
+    std::string item, out;
+    while (std::getline(ss, item, ',')) {
+        if (item.empty()) continue;
+        if (item.compare(0, 5, "blur:") == 0) {
+            int cur = r;
+            try {
+                cur = std::stoi(item.substr(5));
+            } catch (const std::exception&) {
+                // bad radius: let FilterGraph::parse report it
+            }
+            if (cur > r) item = "blur:" + std::to_string(r);
+        }
+        out += (out.empty() ? "" : ",") + item;
+    }
+    return out;
+}
+
+// Exponential moving average of one level's frame cost (0 = no sample yet).
+// A level that is passed over gets no new samples, so its estimate decays
+// instead: one slow frame cannot lock a level out for the rest of the run.
+struct CostEstimate {
+    double ms = 0.0;
+    void add(double sample) { ms = (ms == 0.0) ? sample : 0.8 * ms + 0.2 * sample; }
+    void skipped() { ms *= 0.95; }
+};
+
+} // namespace
+
+void Pipeline::runVideoRealtime(const Args& args) {
+    cv::VideoCapture cap;
+    cv::VideoWriter writer;
+    int w = 0, h = 0;
+    double fpsIn = 0.0;
+    openVideoIO(args, cap, writer, w, h, fpsIn);
+
+    if (args.rtSpeed <= 0) throw std::runtime_error("--speed must be > 0");
+    if (args.rtOverload != "drop" && args.rtOverload != "degrade" && args.rtOverload != "both") {
+        throw std::runtime_error("--overload must be drop, degrade or both: " + args.rtOverload);
+    }
+    bool mayDrop = args.rtOverload != "degrade";
+    bool mayDegrade = args.rtOverload != "drop";
+    double periodMs = 1000.0 / (fpsIn * args.rtSpeed);
+    double budgetMs = args.rtBudgetMs > 0 ? args.rtBudgetMs : periodMs;
+
+    // Level 0 = the requested chain, level 1 = the same with blur capped.
+    // Separate workspaces: the two graphs plan their own planes.
+    Args cheap = args;
+    cheap.radius = std::min(args.radius, args.rtFallbackRadius);
+    if (!args.stages.empty()) cheap.stages = capBlurRadius(args.stages, args.rtFallbackRadius);
+    const int kLevels = 2;
+    CpuWorkspace ws[kLevels];
+    FrameBuffers buf[kLevels];
+    for (int l = 0; l < kLevels; l++) {
+        if (args.mode == Mode::CPU_MT) ws[l].ensureThreads(args.threads);
+        buf[l].setup(l == 0 ? args : cheap, w, h, ws[l]);
+    }
+    if (!mayDegrade || buf[1].graph.describe() == buf[0].graph.describe()) mayDegrade = false;
+
+    Mailbox box;
+    std::exception_ptr camError;
+
+    // Stats: the camera counts frames, everything else is the filter thread's
+    StageStats stats;
+    LatencyHistogram waitMs; // capture -> filter start
+    int64_t captured = 0;
+    uint64_t processed[kLevels] = {};
+    uint64_t dropped = 0, misses = 0;
+    CostEstimate est[kLevels];
+    cv::Mat edgesBgr;
+    createFrame(edgesBgr, PixelFormat::BGR8, w, h, ws[0]);
+
+    traceNameThread("filter");
+    Timer total;
+
+    // --- camera: decode, wait for the frame's slot in time, publish ---
+    std::thread camera([&] {
+        traceNameThread("camera");
+        try {
+            cv::Mat grabbed;
+            Clock::time_point start = Clock::now();
+            for (int64_t seq = 0;; seq++) {
+                {
+                    std::lock_guard<std::mutex> lock(box.m);
+                    if (box.stop) break;
+                }
+                {
+                    TraceSpan s("decode", "io");
+                    if (!cap.read(grabbed)) break;
+                    stats.decode.add(s.end());
+                }
+                auto due = start + std::chrono::duration_cast<Clock::duration>(
+                                       std::chrono::duration<double, std::milli>(seq * periodMs));
+                // Waits for the frame's slot, but wakes up at once if the filter thread gave up
+                std::unique_lock<std::mutex> lock(box.m);
+                if (box.cv.wait_until(lock, due, [&] { return box.stop; })) break;
+                if (box.full) box.overwritten++;
+                std::swap(box.frame, grabbed); // no copy: the buffers trade places
+                box.captured = std::max(due, Clock::now());
+                box.seq = seq;
+                box.full = true;
+                captured = seq + 1;
+                box.cv.notify_one();
+            }
+        } catch (...) {
+            camError = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(box.m);
+        box.done = true;
+        box.cv.notify_one();
+    });
+
+    // --- filter thread: take the newest frame, decide, filter, write ---
+    cv::Mat frame;
+    try {
+        while (true) {
+            Clock::time_point capturedAt;
+            int64_t seq;
+            {
+                std::unique_lock<std::mutex> lock(box.m);
+                box.cv.wait(lock, [&] { return box.full || box.done; });
+                if (!box.full) break;
+                std::swap(frame, box.frame);
+                capturedAt = box.captured;
+                seq = box.seq;
+                box.full = false;
+            }
+            traceSetFrame(seq);
+            double age = msBetween(capturedAt, Clock::now());
+            waitMs.add(age);
+
+            int level = 0;
+            if (age + est[0].ms > budgetMs) {
+                bool cheapFits = mayDegrade && age + est[1].ms <= budgetMs;
+                if (cheapFits) level = 1;
+                else if (mayDrop) level = -1;
+                else level = mayDegrade ? 1 : 0;
+            }
+            for (int l = 0; l < kLevels; l++) {
+                if (l != level) est[l].skipped();
+            }
+            if (level < 0) {
+                TraceSpan s("drop", "realtime");
+                dropped++;
+                continue;
+            }
+
+            Timer cost;
+            StageTimes t;
+            processFrame(frame, buf[level], ws[level], args, t);
+            if (level == 0) stats.add(t);
+            {
+                TraceSpan s("encode", "io");
+                writer.write(writerFrame(buf[level].edges, edgesBgr));
+                stats.encode.add(s.end());
+            }
+            est[level].add(cost.ms());
+            processed[level]++;
+
+            double latency = msBetween(capturedAt, Clock::now());
+            stats.latency.add(latency);
+            if (latency > budgetMs) misses++;
+        }
+    } catch (...) {
+        {
+            std::lock_guard<std::mutex> lock(box.m);
+            box.stop = true;
+        }
+        box.cv.notify_all();
+        camera.join();
+        throw;
+    }
+    camera.join();
+    if (camError) std::rethrow_exception(camError);
+    traceSetFrame(-1);
+
+    double totalMs = total.ms();
+    uint64_t done = processed[0] + processed[1];
+    auto pct = [&](uint64_t n) { return captured ? 100.0 * (double)n / (double)captured : 0.0; };
+
+    printRunHeader("REALTIME", w, h, args);
+    printGraphPlan(buf[0].graph);
+    if (mayDegrade) std::cout << "  fallback:  " << buf[1].graph.describe() << "\n";
+    std::cout << "  source:    " << fpsIn << " fps x" << args.rtSpeed << " = one frame every "
+              << periodMs << " ms, budget " << budgetMs << " ms, overload=" << args.rtOverload << "\n";
+    std::cout << "  frames:    " << captured << " captured, " << done << " processed ("
+              << processed[1] << " at fallback quality)\n";
+    std::cout << "  dropped:   " << dropped + box.overwritten << " (" << pct(dropped + box.overwritten) << "%): "
+              << dropped << " too late to start, " << box.overwritten << " overwritten at the source\n";
+    std::cout << "  deadline:  " << misses << " misses (" << (done ? 100.0 * misses / done : 0.0)
+              << "% of processed frames)\n";
+    printStageStats(stats, buf[0].graph);
+    std::cout << "  waited:    " << waitMs.mean() << " ms avg before filtering (p99 "
+              << waitMs.percentile(0.99) << ")\n";
+    std::cout << "  total:     " << totalMs << " ms (" << (totalMs > 0 ? done / (totalMs / 1000.0) : 0.0)
+              << " FPS out)\n";
+    printPoolStats(ws[0]);
+}
@@ -0,0 +1,272 @@
+#include "pipeline.hpp"
+#include "frame_ops.hpp"
+#include "filters_cpu.hpp"
+#include "utils.hpp"
+#include "trace.hpp"
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*
+Region of interest and image pyramid (--roi x,y,w,h, --scale N,
+--pyramid-levels L), for one image or a serial video.
+
+The graph never sees the full frame, only a zero-copy view of the ROI
+grown by the chain's halo: pixels around the ROI edge are filtered with
+their real neighbours (the clamped border only applies where the ROI
+touches the frame edge), so the ROI is bit-identical to the same pixels
+of a full-frame run. Buffers are planned for that crop, so work and
+memory follow the ROI, not the source.
+
+--scale N: the crop is downsampled by grayscale_downsample (gray
+conversion fused with log2(N) 2x2-mean steps) and the rest of the chain
+runs on the small gray frame. --pyramid-levels L adds L - 1 levels, each half
+the previous one (downsample2_gray), every one filtered and written
+(<out>_l<k>.<ext>). Level k is at 1/(N * 2^k) of the source.
+
+Exactness with scaling: the crop starts on a multiple of the coarsest
+factor and is grown by halo * that factor, so every level's crop is
+block-aligned with the full frame's pyramid and still holds its ROI
+plus the halo.
+*/
+
+namespace {
+
+// One pyramid level (just one without --scale / --pyramid-levels)
+struct RegionLevel {
+    int factor = 1;        // source pixels per level pixel, per axis
+    cv::Rect area;         // level pixels filtered (ROI + halo), in level coordinates
+    cv::Rect roi;          // the ROI, in level coordinates
+    cv::Mat gray;          // the downsampled crop (scaled runs only)
+    CpuWorkspace ws;       // per level: the blur buffers follow the frame size
+    FrameBuffers buf;      // graph planned for area.size()
+    cv::Mat out;           // the ROI inside buf.edges (a view)
+    StageStats stats;
+    LatencyHistogram down; // downsample into `gray`
+};
+
+class RegionFilter {
+public:
+    void setup(const Args& args, int w, int h) {
+        int nLevels = args.pyramidLevels;
+        if (nLevels < 1 || nLevels > 8) throw std::runtime_error("--pyramid-levels must be 1..8");
+        if (!downsample_factor_ok(args.scale)) {
+            throw std::runtime_error("--scale must be 1, 2, 4, 8 or 16");
+        }
+        scale_ = args.scale;
+        scaled_ = args.scale > 1 || nLevels > 1;
+        if (scaled_ && args.color) {
+            throw std::runtime_error("--scale/--pyramid-levels filter a gray pyramid (no --color)");
+        }
+        w_ = w;
+        h_ = h;
+
+        roi_ = args.roiW > 0 ? cv::Rect(args.roiX, args.roiY, args.roiW, args.roiH) : cv::Rect(0, 0, w, h);
+        if (roi_.width < 1 || roi_.height < 1 || roi_.x < 0 || roi_.y < 0 ||
+            roi_.x + roi_.width > w || roi_.y + roi_.height > h) {
+            throw std::runtime_error("--roi must lie inside the " + std::to_string(w) + "x" +
+                                     std::to_string(h) + " frame");
+        }
+
+        // Source crop: ROI + halo at the coarsest level, aligned to its blocks
+        PixelFormat input = scaled_ ? PixelFormat::GRAY8 : PixelFormat::BGR8;
+        int coarsest = scale_ << (nLevels - 1);
+        FilterGraph graph = buildGraph(args, input);
+        if (!graph.local()) throw std::runtime_error("--roi/--scale/--pyramid-levels: the filter chain must be local (no canny)");
+        int grow = graph.totalHalo() * coarsest;
+        int x0 = std::max(0, roi_.x - grow) / coarsest * coarsest;
+        int y0 = std::max(0, roi_.y - grow) / coarsest * coarsest;
+        int x1 = std::min(w, (roi_.x + roi_.width + grow + coarsest - 1) / coarsest * coarsest);
+        int y1 = std::min(h, (roi_.y + roi_.height + grow + coarsest - 1) / coarsest * coarsest);
+        src_ = cv::Rect(x0, y0, x1 - x0, y1 - y0);
+
+        levels_ = std::vector<RegionLevel>(nLevels);
+        int aw = src_.width, ah = src_.height;
+        for (int k = 0; k < nLevels; k++) {
+            RegionLevel& l = levels_[k];
+            l.factor = scale_ << k;
+            if (scaled_) {
+                aw = (k == 0) ? aw / scale_ : aw / 2;
+                ah = (k == 0) ? ah / scale_ : ah / 2;
+            }
+            if (aw < 1 || ah < 1) {
+                throw std::runtime_error("--scale/--pyramid-levels: level " + std::to_string(k) + " is empty");
+            }
+            l.area = cv::Rect(src_.x / l.factor, src_.y / l.factor, aw, ah);
+
+            // ROI rounded outward to whole level pixels (partial edge blocks are dropped)
+            int rx0 = roi_.x / l.factor, ry0 = roi_.y / l.factor;
+            int rx1 = std::min(l.area.x + aw, (roi_.x + roi_.width + l.factor - 1) / l.factor);
+            int ry1 = std::min(l.area.y + ah, (roi_.y + roi_.height + l.factor - 1) / l.factor);
+            if (rx1 <= rx0 || ry1 <= ry0) {
+                throw std::runtime_error("--roi is empty at level " + std::to_string(k) + " (1/" +
+                                         std::to_string(l.factor) + ")");
+            }
+            l.roi = cv::Rect(rx0, ry0, rx1 - rx0, ry1 - ry0);
+
+            int workers = 1;
+            if (args.mode == Mode::CPU_MT) workers = l.ws.ensureThreads(args.threads).size();
+            if (k == 0 && scale_ > 1) l.ws.ensureDownsample(workers, scale_, src_.width);
+            if (scaled_) createFrame(l.gray, PixelFormat::GRAY8, aw, ah, l.ws);
+            l.buf.setup(args, aw, ah, l.ws, input);
+            l.out = l.buf.edges(cv::Rect(l.roi.x - l.area.x, l.roi.y - l.area.y, l.roi.width, l.roi.height));
+        }
+    }
+
+    // Filter one source frame: every level's ROI ends up in level(k).out
+    void process(const cv::Mat& bgr, const Args& args) {
+        if (bgr.cols != w_ || bgr.rows != h_) throw std::runtime_error("RegionFilter: frame size changed");
+        int threads = (args.mode == Mode::CPU_MT) ? args.threads : 1;
+        cv::Mat view = bgr(src_); // no copy
+
+        for (size_t k = 0; k < levels_.size(); k++) {
+            RegionLevel& l = levels_[k];
+            const cv::Mat* in = &view;
+            if (scaled_) {
+                TraceSpan s("downsample", "stage");
+                if (k == 0) grayscale_downsample(view, l.gray, scale_, threads, l.ws);
+                else downsample2_gray(levels_[k - 1].gray, l.gray, threads, l.ws);
+                l.down.add(s.end());
+                in = &l.gray;
+            }
+            StageTimes t;
+            processFrame(*in, l.buf, l.ws, args, t);
+            l.stats.add(t);
+        }
+    }
+
+    int levels() const { return (int)levels_.size(); }
+    RegionLevel& level(int k) { return levels_[k]; }
+
+    void print() {
+        uint64_t srcPixels = (uint64_t)w_ * h_;
+        uint64_t filtered = 0;
+        for (const RegionLevel& l : levels_) filtered += (uint64_t)l.area.width * l.area.height;
+        std::cout << "  region:    roi " << roi_.x << "," << roi_.y << " " << roi_.width << "x" << roi_.height
+                  << ", reads " << src_.width << "x" << src_.height << " at " << src_.x << "," << src_.y
+                  << " (" << 100.0 * (double)src_.width * src_.height / (double)srcPixels << "% of the source)\n";
+        std::cout << "    filtered: " << filtered << " px over " << levels_.size() << " level(s) ("
+                  << 100.0 * (double)filtered / (double)srcPixels << "% of one full-res frame)\n";
+        for (size_t k = 0; k < levels_.size(); k++) {
+            RegionLevel& l = levels_[k];
+            std::cout << "  level " << k << " (1/" << l.factor << "): " << l.area.width << "x" << l.area.height
+                      << " filtered -> " << l.roi.width << "x" << l.roi.height << " out\n";
+            printGraphPlan(l.buf.graph);
+            if (l.down.count()) {
+                std::cout << "  avg downsample: " << l.down.mean() << " ms  (p99 " << l.down.percentile(0.99)
+                          << ")\n";
+            }
+            printStageStats(l.stats, l.buf.graph);
+        }
+    }
+
+private:
+    int w_ = 0, h_ = 0;
+    int scale_ = 1;
+    bool scaled_ = false;
+    cv::Rect roi_;  // in source pixels
+    cv::Rect src_;  // source pixels read
+    std::vector<RegionLevel> levels_;
+};
+
+// One level: args.outPath; a pyramid: <out>_l<k>.<ext> per level
+std::string levelPath(const Args& args, int k) {
+    if (args.pyramidLevels <= 1) return args.outPath;
+    return suffixedPath(args.outPath, "_l" + std::to_string(k));
+}
+
+} // namespace
+
+void Pipeline::runImageRegion(const Args& args) {
+    cv::Mat bgr = loadImage(args);
+    if (bgr.empty()) throw std::runtime_error("Failed to load image: " + args.imagePath);
+    if (args.mode == Mode::GPU) {
+        throw std::runtime_error("GPU mode not available on this machine (CUDA requires NVIDIA).");
+    }
+
+    RegionFilter region;
+    region.setup(args, bgr.cols, bgr.rows);
+
+    Timer total;
+    region.process(bgr, args);
+    double computeMs = total.ms();
+
+    for (int k = 0; k < region.levels(); k++) {
+        std::string path = levelPath(args, k);
+        if (!cv::imwrite(path, region.level(k).out)) throw std::runtime_error("Failed to write output: " + path);
+    }
+
+    printRunHeader("IMAGE", bgr.cols, bgr.rows, args);
+    region.print();
+    std::cout << "  compute:   " << computeMs << " ms\n";
+    printPoolStats(region.level(0).ws);
+}
+
+void Pipeline::runVideoRegion(const Args& args) {
+    cv::VideoCapture cap;
+    int w = 0, h = 0;
+    double fpsIn = 0.0;
+    openVideoInput(args, cap, w, h, fpsIn);
+
+    RegionFilter region;
+    region.setup(args, w, h);
+
+    // One writer per level, each the size of that level's ROI
+    std::vector<cv::VideoWriter> writers(region.levels());
+    std::vector<cv::Mat> edgesBgr(region.levels());
+    for (int k = 0; k < region.levels(); k++) {
+        const cv::Rect& roi = region.level(k).roi;
+        openVideoWriter(writers[k], levelPath(args, k), fpsIn, roi.width, roi.height);
+        createFrame(edgesBgr[k], PixelFormat::BGR8, roi.width, roi.height, region.level(k).ws);
+    }
+
+    cv::Mat frame;
+    StageStats& io = region.level(0).stats; // decode / encode / latency
+    int frames = 0;
+
+    traceNameThread("main");
+    Timer total;
+
+    while (true) {
+        Timer age;
+        {
+            TraceSpan s("decode", "io");
+            bool ok = cap.read(frame);
+            double ms = s.end();
+            if (!ok) break;
+            io.decode.add(ms);
+        }
+        traceSetFrame(frames);
+        frames++;
+
+        region.process(frame, args);
+
+        {
+            TraceSpan s("encode", "io");
+            for (int k = 0; k < region.levels(); k++) {
+                writers[k].write(writerFrame(region.level(k).out, edgesBgr[k]));
+            }
+            io.encode.add(s.end());
+        }
+        io.latency.add(age.ms());
+
+        if (frames % 60 == 0) {
+            std::cout << "frame " << frames << " processed\n";
+        }
+    }
+    traceSetFrame(-1);
+
+    double totalMs = total.ms();
+    double fpsOut = (totalMs > 0) ? (frames / (totalMs / 1000.0)) : 0.0;
+
+    printRunHeader("VIDEO", w, h, args);
+    std::cout << "  frames:    " << frames << "\n";
+    region.print();
+    std::cout << "  total:     " << totalMs << " ms\n";
+    std::cout << "  avg FPS:   " << fpsOut << "\n";
+    printPoolStats(region.level(0).ws);
+}
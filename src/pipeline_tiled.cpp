@@ -0,0 +1,184 @@
+#include "pipeline.hpp"
+#include "frame_ops.hpp"
+#include "raw_io.hpp"
+#include "utils.hpp"
+#include "trace.hpp"
+
+#include <opencv2/opencv.hpp>
+#include <sys/resource.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+/*
+Out-of-core image: process a huge PGM/PPM (or raw gray) in row bands.
+
+runImage decodes the whole image and then holds gray, blurred, edges
+and the blur's int tmp for all of it: ~10 bytes per pixel, so a
+gigapixel scan doesn't fit. Here input and output files are memory
+mapped and the image goes through the filter graph one band of rows at
+a time:
+
+  band k covers output rows [y0, y1)
+  its input is rows [y0 - halo, y1 + halo), clamped to the image
+  (halo = the graph's total: blur radius + 1 for Sobel)
+
+The filters clamp at the band's own top/bottom, which is wrong near a
+band edge that isn't an image edge -- but only within `halo` rows of it,
+and those rows are exactly the ones thrown away. Rows [y0, y1) see the
+same input pixels as in the full image, so the output is bit-identical
+to the in-memory path. Bands span the full width, so columns need no
+halo at all.
+
+Once a band is done, the input rows no later band needs and the output
+rows just written are dropped from the process (MappedFile::release),
+so peak RSS is a few bands, whatever the image size.
+*/
+
+namespace {
+
+// Peak resident set size of this process, in MB
+double peakRssMb() {
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return 0.0;
+#ifdef __APPLE__
+    return ru.ru_maxrss / (1024.0 * 1024.0); // bytes
+#else
+    return ru.ru_maxrss / 1024.0; // KB
+#endif
+}
+
+// PPM stores RGB; the filters (like imread's output) expect BGR
+void rgbToBgrRows(const uint8_t* src, cv::Mat& dst) {
+    size_t rowBytes = (size_t)dst.cols * 3;
+    for (int y = 0; y < dst.rows; y++) {
+        const uint8_t* s = src + y * rowBytes;
+        uint8_t* d = dst.ptr<uint8_t>(y);
+        for (int x = 0; x < dst.cols; x++) {
+            d[3 * x + 0] = s[3 * x + 2];
+            d[3 * x + 1] = s[3 * x + 1];
+            d[3 * x + 2] = s[3 * x + 0];
+        }
+    }
+}
+
+} // namespace
+
+void Pipeline::runImageTiled(const Args& args) {
+    if (args.mode == Mode::GPU) {
+        throw std::runtime_error("GPU mode not available on this machine (CUDA requires NVIDIA).");
+    }
+
+    // --- input: mapped, never read as a whole ---
+    MappedFile in;
+    in.open(args.imagePath);
+    int w = 0, h = 0, channels = 1;
+    size_t inOffset = 0;
+    RawFormat rawIn;
+    if (resolveRawFormat(args.inFormat, args.imagePath, rawIn)) {
+        if (rawIn != RawFormat::GRAY) throw std::runtime_error("Tiled: raw input must be gray (--raw-size WxH)");
+        w = args.rawWidth;
+        h = args.rawHeight;
+        if (w <= 0 || h <= 0) throw std::runtime_error("Raw gray input needs --raw-size WxH");
+        if (in.size() < (size_t)w * h) throw std::runtime_error("Tiled: raw input smaller than --raw-size");
+    } else {
+        PnmHeader hdr = parsePnmHeader(in.data(), in.size());
+        w = hdr.w;
+        h = hdr.h;
+        channels = hdr.channels;
+        inOffset = hdr.dataOffset;
+    }
+    size_t inRowBytes = (size_t)w * channels;
+
+    CpuWorkspace ws;
+    if (args.mode == Mode::CPU_MT) ws.ensureThreads(args.threads);
+    FrameBuffers buf;
+    buf.graph = buildGraph(args, channels == 3 ? PixelFormat::BGR8 : PixelFormat::GRAY8);
+    if (buf.graph.outputFormat() != PixelFormat::GRAY8) throw std::runtime_error("Tiled: the filter chain must end gray");
+    if (!buf.graph.local()) throw std::runtime_error("Tiled: the filter chain must be local (no canny)");
+    int halo = buf.graph.totalHalo();
+
+    int bandRows = tiledBandRows(args, w, h);
+
+    // --- output: PGM unless the path/format says raw gray ---
+    RawFormat rawOutFmt;
+    bool rawOut = resolveRawFormat(args.outFormat, args.outPath, rawOutFmt);
+    if (rawOut && rawOutFmt != RawFormat::GRAY) throw std::runtime_error("Tiled: output must be PGM or raw gray");
+    std::string header = rawOut ? std::string() : pgmHeader(w, h);
+    MappedFile out;
+    out.create(args.outPath, header.size() + (size_t)w * h);
+    std::memcpy(out.writableData(), header.data(), header.size());
+    uint8_t* outPixels = out.writableData() + header.size();
+
+    cv::Mat bandBgr; // PPM only: the band's rows converted RGB -> BGR
+    StageStats stats;
+    size_t inReleased = 0, outReleased = 0;
+    int bands = 0;
+
+    Timer total;
+
+    for (int y0 = 0; y0 < h; y0 += bandRows) {
+        int y1 = std::min(h, y0 + bandRows);
+        int a = std::max(0, y0 - halo);
+        int b = std::min(h, y1 + halo);
+        traceSetFrame(bands++);
+
+        // Band input: a view straight into the mapping (gray), or a BGR copy (PPM)
+        cv::Mat bandIn;
+        {
+            TraceSpan s("load", "io");
+            const uint8_t* src = in.data() + inOffset + (size_t)a * inRowBytes;
+            if (channels == 1) {
+                bandIn = cv::Mat(b - a, w, CV_8UC1, const_cast<uint8_t*>(src));
+            } else {
+                bandBgr.create(b - a, w, CV_8UC3);
+                rgbToBgrRows(src, bandBgr);
+                bandIn = bandBgr;
+            }
+            stats.decode.add(s.end());
+        }
+
+        StageTimes t;
+        processFrame(bandIn, buf, ws, args, t);
+        stats.add(t);
+
+        {
+            TraceSpan s("store", "io");
+            // Keep only rows [y0, y1): the rest of the band is halo
+            for (int y = y0; y < y1; y++) {
+                std::memcpy(outPixels + (size_t)y * w, buf.edges.ptr<uint8_t>(y - a), (size_t)w);
+            }
+            stats.encode.add(s.end());
+        }
+
+        // Rows before the next band's halo are never read again; output rows are final
+        size_t inDone = inOffset + (size_t)std::max(0, y1 - halo) * inRowBytes;
+        if (inDone > inReleased) {
+            in.release(inReleased, inDone - inReleased);
+            inReleased = inDone;
+        }
+        size_t outDone = header.size() + (size_t)y1 * w;
+        out.release(outReleased, outDone - outReleased);
+        outReleased = outDone;
+    }
+    traceSetFrame(-1);
+    {
+        TraceSpan s("flush", "io");
+        out.close();
+    }
+    double totalMs = total.ms();
+
+    printRunHeader("TILED", w, h, args);
+    std::cout << "  tiles:     " << bands << " bands of " << bandRows << " rows (+" << halo
+              << " halo rows each side)\n";
+    printGraphPlan(buf.graph);
+    printStageStats(stats, buf.graph);
+    std::cout << "  total:     " << totalMs << " ms";
+    if (totalMs > 0) std::cout << " (" << (double)w * h / 1e6 / (totalMs / 1000.0) << " MP/s)";
+    std::cout << "\n";
+    std::cout << "  peak RSS:  " << peakRssMb() << " MB (image is "
+              << (double)w * h * channels / (1024.0 * 1024.0) << " MB)\n";
+    printPoolStats(ws);
+}
@@ -0,0 +1,199 @@
+#include "pipeline.hpp"
+#include "frame_ops.hpp"
+#include "spsc_queue.hpp"
+#include "utils.hpp"
+#include "trace.hpp"
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+Pipelined video: decode, compute and encode run at the same time.
+
+In runVideo one thread does read -> filters -> cvtColor -> write in
+sequence, so while OpenCV decodes or encodes the filter cores sit idle
+and FPS is bounded by the SUM of all stages. Here:
+
+  decoder thread :  freeQ -> cap.read -> decodedQ
+  main thread    :  decodedQ -> filters (+ pool workers) -> processedQ
+  encoder thread :  processedQ -> cvtColor + writer.write -> freeQ
+
+and FPS is bounded by the SLOWEST stage instead.
+
+Frames live in a fixed array of slots allocated up front; the queues only
+carry slot indices, and the encoder hands each slot back to the decoder
+through freeQ. So after warm-up nothing is allocated per frame.
+A slot index of -1 means "end of stream".
+*/
+
+namespace {
+
+// One frame in flight
+struct FrameSlot {
+    cv::Mat frame;    // decoded BGR (cap.read reuses the buffer)
+    cv::Mat edges;    // filter output
+    cv::Mat edgesBgr; // encoder's 3-channel copy
+    int64_t seq = 0;  // frame number in the video
+    Timer age;        // started just before decode -> per-frame latency
+};
+
+const int kEndOfStream = -1;
+
+// Runs fn; on exception remembers the first error and tells everyone to stop
+template <typename Fn>
+void guarded(Fn&& fn, std::atomic<bool>& abort, std::exception_ptr& error, std::mutex& m) {
+    try {
+        fn();
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(m);
+        if (!error) error = std::current_exception();
+        abort = true;
+    }
+}
+
+void printQueue(const char* name, const char* producer, const char* consumer,
+                const SpscQueue<int>& q) {
+    const QueueStats& s = q.stats();
+    std::cout << "    " << name << ": avg occupancy " << s.avgOccupancy() << "/" << q.capacity()
+              << ", " << producer << " blocked (full) " << s.fullStalls << "x / " << s.fullWaitMs << " ms"
+              << ", " << consumer << " starved (empty) " << s.emptyStalls << "x / " << s.emptyWaitMs << " ms\n";
+}
+
+} // namespace
+
+void Pipeline::runVideoPipelined(const Args& args) {
+    cv::VideoCapture cap;
+    cv::VideoWriter writer;
+    int w = 0, h = 0;
+    double fpsIn = 0.0;
+    openVideoIO(args, cap, writer, w, h, fpsIn);
+
+    // depth frames can wait in each queue, plus one in the hands of each stage
+    int depth = std::max(1, args.queueDepth);
+    int nSlots = 2 * depth + 3;
+
+    // Pre-allocate every slot (VERY IMPORTANT: no per-frame allocation)
+    PixelFormat outFmt = buildGraph(args).outputFormat();
+    std::vector<FrameSlot> slots(nSlots);
+    for (FrameSlot& s : slots) {
+        s.frame.create(h, w, CV_8UC3);
+        createFrame(s.edges, outFmt, w, h);
+        s.edgesBgr.create(h, w, CV_8UC3);
+    }
+
+    SpscQueue<int> freeQ(nSlots);     // encoder -> decoder (recycled slots)
+    SpscQueue<int> decodedQ(depth);   // decoder -> compute
+    SpscQueue<int> processedQ(depth); // compute -> encoder
+    for (int i = 0; i < nSlots; i++) freeQ.tryPush(i);
+
+    // Compute-stage buffers (intermediates are only needed inside compute)
+    CpuWorkspace ws;
+    if (args.mode == Mode::CPU_MT) ws.ensureThreads(args.threads);
+    FrameBuffers buf;
+    buf.setup(args, w, h, ws);
+
+    std::atomic<bool> abort{false};
+    std::exception_ptr error;
+    std::mutex errorMutex;
+
+    // Each field is written by exactly one stage thread, read after the joins
+    StageStats stats;
+    int frames = 0;
+
+    traceNameThread("compute");
+    Timer total;
+
+    // --- Stage A: decode ---
+    std::thread decoder([&] {
+        traceNameThread("decoder");
+        guarded([&] {
+            int s;
+            int64_t seq = 0;
+            while (freeQ.pop(s, abort)) {
+                slots[s].age.reset();
+                slots[s].seq = seq;
+                traceSetFrame(seq++);
+                TraceSpan span("decode", "io");
+                bool ok = cap.read(slots[s].frame);
+                double ms = span.end();
+                if (!ok) {
+                    decodedQ.push(kEndOfStream, abort);
+                    return;
+                }
+                stats.decode.add(ms);
+                if (!decodedQ.push(s, abort)) return;
+            }
+        }, abort, error, errorMutex);
+    });
+
+    // --- Stage C: encode ---
+    std::thread encoder([&] {
+        traceNameThread("encoder");
+        guarded([&] {
+            int s;
+            while (processedQ.pop(s, abort)) {
+                if (s == kEndOfStream) return;
+                traceSetFrame(slots[s].seq);
+                TraceSpan span("encode", "io");
+                // Convert edges (1 channel) -> BGR so writer accepts it (--color: already BGR)
+                writer.write(writerFrame(slots[s].edges, slots[s].edgesBgr));
+                stats.encode.add(span.end());
+                stats.latency.add(slots[s].age.ms());
+                if (!freeQ.push(s, abort)) return;
+            }
+        }, abort, error, errorMutex);
+    });
+
+    // --- Stage B: compute (this thread + the pool's workers) ---
+    guarded([&] {
+        int s;
+        while (decodedQ.pop(s, abort)) {
+            if (s == kEndOfStream) {
+                processedQ.push(kEndOfStream, abort);
+                return;
+            }
+
+            // Filter straight into the slot's edges (header copy, same buffer)
+            buf.edges = slots[s].edges;
+            traceSetFrame(slots[s].seq);
+            StageTimes t;
+            processFrame(slots[s].frame, buf, ws, args, t);
+            stats.add(t);
+            frames++;
+
+            if (!processedQ.push(s, abort)) return;
+
+            // Print occasional progress
+            if (frames % 60 == 0) {
+                std::cout << "frame " << frames << " processed\n";
+            }
+        }
+    }, abort, error, errorMutex);
+
+    decoder.join();
+    encoder.join();
+    if (error) std::rethrow_exception(error);
+
+    double totalMs = total.ms();
+    double fpsOut = (totalMs > 0) ? (frames / (totalMs / 1000.0)) : 0.0;
+    traceSetFrame(-1);
+
+    printRunHeader("VIDEO", w, h, args);
+    printGraphPlan(buf.graph);
+    std::cout << "  frames:    " << frames << "\n";
+    printStageStats(stats, buf.graph);
+    std::cout << "  total:     " << totalMs << " ms\n";
+    std::cout << "  avg FPS:   " << fpsOut << "\n";
+    std::cout << "  queues (depth " << depth << ", " << nSlots << " frame slots):\n";
+    printQueue("free     ", "encoder", "decoder", freeQ);
+    printQueue("decoded  ", "decoder", "compute", decodedQ);
+    printQueue("processed", "compute", "encoder", processedQ);
+    printPoolStats(ws);
+}
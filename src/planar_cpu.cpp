@@ -0,0 +1,134 @@
+#include "filters_cpu.hpp"
+#include "row_kernels.hpp"
+#include "blur_narrow.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+/*
+Colour filtering on planar frames.
+
+A planar frame is one CV_8UC1 Mat of 3h rows: the B plane (rows [0, h)),
+then G, then R. Every plane is a contiguous gray frame, so the gray row
+kernels (SIMD Sobel, uint16 narrow blur) run on it unchanged -- on
+interleaved BGR the same filters would be three strided scalar loops.
+
+The frame is split into planes once (bgr_to_planar), filtered, and
+interleaved again once at the end (planar_to_bgr).
+
+Each filter is ONE parallel pass over all 3h rows rather than three
+gray calls, so the pool is woken once per pass and the last band of one
+plane and the first of the next can run at the same time. Rows only
+ever look at neighbours in their own plane (clamped at the plane's
+top/bottom), so the result is exactly the gray filter applied per channel.
+*/
+
+namespace {
+
+void checkPlanar(const cv::Mat& planar, const char* who) {
+    if (planar.empty()) throw std::runtime_error(std::string(who) + ": input empty");
+    if (planar.type() != CV_8UC1 || planar.rows % 3 != 0) {
+        throw std::runtime_error(std::string(who) + ": expected a planar frame (CV_8UC1, 3 stacked planes)");
+    }
+}
+
+// fn(y0, y1, tid) on the pool, or on the caller's thread when threads == 1
+void forRows(int rows, int threads, CpuWorkspace& ws, const ThreadPool::RangeFn& fn) {
+    if (threads > 1) ws.ensureThreads(threads).parallel_for(0, rows, fn);
+    else fn(0, rows, 0);
+}
+
+} // namespace
+
+void bgr_to_planar(const cv::Mat& bgr, cv::Mat& planar, int threads, CpuWorkspace& ws) {
+    if (bgr.empty()) throw std::runtime_error("bgr_to_planar: input empty");
+    if (bgr.type() != CV_8UC3) throw std::runtime_error("bgr_to_planar: expected CV_8UC3");
+
+    int w = bgr.cols;
+    int h = bgr.rows;
+    planar.create(3 * h, w, CV_8UC1);
+
+    forRows(h, threads, ws, [&](int y0, int y1, int) {
+        for (int y = y0; y < y1; y++) {
+            deinterleave_row(bgr.ptr<uint8_t>(y), planar.ptr<uint8_t>(y),
+                             planar.ptr<uint8_t>(h + y), planar.ptr<uint8_t>(2 * h + y), w);
+        }
+    });
+}
+
+void planar_to_bgr(const cv::Mat& planar, cv::Mat& bgr, int threads, CpuWorkspace& ws) {
+    checkPlanar(planar, "planar_to_bgr");
+
+    int w = planar.cols;
+    int h = planar.rows / 3;
+    bgr.create(h, w, CV_8UC3);
+
+    forRows(h, threads, ws, [&](int y0, int y1, int) {
+        for (int y = y0; y < y1; y++) {
+            interleave_row(planar.ptr<uint8_t>(y), planar.ptr<uint8_t>(h + y),
+                           planar.ptr<uint8_t>(2 * h + y), bgr.ptr<uint8_t>(y), w);
+        }
+    });
+}
+
+void box_blur_planar(const cv::Mat& planar, cv::Mat& blurred, int radius, int threads, CpuWorkspace& ws) {
+    checkPlanar(planar, "box_blur_planar");
+    if (radius < 1) throw std::runtime_error("box_blur_planar: radius must be >= 1");
+
+    int w = planar.cols;
+    int rows = planar.rows;
+    int h = rows / 3;
+    blurred.create(rows, w, CV_8UC1);
+
+    // Wide radius: the int path, one plane at a time
+    if (radius > kBlurNarrowMaxRadius) {
+        for (int c = 0; c < 3; c++) {
+            cv::Mat in = planar.rowRange(c * h, (c + 1) * h);
+            cv::Mat out = blurred.rowRange(c * h, (c + 1) * h);
+            if (threads > 1) box_blur_cpu_fast_mt_ws(in, out, radius, threads, ws);
+            else box_blur_cpu_fast_ws(in, out, radius, ws);
+        }
+        return;
+    }
+
+    // Horizontal sums never cross rows, so the stacked planes are one pass
+    ws.ensureSize(w, rows, true);
+    ws.ensureColSums(threads > 1 ? ws.ensureThreads(threads).size() : 1);
+    uint16_t* tmp = ws.tmp16.data();
+
+    forRows(rows, threads, ws, [&](int y0, int y1, int) {
+        blur_hpass_u16(planar, tmp, radius, y0, y1);
+    });
+
+    // Vertical pass: a band may straddle planes -> split it per plane
+    forRows(rows, threads, ws, [&](int y0, int y1, int tid) {
+        for (int c = 0; c < 3; c++) {
+            int a = std::max(y0, c * h);
+            int b = std::min(y1, (c + 1) * h);
+            if (a >= b) continue;
+            cv::Mat out = blurred.rowRange(c * h, (c + 1) * h);
+            blur_vpass_u16(tmp + (size_t)c * h * w, w, h, out, radius, a - c * h, b - c * h,
+                           &ws.colSums[(size_t)tid * w]);
+        }
+    });
+}
+
+void sobel_planar(const cv::Mat& planar, cv::Mat& edges, int threads, CpuWorkspace& ws, SobelNorm norm) {
+    checkPlanar(planar, "sobel_planar");
+
+    int w = planar.cols;
+    int h = planar.rows / 3;
+    edges.create(planar.rows, w, CV_8UC1);
+
+    forRows(planar.rows, threads, ws, [&](int y0, int y1, int) {
+        for (int y = y0; y < y1; y++) {
+            // Neighbour rows clamp to this row's plane, not the stacked frame
+            int top = (y / h) * h;
+            sobel_row(planar.ptr<uint8_t>(std::max(y - 1, top)),
+                      planar.ptr<uint8_t>(y),
+                      planar.ptr<uint8_t>(std::min(y + 1, top + h - 1)),
+                      edges.ptr<uint8_t>(y), w, norm);
+        }
+    });
+}
@@ -0,0 +1,409 @@
+#include "raw_io.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+const char* rawFormatName(RawFormat f) {
+    switch (f) {
+        case RawFormat::Y4M:  return "y4m";
+        case RawFormat::GRAY: return "gray";
+    }
+    return "unknown";
+}
+
+RawFormat parseRawFormat(const std::string& s) {
+    if (s == "y4m")  return RawFormat::Y4M;
+    if (s == "gray") return RawFormat::GRAY;
+    throw std::runtime_error("Unknown raw format: " + s + " (expected y4m or gray)");
+}
+
+bool rawFormatFromPath(const std::string& path, RawFormat& f) {
+    size_t dot = path.rfind('.');
+    if (dot == std::string::npos) return false;
+    std::string ext = path.substr(dot);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    if (ext == ".y4m") {
+        f = RawFormat::Y4M;
+        return true;
+    }
+    if (ext == ".gray" || ext == ".y" || ext == ".raw") {
+        f = RawFormat::GRAY;
+        return true;
+    }
+    return false;
+}
+
+bool resolveRawFormat(const std::string& flag, const std::string& path, RawFormat& f) {
+    if (!flag.empty()) {
+        f = parseRawFormat(flag);
+        return true;
+    }
+    return rawFormatFromPath(path, f);
+}
+
+// ---------- MappedFile ----------
+
+MappedFile::~MappedFile() {
+    try {
+        close();
+    } catch (const std::exception&) {
+        // Can't report from a destructor; call close() to see flush errors
+    }
+}
+
+void MappedFile::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Failed to open: " + path);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        throw std::runtime_error("Empty or unreadable file: " + path);
+    }
+    void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps the file alive
+    if (p == MAP_FAILED) throw std::runtime_error("Failed to mmap: " + path);
+
+    // Frames are consumed front to back: let the kernel read ahead aggressively
+    madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+    data_ = static_cast<uint8_t*>(p);
+    size_ = (size_t)st.st_size;
+    writable_ = false;
+}
+
+void MappedFile::create(const std::string& path, size_t size) {
+    close();
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) throw std::runtime_error("Failed to create: " + path);
+    if (ftruncate(fd, (off_t)size) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Failed to size output file: " + path);
+    }
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) throw std::runtime_error("Failed to mmap for writing: " + path);
+
+    data_ = static_cast<uint8_t*>(p);
+    size_ = size;
+    writable_ = true;
+}
+
+void MappedFile::close() {
+    if (!data_) return;
+    bool ok = !writable_ || msync(data_, size_, MS_SYNC) == 0;
+    munmap(data_, size_);
+    data_ = nullptr;
+    size_ = 0;
+    writable_ = false;
+    if (!ok) throw std::runtime_error("Failed to flush mapped output");
+}
+
+void MappedFile::release(size_t offset, size_t n) {
+    if (!data_ || n == 0) return;
+    // Only whole pages: round the start up and the end down
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t begin = (offset + page - 1) / page * page;
+    size_t end = std::min(offset + n, size_) / page * page;
+    if (end <= begin) return;
+    if (writable_) msync(data_ + begin, end - begin, MS_ASYNC);
+    madvise(data_ + begin, end - begin, MADV_DONTNEED);
+}
+
+// ---------- PNM ----------
+
+PnmHeader parsePnmHeader(const uint8_t* data, size_t size) {
+    size_t pos = 0;
+    // Next whitespace-separated number, skipping '#' comments
+    auto number = [&]() -> int {
+        while (pos < size) {
+            if (data[pos] == '#') {
+                while (pos < size && data[pos] != '\n') pos++;
+            } else if (std::isspace(data[pos])) {
+                pos++;
+            } else {
+                break;
+            }
+        }
+        if (pos >= size || !std::isdigit(data[pos])) throw std::runtime_error("PNM: bad header");
+        long v = 0;
+        while (pos < size && std::isdigit(data[pos])) {
+            v = v * 10 + (data[pos++] - '0');
+            if (v > (1L << 30)) throw std::runtime_error("PNM: header value too large");
+        }
+        return (int)v;
+    };
+
+    if (size < 2 || data[0] != 'P' || (data[1] != '5' && data[1] != '6')) {
+        throw std::runtime_error("Not a binary PGM/PPM (P5/P6) file");
+    }
+    PnmHeader hdr;
+    hdr.channels = (data[1] == '6') ? 3 : 1;
+    pos = 2;
+    hdr.w = number();
+    hdr.h = number();
+    int maxval = number();
+    if (maxval != 255) throw std::runtime_error("PNM: only 8-bit (maxval 255) is supported");
+    pos++; // the single whitespace byte before the pixels
+    hdr.dataOffset = pos;
+
+    size_t need = (size_t)hdr.w * hdr.h * hdr.channels;
+    if (hdr.w <= 0 || hdr.h <= 0 || size < pos || size - pos < need) {
+        throw std::runtime_error("PNM: file is smaller than its header says");
+    }
+    return hdr;
+}
+
+std::string pgmHeader(int w, int h) {
+    return "P5\n" + std::to_string(w) + " " + std::to_string(h) + "\n255\n";
+}
+
+// ---------- reader ----------
+
+RawFrameReader::~RawFrameReader() {
+    if (pipe_ && pipe_ != stdin) std::fclose(pipe_);
+}
+
+bool RawFrameReader::readLine(std::string& line) {
+    line.clear();
+    if (mapped()) {
+        if (pos_ >= file_.size()) return false;
+        const uint8_t* start = file_.data() + pos_;
+        const void* nl = std::memchr(start, '\n', file_.size() - pos_);
+        if (!nl) throw std::runtime_error("Y4M: header line without newline");
+        size_t n = (size_t)(static_cast<const uint8_t*>(nl) - start);
+        line.assign(reinterpret_cast<const char*>(start), n);
+        pos_ += n + 1;
+        return true;
+    }
+    int c;
+    while ((c = std::getc(pipe_)) != EOF && c != '\n') line.push_back((char)c);
+    if (c == EOF && line.empty()) return false;
+    if (c == EOF) throw std::runtime_error("Y4M: header line without newline");
+    return true;
+}
+
+void RawFrameReader::parseY4mHeader(const std::string& line) {
+    std::istringstream ss(line);
+    std::string tok;
+    ss >> tok;
+    if (tok != "YUV4MPEG2") throw std::runtime_error("Not a YUV4MPEG2 stream");
+
+    std::string chroma = "420";
+    while (ss >> tok) {
+        char tag = tok[0];
+        std::string v = tok.substr(1);
+        if (tag == 'W') w_ = std::stoi(v);
+        else if (tag == 'H') h_ = std::stoi(v);
+        else if (tag == 'C') chroma = v;
+        else if (tag == 'F') {
+            size_t colon = v.find(':');
+            if (colon != std::string::npos) {
+                fpsNum_ = std::stoi(v.substr(0, colon));
+                fpsDen_ = std::max(1, std::stoi(v.substr(colon + 1)));
+            }
+        }
+        // I (interlacing), A (aspect), X (comments) don't matter here
+    }
+    if (w_ <= 0 || h_ <= 0) throw std::runtime_error("Y4M: missing W/H in header");
+
+    // Only 8-bit layouts: the Y plane is then exactly w*h bytes
+    size_t cw = ((size_t)w_ + 1) / 2;
+    size_t ch = ((size_t)h_ + 1) / 2;
+    if (chroma.compare(0, 3, "420") == 0 && chroma.find("p1") == std::string::npos) chromaBytes_ = 2 * cw * ch;
+    else if (chroma == "422") chromaBytes_ = 2 * cw * (size_t)h_;
+    else if (chroma == "444") chromaBytes_ = 2 * (size_t)w_ * h_;
+    else if (chroma == "mono") chromaBytes_ = 0;
+    else throw std::runtime_error("Y4M: unsupported colour space C" + chroma + " (8-bit 420/422/444/mono only)");
+}
+
+void RawFrameReader::open(const std::string& path, RawFormat fmt, int w, int h) {
+    fmt_ = fmt;
+    w_ = w;
+    h_ = h;
+    pos_ = 0;
+    bytes_ = 0;
+    chromaBytes_ = 0;
+
+    if (path == "-") {
+        pipe_ = stdin;
+        file_.close();
+    } else {
+        file_.open(path);
+    }
+
+    if (fmt_ == RawFormat::Y4M) {
+        std::string line;
+        if (!readLine(line)) throw std::runtime_error("Y4M: empty stream: " + path);
+        parseY4mHeader(line);
+    } else if (w_ <= 0 || h_ <= 0) {
+        throw std::runtime_error("Raw gray input needs --raw-size WxH");
+    }
+
+    if (!mapped()) {
+        luma_.resize((size_t)w_ * h_);
+        skip_.resize(chromaBytes_);
+    }
+}
+
+bool RawFrameReader::next(cv::Mat& gray) {
+    size_t luma = (size_t)w_ * h_;
+
+    if (fmt_ == RawFormat::Y4M) {
+        std::string line;
+        if (!readLine(line)) return false;
+        if (line.compare(0, 5, "FRAME") != 0) throw std::runtime_error("Y4M: expected FRAME marker");
+    }
+
+    if (mapped()) {
+        if (pos_ >= file_.size()) return false;
+        if (file_.size() - pos_ < luma + chromaBytes_) throw std::runtime_error("Raw input: truncated frame");
+        // Zero copy: the Mat header points into the mapping (read-only; filters never write their input)
+        gray = cv::Mat(h_, w_, CV_8UC1, const_cast<uint8_t*>(file_.data() + pos_));
+        pos_ += luma + chromaBytes_;
+    } else {
+        size_t n = std::fread(luma_.data(), 1, luma, pipe_);
+        if (n == 0 && fmt_ == RawFormat::GRAY) return false;
+        if (n != luma) throw std::runtime_error("Raw input: truncated frame");
+        if (chromaBytes_ && std::fread(skip_.data(), 1, chromaBytes_, pipe_) != chromaBytes_) {
+            throw std::runtime_error("Raw input: truncated frame");
+        }
+        gray = cv::Mat(h_, w_, CV_8UC1, luma_.data());
+    }
+    bytes_ += luma + chromaBytes_;
+    return true;
+}
+
+// ---------- writer ----------
+
+namespace {
+
+// path "-" = stdout, else a new file. Files get ioBuf (bufBytes) as their
+// stdio buffer. stdout keeps its own: it outlives the writer (and ioBuf),
+// and is flushed again at exit. Whole-frame fwrites bypass its small
+// buffer anyway.
+std::FILE* openOutputFile(const std::string& path, size_t bufBytes, std::vector<char>& ioBuf, bool& owns) {
+    if (path == "-") {
+        owns = false;
+        return stdout;
+    }
+    std::FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) throw std::runtime_error("Failed to open for writing: " + path);
+    owns = true;
+    ioBuf.resize(bufBytes);
+    std::setvbuf(f, ioBuf.data(), _IOFBF, ioBuf.size());
+    return f;
+}
+
+} // namespace
+
+RawFrameWriter::~RawFrameWriter() {
+    if (f_) {
+        std::fflush(f_);
+        if (ownsFile_) std::fclose(f_);
+    }
+}
+
+void RawFrameWriter::open(const std::string& path, RawFormat fmt, int w, int h, int fpsNum, int fpsDen) {
+    fmt_ = fmt;
+    w_ = w;
+    h_ = h;
+    bytes_ = 0;
+
+    // A few frames of buffering: one large write() per frame or so
+    f_ = openOutputFile(path, std::max<size_t>((size_t)1 << 16, 2 * (size_t)w * h), ioBuf_, ownsFile_);
+
+    if (fmt_ == RawFormat::Y4M) {
+        std::string hdr = "YUV4MPEG2 W" + std::to_string(w) + " H" + std::to_string(h) +
+                          " F" + std::to_string(fpsNum) + ":" + std::to_string(fpsDen) +
+                          " Ip A1:1 Cmono\n";
+        put(hdr.data(), hdr.size());
+    }
+}
+
+void RawFrameWriter::put(const void* p, size_t n) {
+    if (std::fwrite(p, 1, n, f_) != n) throw std::runtime_error("Raw output: write failed");
+    bytes_ += n;
+}
+
+void RawFrameWriter::write(const cv::Mat& gray) {
+    if (gray.type() != CV_8UC1 || gray.cols != w_ || gray.rows != h_) {
+        throw std::runtime_error("RawFrameWriter: expected a CV_8UC1 frame of the opened size");
+    }
+    if (fmt_ == RawFormat::Y4M) put("FRAME\n", 6);
+    if (gray.isContinuous()) {
+        put(gray.ptr<uint8_t>(0), (size_t)w_ * h_);
+    } else {
+        for (int y = 0; y < h_; y++) put(gray.ptr<uint8_t>(y), (size_t)w_);
+    }
+}
+
+void RawFrameWriter::close() {
+    if (!f_) return;
+    bool ok = std::fflush(f_) == 0;
+    if (ownsFile_) ok = (std::fclose(f_) == 0) && ok;
+    f_ = nullptr;
+    if (!ok) throw std::runtime_error("Raw output: flush failed");
+}
+
+// ---------- compact edges ----------
+
+namespace {
+
+void putU32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+} // namespace
+
+EdgeFileWriter::~EdgeFileWriter() {
+    if (f_) {
+        std::fflush(f_);
+        if (ownsFile_) std::fclose(f_);
+    }
+}
+
+void EdgeFileWriter::open(const std::string& path, const EdgeEncoder& enc) {
+    bytes_ = 0;
+    f_ = openOutputFile(path, (size_t)1 << 20, ioBuf_, ownsFile_);
+
+    uint8_t hdr[16] = {'E', 'D', 'G', 'E', 1, (uint8_t)enc.format(), (uint8_t)enc.threshold(), 0};
+    putU32(hdr + 8, (uint32_t)enc.width());
+    putU32(hdr + 12, (uint32_t)enc.height());
+    put(hdr, sizeof(hdr));
+}
+
+void EdgeFileWriter::put(const void* p, size_t n) {
+    if (std::fwrite(p, 1, n, f_) != n) throw std::runtime_error("Edge output: write failed");
+    bytes_ += n;
+}
+
+void EdgeFileWriter::write(const EdgeEncoder& enc) {
+    if (enc.payloadBytes() > UINT32_MAX || enc.edgeCount() > UINT32_MAX) {
+        throw std::runtime_error("Edge output: frame too large for the container (4 GB / 2^32 edges)");
+    }
+    uint8_t rec[8];
+    putU32(rec, (uint32_t)enc.payloadBytes());
+    putU32(rec + 4, (uint32_t)enc.edgeCount());
+    put(rec, sizeof(rec));
+    for (int i = 0; i < enc.parts(); i++) {
+        const std::vector<uint8_t>& p = enc.part(i);
+        if (!p.empty()) put(p.data(), p.size());
+    }
+}
+
+void EdgeFileWriter::close() {
+    if (!f_) return;
+    bool ok = std::fflush(f_) == 0;
+    if (ownsFile_) ok = (std::fclose(f_) == 0) && ok;
+    f_ = nullptr;
+    if (!ok) throw std::runtime_error("Edge output: flush failed");
+}
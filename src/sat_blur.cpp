@@ -0,0 +1,115 @@
+#include "filters_cpu.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+/*
+Box blur at several radii from one summed-area table (integral image).
+
+box_blur_cpu_fast is O(1) per pixel per radius too, but each radius
+reruns both sliding passes over the frame. With a table
+    S[Y][X] = sum of every pixel above and left of (Y, X)
+any box sum is 4 lookups:
+    sum = S[y1][x1] - S[y0][x1] - S[y1][x0] + S[y0][x0]
+so one table build serves every radius, and each extra radius is a
+single pass that reads the table and writes the output.
+
+Borders: box_blur_cpu_fast repeats the edge pixel. The table is built
+over the frame padded by maxR repeated pixels on every side, so windows
+never leave the table and the result is bit-identical to the separable
+blur for every radius <= maxR.
+
+Overflow: S is uint32_t and is allowed to wrap. Differences are taken
+mod 2^32 too, and a real box sum (255 * (2r+1)^2) is far below 2^32,
+so the 4-lookup result is exact even when the corner values wrapped.
+
+Build, both passes split across the pool:
+  1) row prefix: each padded row independently (split by rows)
+  2) column prefix: S[Y] += S[Y-1], walking down with every thread
+     owning a strip of columns (contiguous inner loop, vectorizes)
+*/
+
+// Padded row py of the table (without the zero column) as running sums
+static void sat_row_prefix(const uint8_t* row, uint32_t* dst, int w, int pad) {
+    uint32_t run = 0;
+    uint32_t left = row[0], right = row[w - 1];
+    int x = 0;
+    for (int i = 0; i < pad; i++) dst[x++] = (run += left);
+    for (int i = 0; i < w; i++) dst[x++] = (run += row[i]);
+    for (int i = 0; i < pad; i++) dst[x++] = (run += right);
+}
+
+void box_blur_sat_multi(
+    const cv::Mat& gray,
+    std::vector<cv::Mat>& outs,
+    const std::vector<int>& radii,
+    int threads,
+    CpuWorkspace& ws
+) {
+    if (gray.empty()) throw std::runtime_error("box_blur_sat_multi: input empty");
+    if (gray.type() != CV_8UC1) throw std::runtime_error("box_blur_sat_multi: expected CV_8UC1");
+    if (radii.empty()) throw std::runtime_error("box_blur_sat_multi: no radii");
+    for (int r : radii) {
+        if (r < 1) throw std::runtime_error("box_blur_sat_multi: radius must be >= 1");
+    }
+
+    int w = gray.cols;
+    int h = gray.rows;
+    int pad = *std::max_element(radii.begin(), radii.end());
+
+    // Table: (H+1) x (W+1), row 0 and column 0 are zero
+    ws.ensureSat(w, h, pad);
+    int tw = ws.satStride;
+    int th = h + 2 * pad + 1;
+    uint32_t* S = ws.sat.data();
+
+    ThreadPool* pool = (threads > 1) ? &ws.ensureThreads(threads) : nullptr;
+    auto parallel = [&](int begin, int end, const ThreadPool::RangeFn& fn) {
+        if (pool) pool->parallel_for(begin, end, fn);
+        else fn(begin, end, 0);
+    };
+
+    // 1) Row prefix sums of the padded frame (padded row py = gray row clamp(py - pad))
+    std::fill(S, S + tw, 0u);
+    parallel(0, th - 1, [&](int y0, int y1, int) {
+        for (int py = y0; py < y1; py++) {
+            int sy = std::clamp(py - pad, 0, h - 1);
+            uint32_t* dst = S + (size_t)(py + 1) * tw;
+            dst[0] = 0;
+            sat_row_prefix(gray.ptr<uint8_t>(sy), dst + 1, w, pad);
+        }
+    });
+
+    // 2) Column prefix sums, one strip of columns per worker
+    parallel(0, tw, [&](int x0, int x1, int) {
+        for (int Y = 1; Y < th; Y++) {
+            const uint32_t* above = S + (size_t)(Y - 1) * tw;
+            uint32_t* cur = S + (size_t)Y * tw;
+            for (int x = x0; x < x1; x++) cur[x] += above[x];
+        }
+    });
+
+    // 3) Every radius from the same table, row band by row band
+    // (all radii of a band while its table rows are still in cache)
+    outs.resize(radii.size());
+    for (cv::Mat& o : outs) o.create(h, w, CV_8UC1);
+
+    parallel(0, h, [&](int y0, int y1, int) {
+        for (int y = y0; y < y1; y++) {
+            for (size_t i = 0; i < radii.size(); i++) {
+                int r = radii[i];
+                uint32_t area = (uint32_t)((2 * r + 1) * (2 * r + 1));
+                // Pixel (y, x) sits at padded (y + pad, x + pad); its window
+                // is table rows [y + pad - r, y + pad + r + 1), same for columns
+                const uint32_t* top = S + (size_t)(y + pad - r) * tw + (pad - r);
+                const uint32_t* bot = S + (size_t)(y + pad + r + 1) * tw + (pad - r);
+                int k = 2 * r + 1;
+                uint8_t* dst = outs[i].ptr<uint8_t>(y);
+                for (int x = 0; x < w; x++) {
+                    uint32_t sum = bot[x + k] - bot[x] - top[x + k] + top[x];
+                    dst[x] = (uint8_t)(sum / area);
+                }
+            }
+        }
+    });
+}
@@ -0,0 +1,264 @@
+#include "row_kernels.hpp"
+#include "cpu_features.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define IP_X86 1
+#endif
+
+/*
+Canny gradient row: Sobel gx/gy (same taps and clamping as simd_sobel.cpp),
+then the L1 magnitude |gx| + |gy| (<= 2040, int16, unclipped) and the
+gradient direction quantized to one of 4 neighbour pairs for non-maximum
+suppression -- without atan and without leaving 16-bit lanes:
+
+  t22 = (|gx| * 27146) >> 16      ~ |gx| * tan(22.5 deg)   (27146 / 65536 = 0.41422)
+  t67 = 2 * |gx| + t22            ~ |gx| * tan(67.5 deg)   (1 + sqrt 2 = 2 + tan 22.5)
+
+  |gy| <= t22          -> kCannyDirH   (compare left / right)
+  |gy| >  t67          -> kCannyDirV   (compare above / below)
+  gx, gy same sign     -> kCannyDirD   (above-left / below-right)
+  otherwise            -> kCannyDirA   (above-right / below-left)
+
+pmulhw gives the >> 16 directly, and the scalar code uses the same
+integer formula, so every ISA produces the same bytes.
+
+Non-maximum suppression row: in textured areas the direction of
+neighbouring pixels is random, so a per-pixel switch (or && chain) is a
+mispredicted branch every few pixels. The SIMD versions load all four
+candidate neighbours on each side, pick one per lane with compare masks
+on the direction code, and do the threshold tests as masks too.
+*/
+
+static inline uint8_t canny_dir(int gx, int gy) {
+    int ax = std::abs(gx), ay = std::abs(gy);
+    int t22 = (ax * 27146) >> 16;
+    if (ay <= t22) return kCannyDirH;
+    if (ay > 2 * ax + t22) return kCannyDirV;
+    return (gx ^ gy) < 0 ? kCannyDirA : kCannyDirD;
+}
+
+static inline void canny_px(const uint8_t* m1, const uint8_t* r0, const uint8_t* p1,
+                            int xl, int x, int xr, int16_t* mag, uint8_t* dir) {
+    int gx = (m1[xr] - m1[xl]) + 2 * (r0[xr] - r0[xl]) + (p1[xr] - p1[xl]);
+    int gy = (p1[xl] - m1[xl]) + 2 * (p1[x] - m1[x]) + (p1[xr] - m1[xr]);
+    mag[x] = (int16_t)(std::abs(gx) + std::abs(gy));
+    dir[x] = canny_dir(gx, gy);
+}
+
+static void canny_interior_scalar(const uint8_t* m1, const uint8_t* r0, const uint8_t* p1,
+                                  int16_t* mag, uint8_t* dir, int x0, int x1) {
+    for (int x = x0; x < x1; x++) canny_px(m1, r0, p1, x - 1, x, x + 1, mag, dir);
+}
+
+static void canny_nms_scalar(const int16_t* up, const int16_t* mc, const int16_t* dn, const uint8_t* dir,
+                             uint8_t* out, int x0, int w, int lo, int hi) {
+    const int16_t* rowA[4] = {mc - 1, up - 1, up, up + 1}; // indexed by kCannyDir*
+    const int16_t* rowB[4] = {mc + 1, dn + 1, dn, dn - 1};
+    for (int x = x0; x < w; x++) {
+        int m = mc[x];
+        int d = dir[x];
+        int keep = (m > lo) & (m > rowA[d][x]) & (m >= rowB[d][x]);
+        out[x] = (uint8_t)(keep ? (m > hi ? kCannyStrong : kCannyWeak) : 0);
+    }
+}
+
+#ifdef IP_X86
+
+// 8 pixels: int16 gx, gy -> magnitude (stored) and direction codes (returned, int16 lanes)
+__attribute__((target("ssse3")))
+static inline __m128i canny_dir8_ssse3(__m128i gx, __m128i gy, __m128i& mag) {
+    __m128i ax = _mm_abs_epi16(gx), ay = _mm_abs_epi16(gy);
+    mag = _mm_add_epi16(ax, ay);
+    __m128i t22 = _mm_mulhi_epi16(ax, _mm_set1_epi16(27146));
+    __m128i t67 = _mm_add_epi16(_mm_add_epi16(ax, ax), t22);
+    __m128i notH = _mm_cmpgt_epi16(ay, t22);
+    __m128i isV = _mm_cmpgt_epi16(ay, t67);
+    __m128i anti = _mm_srai_epi16(_mm_xor_si128(gx, gy), 15);
+    // D or A, then V overrides, then H clears to 0
+    __m128i d = _mm_or_si128(_mm_set1_epi16(kCannyDirD),
+                             _mm_and_si128(anti, _mm_set1_epi16(kCannyDirA ^ kCannyDirD)));
+    d = _mm_or_si128(_mm_andnot_si128(isV, d), _mm_and_si128(isV, _mm_set1_epi16(kCannyDirV)));
+    return _mm_and_si128(notH, d);
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i load8(const uint8_t* p) {
+    return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), _mm_setzero_si128());
+}
+
+// SSSE3: 8 pixels per step; returns the next x
+__attribute__((target("ssse3")))
+static int canny_interior_ssse3(const uint8_t* m1, const uint8_t* r0, const uint8_t* p1,
+                                int16_t* mag, uint8_t* dir, int x0, int w) {
+    const __m128i zero = _mm_setzero_si128();
+    int x = x0;
+    for (; x + 9 <= w; x += 8) {
+        __m128i mL = load8(m1 + x - 1), mC = load8(m1 + x), mR = load8(m1 + x + 1);
+        __m128i rL = load8(r0 + x - 1), rR = load8(r0 + x + 1);
+        __m128i pL = load8(p1 + x - 1), pC = load8(p1 + x), pR = load8(p1 + x + 1);
+
+        __m128i dr = _mm_sub_epi16(rR, rL);
+        __m128i gx = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(mR, mL), _mm_sub_epi16(pR, pL)),
+                                   _mm_add_epi16(dr, dr));
+        __m128i dc = _mm_sub_epi16(pC, mC);
+        __m128i gy = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(pL, mL), _mm_sub_epi16(pR, mR)),
+                                   _mm_add_epi16(dc, dc));
+
+        __m128i m;
+        __m128i d = canny_dir8_ssse3(gx, gy, m);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(mag + x), m);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dir + x), _mm_packus_epi16(d, zero));
+    }
+    return x;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i load16(const uint8_t* p) {
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+}
+
+// AVX2: 16 pixels per step (vpmovzxbw keeps pixel order across lanes)
+__attribute__((target("avx2")))
+static int canny_interior_avx2(const uint8_t* m1, const uint8_t* r0, const uint8_t* p1,
+                               int16_t* mag, uint8_t* dir, int x0, int w) {
+    const __m256i k22 = _mm256_set1_epi16(27146);
+    const __m256i dirD = _mm256_set1_epi16(kCannyDirD);
+    const __m256i dirAD = _mm256_set1_epi16(kCannyDirA ^ kCannyDirD);
+    const __m256i dirV = _mm256_set1_epi16(kCannyDirV);
+    int x = x0;
+    for (; x + 17 <= w; x += 16) {
+        __m256i mL = load16(m1 + x - 1), mC = load16(m1 + x), mR = load16(m1 + x + 1);
+        __m256i rL = load16(r0 + x - 1), rR = load16(r0 + x + 1);
+        __m256i pL = load16(p1 + x - 1), pC = load16(p1 + x), pR = load16(p1 + x + 1);
+
+        __m256i dr = _mm256_sub_epi16(rR, rL);
+        __m256i gx = _mm256_add_epi16(_mm256_add_epi16(_mm256_sub_epi16(mR, mL), _mm256_sub_epi16(pR, pL)),
+                                      _mm256_add_epi16(dr, dr));
+        __m256i dc = _mm256_sub_epi16(pC, mC);
+        __m256i gy = _mm256_add_epi16(_mm256_add_epi16(_mm256_sub_epi16(pL, mL), _mm256_sub_epi16(pR, mR)),
+                                      _mm256_add_epi16(dc, dc));
+
+        __m256i ax = _mm256_abs_epi16(gx), ay = _mm256_abs_epi16(gy);
+        __m256i t22 = _mm256_mulhi_epi16(ax, k22);
+        __m256i t67 = _mm256_add_epi16(_mm256_add_epi16(ax, ax), t22);
+        __m256i notH = _mm256_cmpgt_epi16(ay, t22);
+        __m256i isV = _mm256_cmpgt_epi16(ay, t67);
+        __m256i anti = _mm256_srai_epi16(_mm256_xor_si256(gx, gy), 15);
+        __m256i d = _mm256_or_si256(dirD, _mm256_and_si256(anti, dirAD));
+        d = _mm256_and_si256(notH, _mm256_blendv_epi8(d, dirV, isV));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(mag + x), _mm256_add_epi16(ax, ay));
+        __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(d), _mm256_extracti128_si256(d, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dir + x), packed);
+    }
+    return canny_interior_ssse3(m1, r0, p1, mag, dir, x, w);
+}
+
+// One side's neighbour per lane: c[k] where d == k (d in 0..3, int16 lanes)
+__attribute__((target("ssse3")))
+static inline __m128i pick4_ssse3(__m128i d, __m128i c0, __m128i c1, __m128i c2, __m128i c3) {
+    __m128i r = _mm_and_si128(_mm_cmpeq_epi16(d, _mm_setzero_si128()), c0);
+    r = _mm_or_si128(r, _mm_and_si128(_mm_cmpeq_epi16(d, _mm_set1_epi16(1)), c1));
+    r = _mm_or_si128(r, _mm_and_si128(_mm_cmpeq_epi16(d, _mm_set1_epi16(2)), c2));
+    return _mm_or_si128(r, _mm_and_si128(_mm_cmpeq_epi16(d, _mm_set1_epi16(3)), c3));
+}
+
+__attribute__((target("ssse3")))
+static int canny_nms_ssse3(const int16_t* up, const int16_t* mc, const int16_t* dn, const uint8_t* dir,
+                           uint8_t* out, int x0, int w, int lo, int hi) {
+    auto ld = [](const int16_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); };
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i vlo = _mm_set1_epi16((int16_t)lo), vhi = _mm_set1_epi16((int16_t)hi);
+    const __m128i weak = _mm_set1_epi16(kCannyWeak), strong = _mm_set1_epi16(kCannyStrong);
+    int x = x0;
+    for (; x + 8 <= w; x += 8) {
+        __m128i m = ld(mc + x);
+        __m128i d = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(dir + x)), zero);
+        __m128i a = pick4_ssse3(d, ld(mc + x - 1), ld(up + x - 1), ld(up + x), ld(up + x + 1));
+        __m128i b = pick4_ssse3(d, ld(mc + x + 1), ld(dn + x + 1), ld(dn + x), ld(dn + x - 1));
+        __m128i keep = _mm_and_si128(_mm_cmpgt_epi16(m, vlo), _mm_cmpgt_epi16(m, a));
+        keep = _mm_andnot_si128(_mm_cmpgt_epi16(b, m), keep); // m >= b
+        __m128i s = _mm_or_si128(weak, _mm_and_si128(_mm_cmpgt_epi16(m, vhi), strong));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + x), _mm_packus_epi16(_mm_and_si128(keep, s), zero));
+    }
+    return x;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i pick4_avx2(__m256i d, __m256i c0, __m256i c1, __m256i c2, __m256i c3) {
+    __m256i r = _mm256_and_si256(_mm256_cmpeq_epi16(d, _mm256_setzero_si256()), c0);
+    r = _mm256_or_si256(r, _mm256_and_si256(_mm256_cmpeq_epi16(d, _mm256_set1_epi16(1)), c1));
+    r = _mm256_or_si256(r, _mm256_and_si256(_mm256_cmpeq_epi16(d, _mm256_set1_epi16(2)), c2));
+    return _mm256_or_si256(r, _mm256_and_si256(_mm256_cmpeq_epi16(d, _mm256_set1_epi16(3)), c3));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i load16_i16(const int16_t* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+
+__attribute__((target("avx2")))
+static int canny_nms_avx2(const int16_t* up, const int16_t* mc, const int16_t* dn, const uint8_t* dir,
+                          uint8_t* out, int x0, int w, int lo, int hi) {
+    const __m256i vlo = _mm256_set1_epi16((int16_t)lo), vhi = _mm256_set1_epi16((int16_t)hi);
+    const __m256i weak = _mm256_set1_epi16(kCannyWeak), strong = _mm256_set1_epi16(kCannyStrong);
+    int x = x0;
+    for (; x + 16 <= w; x += 16) {
+        __m256i m = load16_i16(mc + x);
+        __m256i d = load16(dir + x);
+        __m256i a = pick4_avx2(d, load16_i16(mc + x - 1), load16_i16(up + x - 1), load16_i16(up + x),
+                               load16_i16(up + x + 1));
+        __m256i b = pick4_avx2(d, load16_i16(mc + x + 1), load16_i16(dn + x + 1), load16_i16(dn + x),
+                               load16_i16(dn + x - 1));
+        __m256i keep = _mm256_and_si256(_mm256_cmpgt_epi16(m, vlo), _mm256_cmpgt_epi16(m, a));
+        keep = _mm256_andnot_si256(_mm256_cmpgt_epi16(b, m), keep);
+        __m256i s = _mm256_and_si256(keep, _mm256_or_si256(weak, _mm256_and_si256(_mm256_cmpgt_epi16(m, vhi), strong)));
+        __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), packed);
+    }
+    return canny_nms_ssse3(up, mc, dn, dir, out, x, w, lo, hi);
+}
+
+#endif // IP_X86
+
+void canny_nms_row(const int16_t* up, const int16_t* mc, const int16_t* dn, const uint8_t* dir,
+                   uint8_t* out, int w, int lo, int hi) {
+    // Magnitudes are <= 2040: thresholds beyond int16 behave the same clamped
+    lo = std::min(lo, 32767);
+    hi = std::min(hi, 32767);
+    int x = 0;
+#ifdef IP_X86
+    switch (activeCpuIsa()) {
+        case CpuIsa::AVX512:
+        case CpuIsa::AVX2:   x = canny_nms_avx2(up, mc, dn, dir, out, x, w, lo, hi);  break;
+        case CpuIsa::SSSE3:  x = canny_nms_ssse3(up, mc, dn, dir, out, x, w, lo, hi); break;
+        case CpuIsa::SCALAR: break;
+    }
+#endif
+    canny_nms_scalar(up, mc, dn, dir, out, x, w, lo, hi);
+}
+
+void canny_grad_row(const uint8_t* row_m1, const uint8_t* row_0, const uint8_t* row_p1,
+                    int16_t* mag, uint8_t* dir, int w) {
+    if (w <= 0) return;
+
+    // Border columns: the missing neighbour repeats the edge pixel
+    canny_px(row_m1, row_0, row_p1, 0, 0, std::min(1, w - 1), mag, dir);
+    if (w == 1) return;
+    canny_px(row_m1, row_0, row_p1, w - 2, w - 1, w - 1, mag, dir);
+
+    int x = 1;
+#ifdef IP_X86
+    switch (activeCpuIsa()) {
+        case CpuIsa::AVX512: // int16 lanes, bandwidth-bound like Sobel: AVX2 is enough
+        case CpuIsa::AVX2:   x = canny_interior_avx2(row_m1, row_0, row_p1, mag, dir, x, w);  break;
+        case CpuIsa::SSSE3:  x = canny_interior_ssse3(row_m1, row_0, row_p1, mag, dir, x, w); break;
+        case CpuIsa::SCALAR: break;
+    }
+#endif
+    canny_interior_scalar(row_m1, row_0, row_p1, mag, dir, x, w - 1);
+}
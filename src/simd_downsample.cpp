@@ -0,0 +1,81 @@
+#include "row_kernels.hpp"
+#include "cpu_features.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define IP_X86 1
+#endif
+
+/*
+One pyramid step on a pair of gray rows: out[x] = rounded mean of
+a[2x], a[2x+1], b[2x], b[2x+1].
+
+The scalar loop reads every other byte, which the compiler turns into
+shuffles at best. pmaddubsw against a vector of ones adds each byte
+pair into one 16-bit lane directly (255 + 255 fits a signed 16 bit
+lane), so a 32-byte input block is 4 maddubs, 3 adds, a shift and a
+pack. Integer math throughout: every level is bit-identical to scalar.
+AVX-512 machines use the AVX2 kernel (memory bound).
+*/
+
+static void downsample2_row_scalar(const uint8_t* a, const uint8_t* b, uint8_t* out, int x0, int ow) {
+    for (int x = x0; x < ow; x++) {
+        out[x] = (uint8_t)((a[2 * x] + a[2 * x + 1] + b[2 * x] + b[2 * x + 1] + 2) >> 2);
+    }
+}
+
+#ifdef IP_X86
+
+__attribute__((target("ssse3")))
+static void downsample2_row_ssse3(const uint8_t* a, const uint8_t* b, uint8_t* out, int x0, int ow) {
+    const __m128i ones = _mm_set1_epi8(1);
+    const __m128i two = _mm_set1_epi16(2);
+    int x = x0;
+    for (; x + 16 <= ow; x += 16) {
+        const __m128i* pa = reinterpret_cast<const __m128i*>(a + 2 * x);
+        const __m128i* pb = reinterpret_cast<const __m128i*>(b + 2 * x);
+        __m128i lo = _mm_add_epi16(_mm_maddubs_epi16(_mm_loadu_si128(pa), ones),
+                                   _mm_maddubs_epi16(_mm_loadu_si128(pb), ones));
+        __m128i hi = _mm_add_epi16(_mm_maddubs_epi16(_mm_loadu_si128(pa + 1), ones),
+                                   _mm_maddubs_epi16(_mm_loadu_si128(pb + 1), ones));
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_packus_epi16(lo, hi));
+    }
+    downsample2_row_scalar(a, b, out, x, ow);
+}
+
+__attribute__((target("avx2")))
+static void downsample2_row_avx2(const uint8_t* a, const uint8_t* b, uint8_t* out, int ow) {
+    const __m256i ones = _mm256_set1_epi8(1);
+    const __m256i two = _mm256_set1_epi16(2);
+    int x = 0;
+    for (; x + 32 <= ow; x += 32) {
+        const __m256i* pa = reinterpret_cast<const __m256i*>(a + 2 * x);
+        const __m256i* pb = reinterpret_cast<const __m256i*>(b + 2 * x);
+        __m256i lo = _mm256_add_epi16(_mm256_maddubs_epi16(_mm256_loadu_si256(pa), ones),
+                                      _mm256_maddubs_epi16(_mm256_loadu_si256(pb), ones));
+        __m256i hi = _mm256_add_epi16(_mm256_maddubs_epi16(_mm256_loadu_si256(pa + 1), ones),
+                                      _mm256_maddubs_epi16(_mm256_loadu_si256(pb + 1), ones));
+        lo = _mm256_srli_epi16(_mm256_add_epi16(lo, two), 2);
+        hi = _mm256_srli_epi16(_mm256_add_epi16(hi, two), 2);
+        // packus works per 128-bit lane: [lo0 hi0 lo1 hi1] -> [lo0 lo1 hi0 hi1]
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), packed);
+    }
+    downsample2_row_ssse3(a, b, out, x, ow);
+}
+
+#endif // IP_X86
+
+void downsample2_row(const uint8_t* a, const uint8_t* b, uint8_t* out, int ow) {
+#ifdef IP_X86
+    switch (activeCpuIsa()) {
+        case CpuIsa::AVX512:
+        case CpuIsa::AVX2:   downsample2_row_avx2(a, b, out, ow);     return;
+        case CpuIsa::SSSE3:  downsample2_row_ssse3(a, b, out, 0, ow); return;
+        case CpuIsa::SCALAR: break;
+    }
+#endif
+    downsample2_row_scalar(a, b, out, 0, ow);
+}
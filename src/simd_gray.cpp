@@ -0,0 +1,235 @@
+#include "row_kernels.hpp"
+#include "cpu_features.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define IP_X86 1
+#endif
+
+/*
+Grayscale with fixed-point weights
+
+gray = 0.114*B + 0.587*G + 0.299*R, but in integers:
+- weights scaled by 2^15 and rounded (they sum to exactly 32768, so white stays 255)
+- + 2^14 then >> 15 = round to nearest
+- the largest sum is 255*32768 + 16384, which fits in int32
+
+Every kernel below (scalar, SSSE3, AVX2, AVX-512) computes exactly this
+formula, so they are bit-identical; SIMD only changes how many pixels
+we do per instruction.
+
+The hard part on SIMD is the input layout: BGRBGRBGR... (interleaved).
+We load 48 bytes (16 pixels) and use byte shuffles (pshufb) to gather
+the 16 B's, 16 G's and 16 R's into separate registers ("deinterleave").
+*/
+
+static const int kWB = 3736;   // 0.114 * 32768
+static const int kWG = 19235;  // 0.587 * 32768
+static const int kWR = 9797;   // 0.299 * 32768 (rounded down so the sum is 32768)
+static const int kBias = 1 << 14;
+static const int kShift = 15;
+
+static void grayscale_row_scalar(const uint8_t* bgr, uint8_t* gray, int x0, int w) {
+    for (int x = x0; x < w; x++) {
+        const uint8_t* p = bgr + 3 * x;
+        gray[x] = static_cast<uint8_t>((p[0] * kWB + p[1] * kWG + p[2] * kWR + kBias) >> kShift);
+    }
+}
+
+#ifdef IP_X86
+
+// Shuffle masks: for channel c, mask k picks that channel's bytes out of
+// the k-th 16-byte chunk of a 48-byte (16 pixel) block. -1 = write zero.
+alignas(16) static const int8_t kShufB[3][16] = {
+    { 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1 },
+    { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13 },
+};
+alignas(16) static const int8_t kShufG[3][16] = {
+    { 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1 },
+    { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14 },
+};
+alignas(16) static const int8_t kShufR[3][16] = {
+    { 2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { -1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1 },
+    { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15 },
+};
+
+/*
+Per 16-bit pixel lane the math is two pmaddwd:
+  (B, G) . (wB, wG)     -> B*wB + G*wG
+  (R, 1) . (wR, bias)   -> R*wR + bias
+add, >> 15, then pack 32 -> 16 -> 8 bits.
+All unpack/pack ops work inside 128-bit lanes, so the AVX2/AVX-512
+versions are the SSSE3 version run on 2/4 lanes at once.
+*/
+
+__attribute__((target("ssse3")))
+static inline __m128i gray16_ssse3(__m128i a, __m128i b, __m128i c) {
+    const __m128i* mB = reinterpret_cast<const __m128i*>(kShufB);
+    const __m128i* mG = reinterpret_cast<const __m128i*>(kShufG);
+    const __m128i* mR = reinterpret_cast<const __m128i*>(kShufR);
+
+    __m128i B = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, mB[0]), _mm_shuffle_epi8(b, mB[1])), _mm_shuffle_epi8(c, mB[2]));
+    __m128i G = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, mG[0]), _mm_shuffle_epi8(b, mG[1])), _mm_shuffle_epi8(c, mG[2]));
+    __m128i R = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, mR[0]), _mm_shuffle_epi8(b, mR[1])), _mm_shuffle_epi8(c, mR[2]));
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i wBG = _mm_set1_epi32((kWG << 16) | kWB);
+    const __m128i wR1 = _mm_set1_epi32((kBias << 16) | kWR);
+    const __m128i one = _mm_set1_epi16(1);
+
+    __m128i out16[2];
+    for (int half = 0; half < 2; half++) {
+        __m128i B16 = half ? _mm_unpackhi_epi8(B, zero) : _mm_unpacklo_epi8(B, zero);
+        __m128i G16 = half ? _mm_unpackhi_epi8(G, zero) : _mm_unpacklo_epi8(G, zero);
+        __m128i R16 = half ? _mm_unpackhi_epi8(R, zero) : _mm_unpacklo_epi8(R, zero);
+
+        __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(B16, G16), wBG),
+                                   _mm_madd_epi16(_mm_unpacklo_epi16(R16, one), wR1));
+        __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(B16, G16), wBG),
+                                   _mm_madd_epi16(_mm_unpackhi_epi16(R16, one), wR1));
+        out16[half] = _mm_packs_epi32(_mm_srli_epi32(lo, kShift), _mm_srli_epi32(hi, kShift));
+    }
+    return _mm_packus_epi16(out16[0], out16[1]);
+}
+
+__attribute__((target("ssse3")))
+static void grayscale_row_ssse3(const uint8_t* bgr, uint8_t* gray, int w) {
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        const __m128i* p = reinterpret_cast<const __m128i*>(bgr + 3 * x);
+        __m128i g = gray16_ssse3(_mm_loadu_si128(p), _mm_loadu_si128(p + 1), _mm_loadu_si128(p + 2));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(gray + x), g);
+    }
+    grayscale_row_scalar(bgr, gray, x, w);
+}
+
+__attribute__((target("avx2")))
+static void grayscale_row_avx2(const uint8_t* bgr, uint8_t* gray, int w) {
+    const __m256i mB0 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(kShufB[0])));
+    const __m256i mB1 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(kShufB[1])));
+    const __m256i mB2 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(kShufB[2])));
+    const __m256i mG0 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(kShufG[0])));
+    const __m256i mG1 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(kShufG[1])));
+    const __m256i mG2 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(kShufG[2])));
+    const __m256i mR0 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(kShufR[0])));
+    const __m256i mR1 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(kShufR[1])));
+    const __m256i mR2 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(kShufR[2])));
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i wBG = _mm256_set1_epi32((kWG << 16) | kWB);
+    const __m256i wR1 = _mm256_set1_epi32((kBias << 16) | kWR);
+    const __m256i one = _mm256_set1_epi16(1);
+
+    int x = 0;
+    for (; x + 32 <= w; x += 32) {
+        // Lane 0 = pixels [x, x+16), lane 1 = pixels [x+16, x+32)
+        const __m128i* p = reinterpret_cast<const __m128i*>(bgr + 3 * x);
+        __m256i a = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(p + 0)), _mm_loadu_si128(p + 3), 1);
+        __m256i b = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(p + 1)), _mm_loadu_si128(p + 4), 1);
+        __m256i c = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(p + 2)), _mm_loadu_si128(p + 5), 1);
+
+        __m256i B = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(a, mB0), _mm256_shuffle_epi8(b, mB1)), _mm256_shuffle_epi8(c, mB2));
+        __m256i G = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(a, mG0), _mm256_shuffle_epi8(b, mG1)), _mm256_shuffle_epi8(c, mG2));
+        __m256i R = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(a, mR0), _mm256_shuffle_epi8(b, mR1)), _mm256_shuffle_epi8(c, mR2));
+
+        __m256i out16[2];
+        for (int half = 0; half < 2; half++) {
+            __m256i B16 = half ? _mm256_unpackhi_epi8(B, zero) : _mm256_unpacklo_epi8(B, zero);
+            __m256i G16 = half ? _mm256_unpackhi_epi8(G, zero) : _mm256_unpacklo_epi8(G, zero);
+            __m256i R16 = half ? _mm256_unpackhi_epi8(R, zero) : _mm256_unpacklo_epi8(R, zero);
+
+            __m256i lo = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(B16, G16), wBG),
+                                          _mm256_madd_epi16(_mm256_unpacklo_epi16(R16, one), wR1));
+            __m256i hi = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(B16, G16), wBG),
+                                          _mm256_madd_epi16(_mm256_unpackhi_epi16(R16, one), wR1));
+            out16[half] = _mm256_packs_epi32(_mm256_srli_epi32(lo, kShift), _mm256_srli_epi32(hi, kShift));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(gray + x), _mm256_packus_epi16(out16[0], out16[1]));
+    }
+    grayscale_row_ssse3(bgr + 3 * x, gray + x, w - x);
+}
+
+// GCC 12's AVX-512 headers trip -Wuninitialized on their own
+// "undefined" placeholder registers; nothing in our code is uninitialized.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+// Chunk k of 16-pixel block j goes into 128-bit lane j of the result
+__attribute__((target("avx512f,avx512bw")))
+static inline __m512i gather4_avx512(const __m128i* p, int k) {
+    __m512i v = _mm512_castsi128_si512(_mm_loadu_si128(p + k));
+    v = _mm512_inserti32x4(v, _mm_loadu_si128(p + 3 + k), 1);
+    v = _mm512_inserti32x4(v, _mm_loadu_si128(p + 6 + k), 2);
+    v = _mm512_inserti32x4(v, _mm_loadu_si128(p + 9 + k), 3);
+    return v;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void grayscale_row_avx512(const uint8_t* bgr, uint8_t* gray, int w) {
+    const __m512i mB0 = _mm512_broadcast_i32x4(_mm_load_si128(reinterpret_cast<const __m128i*>(kShufB[0])));
+    const __m512i mB1 = _mm512_broadcast_i32x4(_mm_load_si128(reinterpret_cast<const __m128i*>(kShufB[1])));
+    const __m512i mB2 = _mm512_broadcast_i32x4(_mm_load_si128(reinterpret_cast<const __m128i*>(kShufB[2])));
+    const __m512i mG0 = _mm512_broadcast_i32x4(_mm_load_si128(reinterpret_cast<const __m128i*>(kShufG[0])));
+    const __m512i mG1 = _mm512_broadcast_i32x4(_mm_load_si128(reinterpret_cast<const __m128i*>(kShufG[1])));
+    const __m512i mG2 = _mm512_broadcast_i32x4(_mm_load_si128(reinterpret_cast<const __m128i*>(kShufG[2])));
+    const __m512i mR0 = _mm512_broadcast_i32x4(_mm_load_si128(reinterpret_cast<const __m128i*>(kShufR[0])));
+    const __m512i mR1 = _mm512_broadcast_i32x4(_mm_load_si128(reinterpret_cast<const __m128i*>(kShufR[1])));
+    const __m512i mR2 = _mm512_broadcast_i32x4(_mm_load_si128(reinterpret_cast<const __m128i*>(kShufR[2])));
+
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i wBG = _mm512_set1_epi32((kWG << 16) | kWB);
+    const __m512i wR1 = _mm512_set1_epi32((kBias << 16) | kWR);
+    const __m512i one = _mm512_set1_epi16(1);
+
+    int x = 0;
+    for (; x + 64 <= w; x += 64) {
+        const __m128i* p = reinterpret_cast<const __m128i*>(bgr + 3 * x);
+        __m512i a = gather4_avx512(p, 0);
+        __m512i b = gather4_avx512(p, 1);
+        __m512i c = gather4_avx512(p, 2);
+
+        __m512i B = _mm512_or_si512(_mm512_or_si512(_mm512_shuffle_epi8(a, mB0), _mm512_shuffle_epi8(b, mB1)), _mm512_shuffle_epi8(c, mB2));
+        __m512i G = _mm512_or_si512(_mm512_or_si512(_mm512_shuffle_epi8(a, mG0), _mm512_shuffle_epi8(b, mG1)), _mm512_shuffle_epi8(c, mG2));
+        __m512i R = _mm512_or_si512(_mm512_or_si512(_mm512_shuffle_epi8(a, mR0), _mm512_shuffle_epi8(b, mR1)), _mm512_shuffle_epi8(c, mR2));
+
+        __m512i out16[2];
+        for (int half = 0; half < 2; half++) {
+            __m512i B16 = half ? _mm512_unpackhi_epi8(B, zero) : _mm512_unpacklo_epi8(B, zero);
+            __m512i G16 = half ? _mm512_unpackhi_epi8(G, zero) : _mm512_unpacklo_epi8(G, zero);
+            __m512i R16 = half ? _mm512_unpackhi_epi8(R, zero) : _mm512_unpacklo_epi8(R, zero);
+
+            __m512i lo = _mm512_add_epi32(_mm512_madd_epi16(_mm512_unpacklo_epi16(B16, G16), wBG),
+                                          _mm512_madd_epi16(_mm512_unpacklo_epi16(R16, one), wR1));
+            __m512i hi = _mm512_add_epi32(_mm512_madd_epi16(_mm512_unpackhi_epi16(B16, G16), wBG),
+                                          _mm512_madd_epi16(_mm512_unpackhi_epi16(R16, one), wR1));
+            out16[half] = _mm512_packs_epi32(_mm512_srli_epi32(lo, kShift), _mm512_srli_epi32(hi, kShift));
+        }
+        _mm512_storeu_si512(reinterpret_cast<void*>(gray + x), _mm512_packus_epi16(out16[0], out16[1]));
+    }
+    grayscale_row_avx2(bgr + 3 * x, gray + x, w - x);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif // IP_X86
+
+// The one entry point: grayscale_cpu, grayscale_cpu_mt and the fused path all land here
+void grayscale_row(const uint8_t* bgr, uint8_t* gray, int w) {
+#ifdef IP_X86
+    switch (activeCpuIsa()) {
+        case CpuIsa::AVX512: grayscale_row_avx512(bgr, gray, w); return;
+        case CpuIsa::AVX2:   grayscale_row_avx2(bgr, gray, w);   return;
+        case CpuIsa::SSSE3:  grayscale_row_ssse3(bgr, gray, w);  return;
+        case CpuIsa::SCALAR: break;
+    }
+#endif
+    grayscale_row_scalar(bgr, gray, 0, w);
+}
@@ -0,0 +1,196 @@
+#include "row_kernels.hpp"
+#include "cpu_features.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define IP_X86 1
+#endif
+
+/*
+BGR <-> planar (one plane per channel) for the colour path.
+
+Interleaved BGRBGR... rows make every per-channel filter strided; the
+planar colour stages convert once on the way in and once on the way
+out, and everything in between runs the gray kernels on contiguous
+planes.
+
+Same trick as simd_gray.cpp: a 16-pixel block is 48 bytes = 3 chunks of
+16, and pshufb gathers each channel's bytes out of every chunk (one
+shuffle per chunk and channel, OR'ed together). Interleaving is the
+inverse: every output chunk is a shuffle of B, G and R, OR'ed.
+Pure byte moves, so every level is bit-identical to the scalar loop.
+AVX-512 machines use the AVX2 kernel: this is memory bound already.
+*/
+
+static void deinterleave_row_scalar(const uint8_t* bgr, uint8_t* b, uint8_t* g, uint8_t* r, int x0, int w) {
+    for (int x = x0; x < w; x++) {
+        b[x] = bgr[3 * x + 0];
+        g[x] = bgr[3 * x + 1];
+        r[x] = bgr[3 * x + 2];
+    }
+}
+
+static void interleave_row_scalar(const uint8_t* b, const uint8_t* g, const uint8_t* r, uint8_t* bgr, int x0, int w) {
+    for (int x = x0; x < w; x++) {
+        bgr[3 * x + 0] = b[x];
+        bgr[3 * x + 1] = g[x];
+        bgr[3 * x + 2] = r[x];
+    }
+}
+
+#ifdef IP_X86
+
+// Deinterleave: for channel c, mask k picks that channel's bytes out of
+// chunk k of a 48-byte block (same masks as simd_gray.cpp). -1 = zero.
+alignas(16) static const int8_t kSplitB[3][16] = {
+    { 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1 },
+    { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13 },
+};
+alignas(16) static const int8_t kSplitG[3][16] = {
+    { 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1 },
+    { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14 },
+};
+alignas(16) static const int8_t kSplitR[3][16] = {
+    { 2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+    { -1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1 },
+    { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15 },
+};
+
+// Interleave: mask k of channel c says which of its 16 pixels lands on
+// each byte of output chunk k (-1 = a byte of another channel)
+alignas(16) static const int8_t kMergeB[3][16] = {
+    { 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5 },
+    { -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10, -1 },
+    { -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1 },
+};
+alignas(16) static const int8_t kMergeG[3][16] = {
+    { -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1 },
+    { 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10 },
+    { -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1 },
+};
+alignas(16) static const int8_t kMergeR[3][16] = {
+    { -1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1 },
+    { -1, 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1 },
+    { 10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15 },
+};
+
+__attribute__((target("ssse3")))
+static void deinterleave_row_ssse3(const uint8_t* bgr, uint8_t* b, uint8_t* g, uint8_t* r, int x0, int w) {
+    const __m128i* mB = reinterpret_cast<const __m128i*>(kSplitB);
+    const __m128i* mG = reinterpret_cast<const __m128i*>(kSplitG);
+    const __m128i* mR = reinterpret_cast<const __m128i*>(kSplitR);
+
+    int x = x0;
+    for (; x + 16 <= w; x += 16) {
+        const __m128i* p = reinterpret_cast<const __m128i*>(bgr + 3 * x);
+        __m128i c0 = _mm_loadu_si128(p), c1 = _mm_loadu_si128(p + 1), c2 = _mm_loadu_si128(p + 2);
+        __m128i B = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(c0, mB[0]), _mm_shuffle_epi8(c1, mB[1])), _mm_shuffle_epi8(c2, mB[2]));
+        __m128i G = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(c0, mG[0]), _mm_shuffle_epi8(c1, mG[1])), _mm_shuffle_epi8(c2, mG[2]));
+        __m128i R = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(c0, mR[0]), _mm_shuffle_epi8(c1, mR[1])), _mm_shuffle_epi8(c2, mR[2]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(b + x), B);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(g + x), G);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(r + x), R);
+    }
+    deinterleave_row_scalar(bgr, b, g, r, x, w);
+}
+
+__attribute__((target("ssse3")))
+static void interleave_row_ssse3(const uint8_t* b, const uint8_t* g, const uint8_t* r, uint8_t* bgr, int x0, int w) {
+    const __m128i* mB = reinterpret_cast<const __m128i*>(kMergeB);
+    const __m128i* mG = reinterpret_cast<const __m128i*>(kMergeG);
+    const __m128i* mR = reinterpret_cast<const __m128i*>(kMergeR);
+
+    int x = x0;
+    for (; x + 16 <= w; x += 16) {
+        __m128i B = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x));
+        __m128i G = _mm_loadu_si128(reinterpret_cast<const __m128i*>(g + x));
+        __m128i R = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + x));
+        __m128i* p = reinterpret_cast<__m128i*>(bgr + 3 * x);
+        for (int k = 0; k < 3; k++) {
+            __m128i c = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(B, mB[k]), _mm_shuffle_epi8(G, mG[k])), _mm_shuffle_epi8(R, mR[k]));
+            _mm_storeu_si128(p + k, c);
+        }
+    }
+    interleave_row_scalar(b, g, r, bgr, x, w);
+}
+
+// Two 16-pixel blocks per iteration, one per 128-bit lane (pshufb never crosses lanes)
+__attribute__((target("avx2")))
+static inline __m256i load2_avx2(const __m128i* p, int k) {
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(p + k)), _mm_loadu_si128(p + 3 + k), 1);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i mask2_avx2(const int8_t* m) {
+    return _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(m)));
+}
+
+__attribute__((target("avx2")))
+static void deinterleave_row_avx2(const uint8_t* bgr, uint8_t* b, uint8_t* g, uint8_t* r, int w) {
+    const __m256i mB0 = mask2_avx2(kSplitB[0]), mB1 = mask2_avx2(kSplitB[1]), mB2 = mask2_avx2(kSplitB[2]);
+    const __m256i mG0 = mask2_avx2(kSplitG[0]), mG1 = mask2_avx2(kSplitG[1]), mG2 = mask2_avx2(kSplitG[2]);
+    const __m256i mR0 = mask2_avx2(kSplitR[0]), mR1 = mask2_avx2(kSplitR[1]), mR2 = mask2_avx2(kSplitR[2]);
+
+    int x = 0;
+    for (; x + 32 <= w; x += 32) {
+        const __m128i* p = reinterpret_cast<const __m128i*>(bgr + 3 * x);
+        __m256i c0 = load2_avx2(p, 0), c1 = load2_avx2(p, 1), c2 = load2_avx2(p, 2);
+        __m256i B = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(c0, mB0), _mm256_shuffle_epi8(c1, mB1)), _mm256_shuffle_epi8(c2, mB2));
+        __m256i G = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(c0, mG0), _mm256_shuffle_epi8(c1, mG1)), _mm256_shuffle_epi8(c2, mG2));
+        __m256i R = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(c0, mR0), _mm256_shuffle_epi8(c1, mR1)), _mm256_shuffle_epi8(c2, mR2));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(b + x), B);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(g + x), G);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(r + x), R);
+    }
+    deinterleave_row_ssse3(bgr, b, g, r, x, w);
+}
+
+__attribute__((target("avx2")))
+static void interleave_row_avx2(const uint8_t* b, const uint8_t* g, const uint8_t* r, uint8_t* bgr, int w) {
+    const __m256i mB[3] = { mask2_avx2(kMergeB[0]), mask2_avx2(kMergeB[1]), mask2_avx2(kMergeB[2]) };
+    const __m256i mG[3] = { mask2_avx2(kMergeG[0]), mask2_avx2(kMergeG[1]), mask2_avx2(kMergeG[2]) };
+    const __m256i mR[3] = { mask2_avx2(kMergeR[0]), mask2_avx2(kMergeR[1]), mask2_avx2(kMergeR[2]) };
+
+    int x = 0;
+    for (; x + 32 <= w; x += 32) {
+        // Lane 0 = pixels [x, x+16), lane 1 = pixels [x+16, x+32)
+        __m256i B = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + x));
+        __m256i G = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(g + x));
+        __m256i R = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(r + x));
+        __m128i* p = reinterpret_cast<__m128i*>(bgr + 3 * x);
+        for (int k = 0; k < 3; k++) {
+            __m256i c = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(B, mB[k]), _mm256_shuffle_epi8(G, mG[k])), _mm256_shuffle_epi8(R, mR[k]));
+            _mm_storeu_si128(p + k, _mm256_castsi256_si128(c));
+            _mm_storeu_si128(p + 3 + k, _mm256_extracti128_si256(c, 1));
+        }
+    }
+    interleave_row_ssse3(b, g, r, bgr, x, w);
+}
+
+#endif // IP_X86
+
+void deinterleave_row(const uint8_t* bgr, uint8_t* b, uint8_t* g, uint8_t* r, int w) {
+#ifdef IP_X86
+    switch (activeCpuIsa()) {
+        case CpuIsa::AVX512:
+        case CpuIsa::AVX2:   deinterleave_row_avx2(bgr, b, g, r, w);     return;
+        case CpuIsa::SSSE3:  deinterleave_row_ssse3(bgr, b, g, r, 0, w); return;
+        case CpuIsa::SCALAR: break;
+    }
+#endif
+    deinterleave_row_scalar(bgr, b, g, r, 0, w);
+}
+
+void interleave_row(const uint8_t* b, const uint8_t* g, const uint8_t* r, uint8_t* bgr, int w) {
+#ifdef IP_X86
+    switch (activeCpuIsa()) {
+        case CpuIsa::AVX512:
+        case CpuIsa::AVX2:   interleave_row_avx2(b, g, r, bgr, w);     return;
+        case CpuIsa::SSSE3:  interleave_row_ssse3(b, g, r, bgr, 0, w); return;
+        case CpuIsa::SCALAR: break;
+    }
+#endif
+    interleave_row_scalar(b, g, r, bgr, 0, w);
+}
@@ -0,0 +1,227 @@
+#include "row_kernels.hpp"
+#include "sobel_norm.hpp"
+#include "cpu_features.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define IP_X86 1
+#endif
+
+/*
+Sobel, split into a clamp-free interior and a thin border
+
+The 3x3 Sobel kernels are separable:
+  Gx = [1 2 1]^T * [-1 0 1]     (smooth vertically, differentiate horizontally)
+  Gy = [-1 0 1]^T * [1 2 1]     (differentiate vertically, smooth horizontally)
+so per pixel, with the three rows above/at/below:
+  gx = (m1[x+1]-m1[x-1]) + 2*(r0[x+1]-r0[x-1]) + (p1[x+1]-p1[x-1])
+  gy = (p1[x-1]-m1[x-1]) + 2*(p1[x]  -m1[x]  ) + (p1[x+1]-m1[x+1])
+
+Rows: the caller passes the three row pointers already clamped
+(row -1 = row 0, row h = row h-1), so there is no per-pixel row clamp.
+
+Columns: only x = 0 and x = w-1 need a clamped neighbour. Those two
+pixels go through the scalar code; every pixel in between is loaded
+straight from x-1 / x / x+1, 16 (SSSE3) or 32 (AVX2) at a time.
+
+Ranges: gx, gy are in [-1020, 1020] -> fit int16.
+gx^2 + gy^2 <= 2,080,800 < 2^24, so it converts to float exactly, and
+sqrtps is correctly rounded: truncating it gives exactly floor(sqrt(n))
+(the true root of n = k^2 - 1 is at least 1/2900 below k, far more than
+one float ulp at k <= 1443). So all norms are bit-identical to scalar.
+*/
+
+static inline int sobel_mag(int gx, int gy, SobelNorm norm) {
+    switch (norm) {
+        case SobelNorm::L1:
+            return std::min(std::abs(gx) + std::abs(gy), 255);
+        case SobelNorm::SQUARED:
+            return std::min((gx * gx + gy * gy) >> 8, 255);
+        case SobelNorm::L2:
+            break;
+    }
+    return std::min(static_cast<int>(std::sqrt(static_cast<double>(gx * gx + gy * gy))), 255);
+}
+
+// One pixel with explicit left/right neighbour columns (xl, xr may equal x at the border)
+static inline uint8_t sobel_px(const uint8_t* m1, const uint8_t* r0, const uint8_t* p1,
+                               int xl, int x, int xr, SobelNorm norm) {
+    int gx = (m1[xr] - m1[xl]) + 2 * (r0[xr] - r0[xl]) + (p1[xr] - p1[xl]);
+    int gy = (p1[xl] - m1[xl]) + 2 * (p1[x] - m1[x]) + (p1[xr] - m1[xr]);
+    return static_cast<uint8_t>(sobel_mag(gx, gy, norm));
+}
+
+static void sobel_interior_scalar(const uint8_t* m1, const uint8_t* r0, const uint8_t* p1,
+                                  uint8_t* out, int x0, int x1, SobelNorm norm) {
+    for (int x = x0; x < x1; x++) out[x] = sobel_px(m1, r0, p1, x - 1, x, x + 1, norm);
+}
+
+#ifdef IP_X86
+
+/*
+SSSE3: 16 pixels per step.
+Bytes are widened to int16 (two halves of 8), gx/gy formed with 16-bit
+adds, then the norm:
+  L1: abs + add (<= 2040), packus saturates to 255
+  L2 / SQ: pmaddwd on interleaved (gx, gy) pairs = gx^2 + gy^2 in int32
+*/
+
+__attribute__((target("ssse3")))
+static inline __m128i sobel_mag8_ssse3(__m128i gx, __m128i gy, SobelNorm norm) {
+    if (norm == SobelNorm::L1) {
+        return _mm_add_epi16(_mm_abs_epi16(gx), _mm_abs_epi16(gy));
+    }
+    __m128i lo = _mm_unpacklo_epi16(gx, gy);
+    __m128i hi = _mm_unpackhi_epi16(gx, gy);
+    lo = _mm_madd_epi16(lo, lo);
+    hi = _mm_madd_epi16(hi, hi);
+    if (norm == SobelNorm::SQUARED) {
+        lo = _mm_srli_epi32(lo, 8);
+        hi = _mm_srli_epi32(hi, 8);
+    } else {
+        lo = _mm_cvttps_epi32(_mm_sqrt_ps(_mm_cvtepi32_ps(lo)));
+        hi = _mm_cvttps_epi32(_mm_sqrt_ps(_mm_cvtepi32_ps(hi)));
+    }
+    return _mm_packs_epi32(lo, hi); // <= 8128, fits int16
+}
+
+// Pixels [x0, ...) while x+16 (the last x+1 load) stays inside the row; returns next x
+__attribute__((target("ssse3")))
+static int sobel_interior_ssse3(const uint8_t* m1, const uint8_t* r0, const uint8_t* p1,
+                                uint8_t* out, int x0, int w, SobelNorm norm) {
+    const __m128i zero = _mm_setzero_si128();
+    int x = x0;
+    for (; x + 17 <= w; x += 16) {
+        __m128i ml = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m1 + x - 1));
+        __m128i mc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m1 + x));
+        __m128i mr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m1 + x + 1));
+        __m128i rl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r0 + x - 1));
+        __m128i rr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r0 + x + 1));
+        __m128i pl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p1 + x - 1));
+        __m128i pc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p1 + x));
+        __m128i pr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p1 + x + 1));
+
+        __m128i res[2];
+        for (int half = 0; half < 2; half++) {
+            auto widen = [&](__m128i v) {
+                return half ? _mm_unpackhi_epi8(v, zero) : _mm_unpacklo_epi8(v, zero);
+            };
+            __m128i mL = widen(ml), mC = widen(mc), mR = widen(mr);
+            __m128i rL = widen(rl), rR = widen(rr);
+            __m128i pL = widen(pl), pC = widen(pc), pR = widen(pr);
+
+            // gx: [-1 0 1] across, weighted [1 2 1] down
+            __m128i dr = _mm_sub_epi16(rR, rL);
+            __m128i gx = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(mR, mL), _mm_sub_epi16(pR, pL)),
+                                       _mm_add_epi16(dr, dr));
+            // gy: [-1 0 1] down, weighted [1 2 1] across
+            __m128i dc = _mm_sub_epi16(pC, mC);
+            __m128i gy = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(pL, mL), _mm_sub_epi16(pR, mR)),
+                                       _mm_add_epi16(dc, dc));
+            res[half] = sobel_mag8_ssse3(gx, gy, norm);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_packus_epi16(res[0], res[1]));
+    }
+    return x;
+}
+
+/*
+AVX2: 32 pixels per step, as two groups of 16 widened with vpmovzxbw.
+16-bit math is lane-local; the final packus interleaves the two groups
+per 128-bit lane, and one vpermq puts the 32 bytes back in order.
+*/
+
+__attribute__((target("avx2")))
+static inline __m256i load16_u16(const uint8_t* p) {
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i sobel_group_avx2(const uint8_t* m1, const uint8_t* r0, const uint8_t* p1,
+                                       int x, SobelNorm norm) {
+    __m256i mL = load16_u16(m1 + x - 1), mC = load16_u16(m1 + x), mR = load16_u16(m1 + x + 1);
+    __m256i rL = load16_u16(r0 + x - 1), rR = load16_u16(r0 + x + 1);
+    __m256i pL = load16_u16(p1 + x - 1), pC = load16_u16(p1 + x), pR = load16_u16(p1 + x + 1);
+
+    __m256i dr = _mm256_sub_epi16(rR, rL);
+    __m256i gx = _mm256_add_epi16(_mm256_add_epi16(_mm256_sub_epi16(mR, mL), _mm256_sub_epi16(pR, pL)),
+                                  _mm256_add_epi16(dr, dr));
+    __m256i dc = _mm256_sub_epi16(pC, mC);
+    __m256i gy = _mm256_add_epi16(_mm256_add_epi16(_mm256_sub_epi16(pL, mL), _mm256_sub_epi16(pR, mR)),
+                                  _mm256_add_epi16(dc, dc));
+
+    if (norm == SobelNorm::L1) {
+        return _mm256_add_epi16(_mm256_abs_epi16(gx), _mm256_abs_epi16(gy));
+    }
+    // unpack lo/hi + packs are all per-lane, so pixel order survives the round trip
+    __m256i lo = _mm256_unpacklo_epi16(gx, gy);
+    __m256i hi = _mm256_unpackhi_epi16(gx, gy);
+    lo = _mm256_madd_epi16(lo, lo);
+    hi = _mm256_madd_epi16(hi, hi);
+    if (norm == SobelNorm::SQUARED) {
+        lo = _mm256_srli_epi32(lo, 8);
+        hi = _mm256_srli_epi32(hi, 8);
+    } else {
+        lo = _mm256_cvttps_epi32(_mm256_sqrt_ps(_mm256_cvtepi32_ps(lo)));
+        hi = _mm256_cvttps_epi32(_mm256_sqrt_ps(_mm256_cvtepi32_ps(hi)));
+    }
+    return _mm256_packs_epi32(lo, hi);
+}
+
+__attribute__((target("avx2")))
+static int sobel_interior_avx2(const uint8_t* m1, const uint8_t* r0, const uint8_t* p1,
+                               uint8_t* out, int x0, int w, SobelNorm norm) {
+    int x = x0;
+    for (; x + 33 <= w; x += 32) {
+        __m256i a = sobel_group_avx2(m1, r0, p1, x, norm);
+        __m256i b = sobel_group_avx2(m1, r0, p1, x + 16, norm);
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), packed);
+    }
+    return sobel_interior_ssse3(m1, r0, p1, out, x, w, norm);
+}
+
+#endif // IP_X86
+
+void sobel_row(const uint8_t* row_m1, const uint8_t* row_0, const uint8_t* row_p1,
+               uint8_t* outRow, int w, SobelNorm norm) {
+    if (w <= 0) return;
+
+    // Border columns: the missing neighbour repeats the edge pixel
+    outRow[0] = sobel_px(row_m1, row_0, row_p1, 0, 0, std::min(1, w - 1), norm);
+    if (w == 1) return;
+    outRow[w - 1] = sobel_px(row_m1, row_0, row_p1, w - 2, w - 1, w - 1, norm);
+
+    // Interior [1, w-1): SIMD as far as it goes, scalar for the last few
+    int x = 1;
+#ifdef IP_X86
+    switch (activeCpuIsa()) {
+        case CpuIsa::AVX512: // 32 px per step already saturates bandwidth; use AVX2
+        case CpuIsa::AVX2:   x = sobel_interior_avx2(row_m1, row_0, row_p1, outRow, x, w, norm);  break;
+        case CpuIsa::SSSE3:  x = sobel_interior_ssse3(row_m1, row_0, row_p1, outRow, x, w, norm); break;
+        case CpuIsa::SCALAR: break;
+    }
+#endif
+    sobel_interior_scalar(row_m1, row_0, row_p1, outRow, x, w - 1, norm);
+}
+
+const char* sobelNormName(SobelNorm n) {
+    switch (n) {
+        case SobelNorm::L1:      return "l1";
+        case SobelNorm::L2:      return "l2";
+        case SobelNorm::SQUARED: return "sq";
+    }
+    return "unknown";
+}
+
+SobelNorm parseSobelNorm(const std::string& s) {
+    if (s == "l1") return SobelNorm::L1;
+    if (s == "l2") return SobelNorm::L2;
+    if (s == "sq") return SobelNorm::SQUARED;
+    throw std::runtime_error("Unknown Sobel norm: " + s);
+}
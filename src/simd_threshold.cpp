@@ -0,0 +1,84 @@
+#include "row_kernels.hpp"
+#include "cpu_features.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define IP_X86 1
+#endif
+
+/*
+Edge map row -> 1 bit per pixel (bit x & 7 of byte x / 8, LSB first),
+set where magnitude >= threshold.
+
+There is no unsigned byte compare before AVX-512, but for bytes
+max(m, t) == m  <=>  m >= t, so max + cmpeq gives the mask and movemask
+packs one bit per byte straight into the LSB-first layout: 16 pixels
+-> 2 bytes (SSE), 32 -> 4 (AVX2). AVX-512BW compares unsigned directly
+into a 64-bit mask (8 bytes). Stores are whole bytes because every
+block starts on a multiple of 8 pixels.
+*/
+
+static void threshold_bits_row_scalar(const uint8_t* mag, uint8_t* bits, int x0, int w, uint8_t t) {
+    // x0 is a multiple of 8: the partial tail byte is built from scratch
+    for (int x = x0; x < w; x += 8) {
+        uint8_t b = 0;
+        int n = (w - x < 8) ? w - x : 8;
+        for (int i = 0; i < n; i++) b |= (uint8_t)((mag[x + i] >= t) << i);
+        bits[x >> 3] = b;
+    }
+}
+
+#ifdef IP_X86
+
+__attribute__((target("ssse3")))
+static void threshold_bits_row_ssse3(const uint8_t* mag, uint8_t* bits, int x0, int w, uint8_t t) {
+    const __m128i vt = _mm_set1_epi8((char)t);
+    int x = x0;
+    for (; x + 16 <= w; x += 16) {
+        __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mag + x));
+        uint16_t mask = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(m, vt), m));
+        std::memcpy(bits + (x >> 3), &mask, 2);
+    }
+    threshold_bits_row_scalar(mag, bits, x, w, t);
+}
+
+__attribute__((target("avx2")))
+static void threshold_bits_row_avx2(const uint8_t* mag, uint8_t* bits, int w, uint8_t t) {
+    const __m256i vt = _mm256_set1_epi8((char)t);
+    int x = 0;
+    for (; x + 32 <= w; x += 32) {
+        __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mag + x));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(m, vt), m));
+        std::memcpy(bits + (x >> 3), &mask, 4);
+    }
+    threshold_bits_row_ssse3(mag, bits, x, w, t);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void threshold_bits_row_avx512(const uint8_t* mag, uint8_t* bits, int w, uint8_t t) {
+    const __m512i vt = _mm512_set1_epi8((char)t);
+    int x = 0;
+    for (; x + 64 <= w; x += 64) {
+        __mmask64 mask = _mm512_cmpge_epu8_mask(_mm512_loadu_si512(mag + x), vt);
+        uint64_t m = (uint64_t)mask;
+        std::memcpy(bits + (x >> 3), &m, 8);
+    }
+    threshold_bits_row_ssse3(mag, bits, x, w, t);
+}
+
+#endif // IP_X86
+
+// x86 is little-endian: the masks' low byte is the first 8 pixels
+void threshold_bits_row(const uint8_t* mag, uint8_t* bits, int w, uint8_t threshold) {
+#ifdef IP_X86
+    switch (activeCpuIsa()) {
+        case CpuIsa::AVX512: threshold_bits_row_avx512(mag, bits, w, threshold);   return;
+        case CpuIsa::AVX2:   threshold_bits_row_avx2(mag, bits, w, threshold);     return;
+        case CpuIsa::SSSE3:  threshold_bits_row_ssse3(mag, bits, 0, w, threshold); return;
+        case CpuIsa::SCALAR: break;
+    }
+#endif
+    threshold_bits_row_scalar(mag, bits, 0, w, threshold);
+}
@@ -0,0 +1,195 @@
+#include "thread_pool.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+// True while this thread is executing a chunk of some pool.
+// A parallel_for issued from inside a chunk runs inline instead of deadlocking.
+static thread_local bool t_insidePool = false;
+
+using Clock = std::chrono::steady_clock;
+
+static double msSince(Clock::time_point t0) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+// --grain: items per task for pools created from now on (0 = auto)
+static std::atomic<int> g_defaultGrain{0};
+
+void ThreadPool::setDefaultGrain(int items) {
+    g_defaultGrain = items > 0 ? items : 0;
+}
+
+static uint64_t packRange(uint32_t next, uint32_t end) {
+    return ((uint64_t)next << 32) | end;
+}
+
+ThreadPool::ThreadPool(int threads) : ranges_(std::max(1, threads)) {
+    size_ = std::max(1, threads);
+    grain_ = g_defaultGrain;
+    chunkMs_.assign(size_, 0.0);
+
+    // Worker 0 is the caller of parallel_for, so spawn size_-1 threads
+    workers_.reserve(size_ - 1);
+    for (int id = 1; id < size_; id++) {
+        workers_.emplace_back(&ThreadPool::workerLoop, this, id);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_);
+        stop_ = true;
+    }
+    cvWork_.notify_all();
+    for (auto& th : workers_) th.join();
+}
+
+// Next task from the front of our own block
+bool ThreadPool::popOwn(int id, int& task) {
+    std::atomic<uint64_t>& r = ranges_[id].range;
+    uint64_t cur = r.load(std::memory_order_acquire);
+    while (true) {
+        uint32_t next = (uint32_t)(cur >> 32), end = (uint32_t)cur;
+        if (next >= end) return false;
+        if (r.compare_exchange_weak(cur, packRange(next + 1, end), std::memory_order_acq_rel)) {
+            task = (int)next;
+            return true;
+        }
+    }
+}
+
+// Own block is empty: cut the back half off another worker's block,
+// run its first task now and keep the rest as our new block
+bool ThreadPool::steal(int id, int& task) {
+    for (int k = 1; k < size_; k++) {
+        std::atomic<uint64_t>& r = ranges_[(id + k) % size_].range;
+        uint64_t cur = r.load(std::memory_order_acquire);
+        while (true) {
+            uint32_t next = (uint32_t)(cur >> 32), end = (uint32_t)cur;
+            if (next >= end) break; // empty, try the next victim
+            uint32_t take = (end - next + 1) / 2;
+            if (r.compare_exchange_weak(cur, packRange(next, end - take), std::memory_order_acq_rel)) {
+                uint32_t first = end - take;
+                ranges_[id].range.store(packRange(first + 1, end), std::memory_order_release);
+                ranges_[id].steals++;
+                task = (int)first;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void ThreadPool::runWorker(int id) {
+    double busy = 0.0;
+    int task;
+    while (popOwn(id, task) || steal(id, task)) {
+        int y0 = begin_ + task * taskItems_;
+        int y1 = std::min(end_, y0 + taskItems_);
+
+        auto t0 = Clock::now();
+        t_insidePool = true;
+        try {
+            (*fn_)(y0, y1, id);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(m_);
+            if (!error_) error_ = std::current_exception();
+        }
+        t_insidePool = false;
+        double ms = msSince(t0);
+        busy += ms;
+        ranges_[id].tasks++;
+
+        // One timeline span per task: gaps and uneven bars = load imbalance
+        if (traceEnabled()) {
+            traceRecord("chunk", "pool", t0, (int64_t)(ms * 1e6));
+        }
+    }
+    chunkMs_[id] = busy;
+}
+
+void ThreadPool::workerLoop(int id) {
+    traceNameThread("pool worker " + std::to_string(id));
+    uint64_t seen = 0;
+    while (true) {
+        std::unique_lock<std::mutex> lock(m_);
+        // Park until there is a new job (or we are shutting down)
+        cvWork_.wait(lock, [&] { return stop_ || generation_ != seen; });
+        if (stop_) return;
+        seen = generation_;
+        lock.unlock();
+
+        runWorker(id);
+
+        lock.lock();
+        if (--pending_ == 0) cvDone_.notify_one();
+    }
+}
+
+void ThreadPool::parallel_for(int begin, int end, const RangeFn& fn, int minGrain) {
+    if (begin >= end) return;
+
+    // Nested call or a pool of one: just run it here
+    if (size_ == 1 || t_insidePool) {
+        fn(begin, end, 0);
+        return;
+    }
+
+    auto t0 = Clock::now();
+
+    int n = end - begin;
+    int items = grain_ > 0 ? grain_ : (n + size_ * kTasksPerWorker - 1) / (size_ * kTasksPerWorker);
+    items = std::max({items, minGrain, 1});
+    int tasks = (n + items - 1) / items;
+
+    {
+        std::lock_guard<std::mutex> lock(m_);
+        fn_ = &fn;
+        begin_ = begin;
+        end_ = end;
+        taskItems_ = items;
+        // Worker i starts with tasks [i*tasks/size, (i+1)*tasks/size)
+        for (int i = 0; i < size_; i++) {
+            uint32_t a = (uint32_t)((int64_t)i * tasks / size_);
+            uint32_t b = (uint32_t)((int64_t)(i + 1) * tasks / size_);
+            ranges_[i].range.store(packRange(a, b), std::memory_order_relaxed);
+            ranges_[i].tasks = 0;
+            ranges_[i].steals = 0;
+        }
+        error_ = nullptr;
+        pending_ = size_ - 1;
+        generation_++;
+    }
+    cvWork_.notify_all();
+
+    // The caller is worker 0
+    runWorker(0);
+
+    std::exception_ptr err;
+    {
+        std::unique_lock<std::mutex> lock(m_);
+        cvDone_.wait(lock, [&] { return pending_ == 0; });
+        fn_ = nullptr;
+        err = error_;
+        error_ = nullptr;
+    }
+
+    double wall = msSince(t0);
+    double slowest = 0.0, busy = 0.0, idle = 0.0;
+    for (int i = 0; i < size_; i++) {
+        slowest = std::max(slowest, chunkMs_[i]);
+        busy += chunkMs_[i];
+        idle += std::max(0.0, wall - chunkMs_[i]);
+        stats_.tasks += ranges_[i].tasks;
+        stats_.steals += ranges_[i].steals;
+    }
+    stats_.dispatches++;
+    stats_.wallMs += wall;
+    stats_.computeMs += slowest;
+    stats_.busyMs += busy;
+    stats_.idleMs += idle;
+
+    if (err) std::rethrow_exception(err);
+}
@@ -0,0 +1,187 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+// ---------- latency histogram ----------
+
+int LatencyHistogram::bucketOf(uint64_t ns) {
+    if (ns < (uint64_t)kSub) return (int)ns;
+    int msb = 63 - __builtin_clzll(ns); // >= 6
+    if (msb >= kMaxExp) return kBuckets - 1;
+    // 64 sub-buckets between 2^msb and 2^(msb+1)
+    return kSub * (msb - 5) + (int)((ns >> (msb - 6)) & (kSub - 1));
+}
+
+uint64_t LatencyHistogram::bucketUpper(int b) {
+    if (b < kSub) return (uint64_t)b + 1;
+    int msb = b / kSub + 5;
+    uint64_t sub = (uint64_t)(b % kSub);
+    return (kSub + sub + 1) << (msb - 6);
+}
+
+void LatencyHistogram::add(double ms) {
+    if (ms < 0) ms = 0;
+    buckets_[bucketOf((uint64_t)std::llround(ms * 1e6))]++;
+    count_++;
+    sumMs_ += ms;
+    maxMs_ = std::max(maxMs_, ms);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& o) {
+    for (int b = 0; b < kBuckets; b++) buckets_[b] += o.buckets_[b];
+    count_ += o.count_;
+    sumMs_ += o.sumMs_;
+    maxMs_ = std::max(maxMs_, o.maxMs_);
+}
+
+double LatencyHistogram::percentile(double p) const {
+    if (count_ == 0) return 0.0;
+    p = std::clamp(p, 0.0, 1.0);
+    // Smallest bucket whose cumulative count reaches rank ceil(p * count)
+    uint64_t rank = std::max<uint64_t>(1, (uint64_t)std::ceil(p * (double)count_));
+    uint64_t seen = 0;
+    for (int b = 0; b < kBuckets; b++) {
+        seen += buckets_[b];
+        if (seen >= rank) return std::min((double)bucketUpper(b) / 1e6, maxMs_);
+    }
+    return maxMs_;
+}
+
+// ---------- timeline trace ----------
+
+namespace {
+
+struct Span {
+    const char* name;
+    const char* cat;
+    int64_t startNs; // since the trace epoch
+    int64_t durNs;
+    int64_t frame;   // -1 = not tied to a frame
+};
+
+// One per thread that recorded anything. Only the owner thread writes;
+// the writer reads after that thread has been joined.
+struct ThreadBuffer {
+    int tid = 0;
+    std::string name;
+    std::vector<Span> spans; // reserved once, never grows
+    uint64_t dropped = 0;
+};
+
+std::atomic<bool> g_enabled{false};
+size_t g_capacity = 0;
+std::chrono::steady_clock::time_point g_epoch;
+
+std::mutex g_registryMutex; // guards g_buffers (registration only)
+std::vector<std::unique_ptr<ThreadBuffer>> g_buffers;
+
+thread_local ThreadBuffer* t_buffer = nullptr;
+thread_local int64_t t_frame = -1;
+thread_local std::string t_pendingName; // name given before the first span
+
+ThreadBuffer& threadBuffer() {
+    if (!t_buffer) {
+        auto buf = std::make_unique<ThreadBuffer>();
+        buf->spans.reserve(g_capacity);
+        std::lock_guard<std::mutex> lock(g_registryMutex);
+        buf->tid = (int)g_buffers.size() + 1;
+        buf->name = t_pendingName.empty() ? "thread " + std::to_string(buf->tid) : t_pendingName;
+        t_buffer = buf.get();
+        g_buffers.push_back(std::move(buf));
+    }
+    return *t_buffer;
+}
+
+// Names are string literals or plain identifiers; escape just in case
+void writeJsonString(std::ofstream& os, const std::string& s) {
+    os << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') os << '\\' << c;
+        else if ((unsigned char)c < 0x20) os << ' ';
+        else os << c;
+    }
+    os << '"';
+}
+
+} // namespace
+
+void traceEnable(size_t spansPerThread) {
+    g_capacity = std::max<size_t>(1, spansPerThread);
+    g_epoch = std::chrono::steady_clock::now();
+    g_enabled.store(true, std::memory_order_release);
+}
+
+bool traceEnabled() {
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+void traceNameThread(const std::string& name) {
+    if (t_buffer) t_buffer->name = name;
+    else t_pendingName = name;
+}
+
+void traceSetFrame(int64_t frame) {
+    t_frame = frame;
+}
+
+void traceRecord(const char* name, const char* cat,
+                 std::chrono::steady_clock::time_point start, int64_t durNs) {
+    ThreadBuffer& buf = threadBuffer();
+    if (buf.spans.size() >= g_capacity) {
+        buf.dropped++;
+        return;
+    }
+    int64_t startNs = std::chrono::duration_cast<std::chrono::nanoseconds>(start - g_epoch).count();
+    buf.spans.push_back(Span{name, cat, startNs, durNs, t_frame});
+}
+
+uint64_t traceWriteChrome(const std::string& path) {
+    std::ofstream os(path);
+    if (!os) throw std::runtime_error("Failed to open trace output: " + path);
+
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+    uint64_t dropped = 0;
+    bool first = true;
+    auto sep = [&] {
+        os << (first ? "\n" : ",\n");
+        first = false;
+    };
+
+    // Complete events ("ph":"X"): microsecond timestamps, as the format wants.
+    // Fixed point with ns resolution: the default 6 significant digits
+    // would merge spans after ~10 ms and go scientific past 1 s.
+    os << std::fixed << std::setprecision(3);
+    os << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    for (const auto& buf : g_buffers) {
+        sep();
+        os << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buf->tid
+           << ", \"args\": {\"name\": ";
+        writeJsonString(os, buf->name);
+        os << "}}";
+
+        for (const Span& s : buf->spans) {
+            sep();
+            os << "{\"name\": ";
+            writeJsonString(os, s.name);
+            os << ", \"cat\": ";
+            writeJsonString(os, s.cat);
+            os << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buf->tid
+               << ", \"ts\": " << (double)s.startNs / 1e3
+               << ", \"dur\": " << (double)s.durNs / 1e3;
+            if (s.frame >= 0) os << ", \"args\": {\"frame\": " << s.frame << "}";
+            os << "}";
+        }
+        dropped += buf->dropped;
+    }
+    os << "\n]}\n";
+    if (!os) throw std::runtime_error("Failed to write trace output: " + path);
+    return dropped;
+}